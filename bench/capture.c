@@ -0,0 +1,214 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+//pushes N MB of 100-byte lines through the stdout pipe of a captured app, in tagged and raw format, into a file and into
+//the console and a file, and prints the throughput and the CPU time the supervisor thread spent moving it. The console is
+//a pipe drained by another thread, like the output of a container. Usage: capture [N], N defaults to 64
+
+#define _GNU_SOURCE
+
+#include "capture.h"
+#include "eventloop.h"
+#include "spawn.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define BENCH_MB_DEFAULT        64
+#define BENCH_LINE_LENGTH       100     //newline included
+#define BENCH_CHUNK             65536   //the app writes this much at once
+
+typedef struct bench_feed_s {
+    int fd;
+    size_t size;
+    volatile bool done;
+} bench_feed_t;
+
+static char bench_path[64];
+static int bench_console[2] = { -1, -1 };
+
+static void bench_run(const char *what, bool raw, bool console, size_t size);
+static void *bench_feed(void *arg);
+static void *bench_drain(void *arg);
+static double bench_now(void);
+static double bench_cpu(void);
+
+int main(int argc, char **argv) {
+    int mb = (argc > 1) ? atoi(argv[1]) : BENCH_MB_DEFAULT;
+    if(mb <= 0) {
+        fprintf(stderr, "usage: %s [MB]\n", argv[0]);
+        return 1;
+    }
+
+    char dir[] = "/tmp/nanoinit-bench-XXXXXX";
+    if(mkdtemp(dir) == 0) {
+        fprintf(stderr, "mkdtemp() failed with errno %d\n", errno);
+        return 1;
+    }
+    snprintf(bench_path, sizeof(bench_path), "%s/app.log", dir);
+
+    if((eventloop_init() != 0) || (pipe2(bench_console, O_CLOEXEC) != 0)) {
+        fprintf(stderr, "setup failed with errno %d\n", errno);
+        return 1;
+    }
+    pthread_t drain;
+    pthread_create(&drain, 0, bench_drain, 0);
+
+    size_t size = (size_t)mb << 20;
+    bench_run("tagged, file", false, false, size);
+    bench_run("tagged, console+file", false, true, size);
+    bench_run("raw, file", true, false, size);
+    bench_run("raw, console+file", true, true, size);
+
+    close(bench_console[1]);
+    pthread_join(drain, 0);
+    close(bench_console[0]);
+    eventloop_free();
+    rmdir(dir);
+    return 0;
+}
+
+static void bench_run(const char *what, bool raw, bool console, size_t size) {
+    nanoinit_application_config_t app;
+    memset(&app, 0, sizeof(app));
+    app.name = "bench";
+    app.capture.console = console;
+    app.capture.file = bench_path;
+    app.capture.raw = raw;
+
+    //no stdout/stderr redirects, so both streams are captured
+    char *envp[] = { 0 };
+    app.spawn_plan = spawn_plan_create("/bin/true", 0, 0, envp, 0, 0, &app.attr);
+    if(app.spawn_plan == 0) {
+        fprintf(stderr, "%s: spawn_plan_create() failed\n", what);
+        return;
+    }
+
+    capture_t *capture = capture_create(&app);
+    bench_feed_t feed = { .fd = capture ? capture_fd(capture, CAPTURE_STDOUT) : -1, .size = size, .done = false };
+    if(feed.fd < 0) {
+        fprintf(stderr, "%s: capture setup failed\n", what);
+        capture_free(capture);
+        free(app.spawn_plan);
+        return;
+    }
+
+    //the console destination is nanoinit's stdout
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(bench_console[1], STDOUT_FILENO);
+
+    double cpu = bench_cpu();
+    double start = bench_now();
+    pthread_t feeder;
+    pthread_create(&feeder, 0, bench_feed, &feed);
+    while(!feed.done) {
+        eventloop_run_once(10);
+    }
+    capture_flush(capture);
+    double took = bench_now() - start;
+    cpu = bench_cpu() - cpu;
+    pthread_join(feeder, 0);
+    capture_free(capture);
+    free(app.spawn_plan);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    struct stat st;
+    long long written = (stat(bench_path, &st) == 0) ? (long long)st.st_size : -1;
+    unlink(bench_path);
+
+    double mb = (double)size / (1 << 20);
+    printf("%s: %.0f MB in %.0f ms, %.0f MB/s, %.0f ms CPU (%.2f ms per MB), %lld bytes in the file\n", what, mb, took * 1e3, mb / took, cpu * 1e3, cpu * 1e3 / mb, written);
+}
+
+static void *bench_feed(void *arg) {
+    bench_feed_t *feed = (bench_feed_t *)arg;
+
+    //the same chunk over and over: full lines, so the tagged format never has to join a line across reads
+    char chunk[BENCH_CHUNK - BENCH_CHUNK % BENCH_LINE_LENGTH];
+    for(size_t i = 0; i < sizeof(chunk); i += BENCH_LINE_LENGTH) {
+        memset(chunk + i, 'a' + (int)(i / BENCH_LINE_LENGTH) % 26, BENCH_LINE_LENGTH - 1);
+        chunk[i + BENCH_LINE_LENGTH - 1] = '\n';
+    }
+
+    size_t left = feed->size - feed->size % BENCH_LINE_LENGTH;
+    while(left > 0) {
+        size_t length = (left < sizeof(chunk)) ? left : sizeof(chunk);
+        ssize_t w = write(feed->fd, chunk, length);
+        if(w < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "write() failed with errno %d\n", errno);
+            break;
+        }
+        left -= (size_t)w;
+        if((size_t)w < length) {
+            //a partial write splits a line; finish it so every chunk starts at a line again
+            size_t rest = length - (size_t)w;
+            if(write(feed->fd, chunk + w, rest) != (ssize_t)rest) {
+                break;
+            }
+            left -= rest;
+        }
+    }
+
+    feed->done = true;
+    return 0;
+}
+
+static void *bench_drain(void *arg) {
+    (void)arg;
+
+    char buffer[BENCH_CHUNK];
+    ssize_t r;
+    while(((r = read(bench_console[0], buffer, sizeof(buffer))) > 0) || ((r < 0) && (errno == EINTR))) {
+    }
+
+    return 0;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double bench_cpu(void) {
+    //the supervisor thread only; the feeding and draining threads stand for the app and the container runtime
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
@@ -0,0 +1,134 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+//reaps N app processes in random order the way the supervisor did before the pid index (scan the app array for the
+//pid, then rescan it to see whether anything is still running) and the way it does now (pidmap lookup and a running
+//counter), and prints how long each took. Usage: pidmap [N], N defaults to 10000
+
+#include "pidmap.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_APPS_DEFAULT      10000
+#define BENCH_PID_BASE          1000
+
+typedef struct bench_app_s {
+    pid_t pid;
+    bool running;
+} bench_app_t;
+
+static double bench_now(void);
+static void bench_shuffle(pid_t *pids, int count);
+
+int main(int argc, char **argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : BENCH_APPS_DEFAULT;
+    if(count <= 0) {
+        fprintf(stderr, "usage: %s [apps]\n", argv[0]);
+        return 1;
+    }
+
+    bench_app_t *apps = (bench_app_t *)calloc(count, sizeof(bench_app_t));
+    pid_t *order = (pid_t *)calloc(count, sizeof(pid_t));
+    pidmap_t map;
+    if((apps == 0) || (order == 0) || (pidmap_init(&map, count) != 0)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+    for(int i = 0; i < count; i++) {
+        order[i] = BENCH_PID_BASE + i * 7;      //pids aren't consecutive once other processes come and go
+    }
+    bench_shuffle(order, count);
+
+    //linear: find the app of every reaped pid, then check whether any app is still running
+    for(int i = 0; i < count; i++) {
+        apps[i].pid = BENCH_PID_BASE + i * 7;
+        apps[i].running = true;
+    }
+    double start = bench_now();
+    int still_running = count;
+    for(int i = 0; i < count; i++) {
+        for(int j = 0; j < count; j++) {
+            if(apps[j].running && (apps[j].pid == order[i])) {
+                apps[j].running = false;
+                break;
+            }
+        }
+
+        still_running = 0;
+        for(int j = 0; j < count; j++) {
+            still_running += apps[j].running;
+        }
+    }
+    double linear = bench_now() - start;
+    if(still_running != 0) {
+        fprintf(stderr, "linear: %d apps left running\n", still_running);
+        return 1;
+    }
+
+    //indexed: one lookup and removal per reaped pid, and a counter
+    for(int i = 0; i < count; i++) {
+        apps[i].running = true;
+        pidmap_insert(&map, apps[i].pid, &apps[i]);
+    }
+    start = bench_now();
+    int running_count = count;
+    for(int i = 0; i < count; i++) {
+        bench_app_t *app = (bench_app_t *)pidmap_remove(&map, order[i]);
+        if(app) {
+            app->running = false;
+            running_count--;
+        }
+    }
+    double indexed = bench_now() - start;
+    if((running_count != 0) || (map.count != 0)) {
+        fprintf(stderr, "indexed: %d apps left running\n", running_count);
+        return 1;
+    }
+
+    printf("reaping %d apps: linear scans %.3f ms, pid index %.3f ms (%.0fx)\n", count, linear * 1e3, indexed * 1e3, (indexed > 0) ? linear / indexed : 0.0);
+
+    pidmap_free(&map);
+    free(order);
+    free(apps);
+    return 0;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_shuffle(pid_t *pids, int count) {
+    for(int i = count - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        pid_t t = pids[i];
+        pids[i] = pids[j];
+        pids[j] = t;
+    }
+}
@@ -0,0 +1,156 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+//writes N log-sized records to a FIFO drained at a fixed slow rate, first directly as the supervisor does without
+//--log-async, then through the writer thread, and prints how long the writing side was held up: the time the supervisor
+//would not be reaping or restarting apps. Usage: writer [N], N defaults to 5000
+
+#define _GNU_SOURCE
+
+#include "writer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BENCH_RECORDS_DEFAULT   5000
+#define BENCH_RECORD            "[1792226807.138] [nanoinit] supervisor_start() respawned app (pid=12345) after 3 ms\n"
+#define BENCH_DRAIN_CHUNK       4096    //the sink takes this much...
+#define BENCH_DRAIN_PAUSE_US    10000   //...every this often, about 400 kB/s
+#define BENCH_RING_SIZE         1048576
+
+static char bench_path[64];
+static volatile bool bench_draining = true;
+
+static void *bench_drain(void *arg);
+static double bench_now(void);
+static void bench_report(const char *what, double total, double worst, int count);
+
+int main(int argc, char **argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : BENCH_RECORDS_DEFAULT;
+    if(count <= 0) {
+        fprintf(stderr, "usage: %s [records]\n", argv[0]);
+        return 1;
+    }
+
+    char dir[] = "/tmp/nanoinit-bench-XXXXXX";
+    if(mkdtemp(dir) == 0) {
+        fprintf(stderr, "mkdtemp() failed with errno %d\n", errno);
+        return 1;
+    }
+    snprintf(bench_path, sizeof(bench_path), "%s/sink", dir);
+    if(mkfifo(bench_path, 0600) != 0) {
+        fprintf(stderr, "mkfifo() failed with errno %d\n", errno);
+        return 1;
+    }
+
+    pthread_t drain;
+    pthread_create(&drain, 0, bench_drain, 0);
+    size_t length = strlen(BENCH_RECORD);
+
+    //direct: every write() waits for the sink once the pipe is full
+    int fd = open(bench_path, O_WRONLY | O_CLOEXEC);
+    double worst = 0;
+    double start = bench_now();
+    for(int i = 0; i < count; i++) {
+        double before = bench_now();
+        if(write(fd, BENCH_RECORD, length) != (ssize_t)length) {
+            fprintf(stderr, "write() failed with errno %d\n", errno);
+            return 1;
+        }
+        double took = bench_now() - before;
+        worst = (took > worst) ? took : worst;
+    }
+    bench_report("direct write()", bench_now() - start, worst, count);
+    close(fd);
+
+    //writer thread: the records only have to be queued
+    if(writer_start(BENCH_RING_SIZE, RING_DROP_OLDEST) != 0) {
+        fprintf(stderr, "writer_start() failed\n");
+        return 1;
+    }
+    writer_file_t *file = writer_file_open(bench_path, true, 0);
+    worst = 0;
+    start = bench_now();
+    for(int i = 0; i < count; i++) {
+        double before = bench_now();
+        writer_write(file, BENCH_RECORD, length);
+        double took = bench_now() - before;
+        worst = (took > worst) ? took : worst;
+    }
+    bench_report("writer thread", bench_now() - start, worst, count);
+
+    start = bench_now();
+    writer_file_close(file);
+    writer_stop(60000);
+    printf("writer thread drained the sink in %.0f ms, %llu records dropped\n", (bench_now() - start) * 1e3, (unsigned long long)writer_dropped());
+
+    bench_draining = false;
+    pthread_join(drain, 0);
+    unlink(bench_path);
+    rmdir(dir);
+    return 0;
+}
+
+static void *bench_drain(void *arg) {
+    (void)arg;
+
+    //reopened for the second writer; both see the same slow sink
+    char buffer[BENCH_DRAIN_CHUNK];
+    while(bench_draining) {
+        int fd = open(bench_path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+        if(fd < 0) {
+            break;
+        }
+        fcntl(fd, F_SETFL, 0);
+
+        ssize_t r;
+        while((r = read(fd, buffer, sizeof(buffer))) != 0) {
+            if((r < 0) && (errno != EINTR) && (errno != EAGAIN)) {
+                break;
+            }
+            usleep(BENCH_DRAIN_PAUSE_US);
+        }
+        close(fd);
+        usleep(BENCH_DRAIN_PAUSE_US);
+    }
+
+    return 0;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *what, double total, double worst, int count) {
+    printf("%s: %d records held the writer up for %.1f ms, %.3f ms at worst for one record\n", what, count, total * 1e3, worst * 1e3);
+}
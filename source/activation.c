@@ -0,0 +1,141 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "activation.h"
+#include "address.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int activation_bind(const nanoinit_socket_config_t *socket);
+
+int activation_open(const nanoinit_application_config_t *app, int *fds) {
+    for(int i = 0; i < app->socket_count; i++) {
+        fds[i] = activation_bind(&app->sockets[i]);
+        if(fds[i] < 0) {
+            log_ni_error("activation_open() could not bind %s for app %s, errno %d", app->sockets[i].listen, app->name, errno);
+            activation_close(fds, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void activation_close(int *fds, int count) {
+    for(int i = 0; i < count; i++) {
+        if(fds[i] < 0) {
+            continue;
+        }
+
+        //the path of a unix socket is only known to the socket itself once the config that named it is gone
+        struct sockaddr_un address;
+        socklen_t length = sizeof(address);
+        if((getsockname(fds[i], (struct sockaddr *)&address, &length) == 0) && (address.sun_family == AF_UNIX) &&
+            (length > offsetof(struct sockaddr_un, sun_path)) && (address.sun_path[0] != 0)) {
+            unlink(address.sun_path);
+        }
+
+        close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+char *activation_fdnames(const nanoinit_application_config_t *app) {
+    //unnamed sockets are listed as "unknown", as systemd does
+    size_t length = strlen("LISTEN_FDNAMES=") + 1;
+    bool named = false;
+    for(int i = 0; i < app->socket_count; i++) {
+        length += (app->sockets[i].name ? strlen(app->sockets[i].name) : strlen("unknown")) + 1;
+        named = named || (app->sockets[i].name != 0);
+    }
+
+    if(!named) {
+        return 0;
+    }
+
+    char *fdnames = (char *)malloc(length);
+    if(fdnames == 0) {
+        return 0;
+    }
+
+    strcpy(fdnames, "LISTEN_FDNAMES=");
+    for(int i = 0; i < app->socket_count; i++) {
+        if(i) {
+            strcat(fdnames, ":");
+        }
+        strcat(fdnames, app->sockets[i].name ? app->sockets[i].name : "unknown");
+    }
+
+    return fdnames;
+}
+
+static int activation_bind(const nanoinit_socket_config_t *socket_config) {
+    //blocking, like systemd passes them; the app sets O_NONBLOCK itself if it wants to
+    int fd = socket(socket_config->address.ss_family, socket_config->type | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        return -1;
+    }
+
+    int enable = 1;
+    if(socket_config->address.ss_family == AF_UNIX) {
+        const struct sockaddr_un *address = (const struct sockaddr_un *)&socket_config->address;
+        if(address_unlink_stale(address->sun_path) != 0) {
+            close(fd);
+            errno = EADDRINUSE;
+            return -1;
+        }
+    }
+    else if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if(socket_config->reuseport && (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0)) {
+        close(fd);
+        return -1;
+    }
+
+    if(bind(fd, (const struct sockaddr *)&socket_config->address, socket_config->address_length) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    if((socket_config->type == SOCK_STREAM) && (listen(fd, socket_config->backlog) != 0)) {
+        int saved = errno;
+        activation_close(&fd, 1);
+        errno = saved;
+        return -1;
+    }
+
+    return fd;
+}
@@ -0,0 +1,127 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "address.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int address_parse_inet(const char *spec, const char *default_host, struct sockaddr_storage *address, socklen_t *address_length) {
+    const char *host = default_host;
+    const char *port = spec;
+    char host_buffer[INET6_ADDRSTRLEN];
+
+    const char *separator = strrchr(port, ':');
+    if(separator) {
+        size_t host_length = separator - port;
+        if((port[0] == '[') && (host_length > 2) && (port[host_length - 1] == ']')) {
+            port++;
+            host_length -= 2;
+        }
+
+        if(host_length >= sizeof(host_buffer)) {
+            return -1;
+        }
+
+        memcpy(host_buffer, port, host_length);
+        host_buffer[host_length] = 0;
+        host = host_buffer;
+        port = separator + 1;
+    }
+
+    char *end = 0;
+    long port_number = strtol(port, &end, 10);
+    if((end == port) || (*end != 0) || (port_number <= 0) || (port_number > 65535)) {
+        return -1;
+    }
+
+    memset(address, 0, sizeof(*address));
+    struct sockaddr_in *ipv4 = (struct sockaddr_in *)address;
+    struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)address;
+    if(inet_pton(AF_INET, host, &ipv4->sin_addr) == 1) {
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = htons((uint16_t)port_number);
+        *address_length = sizeof(struct sockaddr_in);
+    }
+    else if(inet_pton(AF_INET6, host, &ipv6->sin6_addr) == 1) {
+        ipv6->sin6_family = AF_INET6;
+        ipv6->sin6_port = htons((uint16_t)port_number);
+        *address_length = sizeof(struct sockaddr_in6);
+    }
+    else {
+        return -1;
+    }
+
+    return 0;
+}
+
+int address_parse_unix(const char *path, struct sockaddr_storage *address, socklen_t *address_length) {
+    struct sockaddr_un *un = (struct sockaddr_un *)address;
+    size_t length = strlen(path);
+    if((length == 0) || (length >= sizeof(un->sun_path))) {
+        return -1;
+    }
+
+    memset(address, 0, sizeof(*address));
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, path, length);
+    *address_length = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + 1);
+
+    return 0;
+}
+
+int address_unlink_stale(const char *path) {
+    struct stat st;
+    if((lstat(path, &st) != 0) || !S_ISSOCK(st.st_mode)) {
+        return 0;
+    }
+
+    //a socket file outlives its listener; it is only stale if nobody accepts connections on it
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    if(address_parse_unix(path, &address, &address_length) != 0) {
+        return 0;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        return 0;
+    }
+
+    int rc = connect(fd, (const struct sockaddr *)&address, address_length);
+    close(fd);
+    if(rc == 0) {
+        return -1;
+    }
+
+    unlink(path);
+    return 0;
+}
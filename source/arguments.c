@@ -23,12 +23,22 @@
  * */
 
 #include "arguments.h"
+#include "config.h"
+#include "control.h"
 #include <argp.h>
 #include <string.h>
 #include <stdlib.h>
 
 static nanoinit_arguments_t arguments = {0};
 
+//long-only options
+#define ARGUMENTS_LOG_MAX_SIZE      0x100
+#define ARGUMENTS_LOG_MAX_AGE       0x101
+#define ARGUMENTS_LOG_KEEP          0x102
+#define ARGUMENTS_LOG_FLUSH         0x103
+#define ARGUMENTS_LOG_ASYNC         0x104
+#define ARGUMENTS_LOG_RING_SIZE     0x105
+
 const char *argp_program_version = "nanoinit v0.0.1 build 123451234";
 const char *argp_program_bug_address = "<adrian@axiplus.com>";
 static char doc[] = "nanoinit - for documentation and usage check https://github.com/AXIPlus/nanoinit";
@@ -37,8 +47,19 @@ static struct argp_option options[] = {
     { "config-file", 'c', "/path/to/config.json", 0, "Specifies the configuration JSON file. Default value is null, which means that no apps will be run, but nanoinit will sleep for infinity and wait for a kill signal.", 0 },
     { "config-json-object", 'j', "nanoinit-settings", 0, "Specifies the parent JSON object. Default value is null, which means that it will look directly into the root of the JSON file.", 0},
     { "log-path", 'l', "/path/to/log.txt", 0, "Specified the path for writing log-files. Default only uses stderr and stdout for logging.", 0 },
+    { "log-max-size", ARGUMENTS_LOG_MAX_SIZE, "SIZE", 0, "Rotates the log file once it reaches SIZE bytes; K, M, G and T suffixes are accepted. Default value is 0, which means no size limit.", 0 },
+    { "log-max-age", ARGUMENTS_LOG_MAX_AGE, "SECONDS", 0, "Rotates the log file once it has been written to for SECONDS. Default value is 0, which means no age limit.", 0 },
+    { "log-keep", ARGUMENTS_LOG_KEEP, "N", 0, "Number of rotated log files kept, as log.txt.1 to log.txt.N. Default value is 5.", 0 },
+    { "log-flush", ARGUMENTS_LOG_FLUSH, "immediate|loop|MS", 0, "Specifies when log records are written out: immediate(every record on its own)-default, loop(together once per event loop iteration) or a number of milliseconds records may wait.", 0 },
+    { "log-async", ARGUMENTS_LOG_ASYNC, "drop-oldest|drop-newest|block", 0, "Writes the log file and app output files from a dedicated thread, so a slow volume never stalls supervision; the value says what happens when its ring is full: drop-oldest(discard the oldest queued records), drop-newest(discard the new record) or block(wait for the writer). Default is writing files from the supervisor.", 0 },
+    { "log-ring-size", ARGUMENTS_LOG_RING_SIZE, "SIZE", 0, "Size of the --log-async ring; K, M, G and T suffixes are accepted. Default value is 1M.", 0 },
+    { "metrics", 'M', "unix:/path|tcp:[host:]port", 0, "Serves Prometheus metrics over HTTP on a unix socket or TCP port; host defaults to 127.0.0.1. Default value is null, which means that no metrics are served.", 0 },
     { "manual-mode", 'm', 0, 0, "Enable manual mode. This option is recommended to be set via the NANOINIT_MANUAL_MODE environment variable, as it is more useful that way. Default is manual-mode disabled.", 0 },
-    { "reload", 'r', 0, 0, "Looks for top nanoinit process and sends a SIGSUSR1 signal to it, forcing it to terminate all apps, reload config and restart apps.", 0 },
+    { "restart-rate", 'R', "N", 0, "Limits app restarts to N per second across all apps; restarts over the limit are delayed. Default value is 0, which means unlimited.", 0 },
+    { "reload", 'r', 0, 0, "Asks the running nanoinit, through its control socket, to reload the config. Same as -x reload.", 0 },
+    { "control-socket", 'S', "/path/to/socket", 0, "Specifies the control socket nanoinit listens on, or connects to with -x and -r. Default value is " CONTROL_DEFAULT_SOCKET "; empty disables the control socket.", 0 },
+    { "spawn-strategy", 's', "vfork|fork", 0, "Specifies how apps are started. Values are vfork(clone with shared memory, no page table copy)-default and fork(classic fork, kept as fallback).", 0 },
+    { "control", 'x', 0, 0, "Client mode: sends the command given as arguments (start|stop|restart <app>, signal <app> <signal>, status [app], reload) to the running nanoinit and prints the reply.", 0 },
     { "verbose", 'v', "0-2", 0, "Specified application print verbosity level. Values are 0(nanoinit ERR)-default, 1(application ERR), 2(LOG).", 0 },
     { 0 } 
 };
@@ -47,7 +68,9 @@ static error_t argp_parse_cb(int key, char *arg, struct argp_state *state);
 
 const nanoinit_arguments_t *arguments_init(int argc, char **argv) {
     //parse provided command line arguments
-    struct argp argp = { options, argp_parse_cb, 0, doc, 0, 0, 0 };
+    struct argp argp = { options, argp_parse_cb, "[COMMAND...]", doc, 0, 0, 0 };
+    arguments.log_rotate.keep = ROTATE_DEFAULT_KEEP;
+    arguments.log_async.ring_size = LOG_ASYNC_RING_SIZE;
     argp_parse(&argp, argc, argv, 0, 0, &arguments);
 
     //check manual mode enviroment variable
@@ -73,6 +96,16 @@ const nanoinit_arguments_t *arguments_init(int argc, char **argv) {
         arguments.config_json_object = strdup(config_json_object_env);
     }
 
+    char *control_socket_env = getenv("NANOINIT_CONTROL_SOCKET");
+    if(control_socket_env != 0) {
+        free(arguments.control_socket);
+        arguments.control_socket = strdup(control_socket_env);
+    }
+
+    if(arguments.control_socket == 0) {
+        arguments.control_socket = strdup(CONTROL_DEFAULT_SOCKET);
+    }
+
     return &arguments;
 }
 
@@ -120,14 +153,163 @@ static error_t argp_parse_cb(int key, char *arg, struct argp_state *state) {
             }
             break;
 
+        case ARGUMENTS_LOG_MAX_SIZE:
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            if(config_parse_size(arg, true, &iter_arguments->log_rotate.max_size) != 0) {
+                //invalid size
+                argp_usage(state);
+            }
+            break;
+
+        case ARGUMENTS_LOG_FLUSH:
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            if(strcmp(arg, "immediate") == 0) {
+                iter_arguments->log_flush = LOG_FLUSH_IMMEDIATE;
+            }
+            else if(strcmp(arg, "loop") == 0) {
+                iter_arguments->log_flush = LOG_FLUSH_LOOP;
+            }
+            else {
+                char *end = 0;
+                long interval = strtol(arg, &end, 10);
+                if((end == arg) || (*end != 0) || (interval < 1) || (interval > 60000)) {
+                    //invalid flush policy
+                    argp_usage(state);
+                }
+                iter_arguments->log_flush = LOG_FLUSH_TIMED;
+                iter_arguments->log_flush_interval_ms = (int)interval;
+            }
+            break;
+
+        case ARGUMENTS_LOG_ASYNC:
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            if(strcmp(arg, "drop-oldest") == 0) {
+                iter_arguments->log_async.overflow = RING_DROP_OLDEST;
+            }
+            else if(strcmp(arg, "drop-newest") == 0) {
+                iter_arguments->log_async.overflow = RING_DROP_NEWEST;
+            }
+            else if(strcmp(arg, "block") == 0) {
+                iter_arguments->log_async.overflow = RING_BLOCK;
+            }
+            else {
+                //invalid overflow policy
+                argp_usage(state);
+            }
+            iter_arguments->log_async.enabled = true;
+            break;
+
+        case ARGUMENTS_LOG_RING_SIZE: {
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            long long size = 0;
+            if((config_parse_size(arg, true, &size) != 0) || (size < RING_SIZE_MIN) || (size > 1073741824LL)) {
+                //invalid ring size
+                argp_usage(state);
+            }
+            iter_arguments->log_async.ring_size = (size_t)size;
+        } break;
+
+        case ARGUMENTS_LOG_MAX_AGE:
+        case ARGUMENTS_LOG_KEEP: {
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            char *end = 0;
+            long number = strtol(arg, &end, 10);
+            long max = (key == ARGUMENTS_LOG_KEEP) ? ROTATE_KEEP_MAX : 2000000;
+            if((end == arg) || (*end != 0) || (number < 0) || (number > max)) {
+                //invalid age or keep count
+                argp_usage(state);
+            }
+
+            if(key == ARGUMENTS_LOG_KEEP) {
+                iter_arguments->log_rotate.keep = (int)number;
+            }
+            else {
+                iter_arguments->log_rotate.max_age_ms = (int)number * 1000;
+            }
+        } break;
+
         case 'm':
             iter_arguments->manual_mode = true;
             break;
 
+        case 'M':
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            free(iter_arguments->metrics);
+            iter_arguments->metrics = strdup(arg);
+            if(iter_arguments->metrics == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+
         case 'r':
             iter_arguments->special_mode = NI_COMMAND_RELOAD;
             break;
 
+        case 'R': {
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            char *end = 0;
+            long rate = strtol(arg, &end, 10);
+            if((end == arg) || (*end != 0) || (rate < 0) || (rate > 1000000)) {
+                //invalid restart rate
+                argp_usage(state);
+            }
+            iter_arguments->restart_rate = (int)rate;
+        } break;
+
+        case 'S':
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            free(iter_arguments->control_socket);
+            iter_arguments->control_socket = strdup(arg);
+            if(iter_arguments->control_socket == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+
+        case 's':
+            if(arg == 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+
+            if(strcmp(arg, "vfork") == 0) {
+                iter_arguments->spawn_strategy = SPAWN_STRATEGY_VFORK;
+            }
+            else if(strcmp(arg, "fork") == 0) {
+                iter_arguments->spawn_strategy = SPAWN_STRATEGY_FORK;
+            }
+            else {
+                //invalid spawn strategy
+                argp_usage(state);
+            }
+            break;
+
+        case 'x':
+            iter_arguments->special_mode = NI_COMMAND_CONTROL;
+            break;
+
         case 'v':
             if(arg == 0) {
                 return ARGP_ERR_UNKNOWN;
@@ -140,14 +322,30 @@ static error_t argp_parse_cb(int key, char *arg, struct argp_state *state) {
             }
             break;
 
-        case ARGP_KEY_ARG:
-            if (state->arg_num >= 2) {
-                argp_usage(state);
+        case ARGP_KEY_ARG: {
+            //words of the -x command, joined by spaces
+            size_t length = iter_arguments->control_command ? strlen(iter_arguments->control_command) : 0;
+            char *command = (char *)realloc(iter_arguments->control_command, length + strlen(arg) + 2);
+            if(command == 0) {
+                return ARGP_ERR_UNKNOWN;
             }
-            break;
+
+            if(length) {
+                command[length++] = ' ';
+            }
+            strcpy(command + length, arg);
+            iter_arguments->control_command = command;
+        } break;
 
         case ARGP_KEY_END:
+            if((iter_arguments->special_mode == NI_COMMAND_CONTROL) && (iter_arguments->control_command == 0)) {
+                //-x without a command
+                argp_usage(state);
+            }
 
+            if((iter_arguments->special_mode != NI_COMMAND_CONTROL) && (state->arg_num > 2)) {
+                argp_usage(state);
+            }
             break;
 
         default:
@@ -161,4 +359,7 @@ void arguments_free() {
     free(arguments.config_file);
     free(arguments.config_json_object);
     free(arguments.log_path);
+    free(arguments.metrics);
+    free(arguments.control_socket);
+    free(arguments.control_command);
 }
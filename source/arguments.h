@@ -25,18 +25,31 @@
 #pragma once
 
 #include <stdbool.h>
+#include "log.h"
+#include "rotate.h"
+#include "spawn.h"
 
 typedef enum {
     NI_NO_SPECIAL_MODE = 0,
     NI_COMMAND_RELOAD = 1,
+    NI_COMMAND_CONTROL = 2,
 } nanoinit_special_mode_t;
 
 typedef struct nanoinit_arguments_s {
     char *config_file;
     char *config_json_object;
     char *log_path;
+    rotate_policy_t log_rotate; //for log_path
+    log_flush_t log_flush;
+    int log_flush_interval_ms;  //LOG_FLUSH_TIMED
+    log_async_t log_async;
+    char *control_socket;       //"" disables the control socket
+    char *control_command;      //-x command, with its arguments
+    char *metrics;              //metrics endpoint, "unix:/path" or "tcp:[host:]port"; 0 serves none
     bool manual_mode;
     nanoinit_special_mode_t special_mode;
+    spawn_strategy_t spawn_strategy;
+    int restart_rate;           //max restarts per second across all apps; 0 is unlimited
     int verbosity_level;
 } nanoinit_arguments_t;
 
@@ -0,0 +1,80 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "buffer.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void buffer_printf(buffer_t *buffer, const char *format, ...) {
+    if(buffer->failed) {
+        return;
+    }
+
+    while(true) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer->data ? buffer->data + buffer->length : 0, buffer->size - buffer->length, format, args);
+        va_end(args);
+
+        if(length < 0) {
+            buffer->failed = true;
+            return;
+        }
+
+        if(buffer->length + (size_t)length < buffer->size) {
+            buffer->length += (size_t)length;
+            return;
+        }
+
+        //grow and print again
+        size_t size = buffer->size ? buffer->size * 2 : 4096;
+        while(size <= buffer->length + (size_t)length) {
+            size *= 2;
+        }
+
+        char *data = (char *)realloc(buffer->data, size);
+        if(data == 0) {
+            buffer->failed = true;
+            return;
+        }
+
+        buffer->data = data;
+        buffer->size = size;
+    }
+}
+
+void buffer_reset(buffer_t *buffer) {
+    buffer->length = 0;
+    buffer->failed = false;
+}
+
+void buffer_free(buffer_t *buffer) {
+    free(buffer->data);
+    buffer->data = 0;
+    buffer->length = 0;
+    buffer->size = 0;
+    buffer->failed = false;
+}
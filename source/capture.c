@@ -0,0 +1,528 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "capture.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+
+#define CAPTURE_PREFIX_MAX          320     //"[time] [app] [stream] "; longer app names are cut
+#define CAPTURE_DESTINATIONS_MAX    3
+#define CAPTURE_LOG_FD              -1      //destination fd of the log file while the writer thread owns it
+#define CAPTURE_QUEUED_FD           -2      //destination fd of an app file the writer thread writes
+
+//where output goes; file is 0 for destinations that aren't rotated by nanoinit itself, queued is set for CAPTURE_QUEUED_FD.
+//Destinations without an fd of their own are always written from a buffer
+typedef struct capture_destination_s {
+    int fd;
+    bool *copy;
+    rotate_file_t *file;
+    writer_file_t *queued;
+} capture_destination_t;
+
+static void capture_read_cb(eventloop_source_t *source, uint32_t events);
+static bool capture_spliced(const capture_stream_t *stream);
+static ssize_t capture_pump(capture_stream_t *stream);
+static ssize_t capture_read(capture_stream_t *stream);
+static ssize_t capture_splice(capture_stream_t *stream);
+static int capture_drain(int pipe_fd, const capture_destination_t *destination, size_t length);
+static void capture_emit(capture_stream_t *stream, const char *line, size_t length);
+static bool capture_target(capture_t *capture, rotate_file_t *file, writer_file_t **queued, bool *copy, const char *what, capture_destination_t *destination);
+static void capture_unqueue(writer_file_t **queued, const rotate_file_t *file, bool force);
+static int capture_open(capture_t *capture, rotate_file_t *file, const char *what);
+static void capture_written(capture_t *capture, rotate_file_t *file, size_t length);
+static void capture_write(const capture_destination_t *destination, const char *data, size_t length);
+static void capture_close_stream(capture_stream_t *stream);
+
+bool capture_needed(const nanoinit_application_config_t *app) {
+    return config_capture_enabled(&app->capture) || app->spawn_plan->stdout_path || app->spawn_plan->stderr_path;
+}
+
+capture_t *capture_create(const nanoinit_application_config_t *app) {
+    capture_t *capture = (capture_t *)calloc(1, sizeof(capture_t));
+    if(capture == 0) {
+        log_ni_error("capture_create() bad memory allocation");
+        return 0;
+    }
+
+    rotate_init(&capture->file, &app->log_rotate);
+    for(int i = 0; i < 2; i++) {
+        capture_stream_t *stream = &capture->streams[i];
+        stream->capture = capture;
+        stream->stream = (i == CAPTURE_STDOUT) ? "stdout" : "stderr";
+        rotate_init(&stream->redirect, &app->log_rotate);
+        stream->write_fd = -1;
+        stream->tee_fds[0] = -1;
+        stream->tee_fds[1] = -1;
+        stream->source.fd = -1;
+        stream->source.callback = capture_read_cb;
+        stream->source.data = stream;
+    }
+
+    capture_configure(capture, app);
+    return capture;
+}
+
+void capture_configure(capture_t *capture, const nanoinit_application_config_t *app) {
+    capture->config = &app->capture;
+    capture->name = app->name;
+
+    //a file that could not be opened is tried again with the new definition
+    capture->file.policy = &app->log_rotate;
+    rotate_set_path(&capture->file, app->capture.file, !app->capture.raw);
+    rotate_reset(&capture->file);
+    capture_unqueue(&capture->queued_file, &capture->file, false);
+
+    //redirects that are rotated are spliced into, which append mode doesn't allow
+    bool rotated = rotate_enabled(&app->log_rotate);
+    for(int i = 0; i < 2; i++) {
+        capture_stream_t *stream = &capture->streams[i];
+        const char *path = (i == CAPTURE_STDOUT) ? app->spawn_plan->stdout_path : app->spawn_plan->stderr_path;
+        stream->redirect.policy = &app->log_rotate;
+        rotate_set_path(&stream->redirect, path, !rotated);
+        rotate_reset(&stream->redirect);
+        capture_unqueue(&stream->queued_redirect, &stream->redirect, false);
+    }
+}
+
+int capture_fd(capture_t *capture, capture_stream_id_t id) {
+    capture_stream_t *stream = &capture->streams[id];
+    if(stream->redirect.path && !capture_spliced(stream)) {
+        //the app writes to the file itself; every spawn tries again if it could not be opened
+        rotate_reset(&stream->redirect);
+        int fd = capture_open(capture, &stream->redirect, stream->stream);
+        return (fd >= 0) ? fd : -1;
+    }
+
+    if((stream->redirect.path == 0) && !config_capture_enabled(capture->config)) {
+        return -1;
+    }
+
+    rotate_reset(&stream->redirect);
+    capture_unqueue(&stream->queued_redirect, &stream->redirect, false);
+    if(stream->write_fd >= 0) {
+        return stream->write_fd;
+    }
+
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        log_ni_error("capture_fd() pipe2() failed with errno %d", errno);
+        return -1;
+    }
+
+    //the app's end blocks like a regular stdout, so a fast writer waits for nanoinit instead of losing output
+    fcntl(fds[1], F_SETFL, 0);
+    stream->source.fd = fds[0];
+    if(eventloop_add(&stream->source, EPOLLIN) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        stream->source.fd = -1;
+        return -1;
+    }
+
+    stream->write_fd = fds[1];
+    return stream->write_fd;
+}
+
+void capture_flush(capture_t *capture) {
+    if(capture == 0) {
+        return;
+    }
+
+    for(int i = 0; i < 2; i++) {
+        capture_stream_t *stream = &capture->streams[i];
+        if(stream->source.fd < 0) {
+            continue;
+        }
+
+        while(capture_pump(stream) > 0) {
+        }
+
+        if(stream->length > 0) {
+            capture_emit(stream, stream->buffer, stream->length);
+            stream->length = 0;
+        }
+    }
+}
+
+void capture_free(capture_t *capture) {
+    if(capture == 0) {
+        return;
+    }
+
+    capture_flush(capture);
+    for(int i = 0; i < 2; i++) {
+        capture_stream_t *stream = &capture->streams[i];
+        capture_close_stream(stream);
+        if(stream->write_fd >= 0) {
+            close(stream->write_fd);
+            stream->write_fd = -1;
+        }
+        if(stream->tee_fds[0] >= 0) {
+            close(stream->tee_fds[0]);
+            close(stream->tee_fds[1]);
+        }
+        capture_unqueue(&stream->queued_redirect, &stream->redirect, true);
+        rotate_set_path(&stream->redirect, 0, false);
+    }
+
+    capture_unqueue(&capture->queued_file, &capture->file, true);
+    rotate_set_path(&capture->file, 0, false);
+    free(capture);
+}
+
+static void capture_read_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    //one read per wakeup, so a chatty app can't hold up the event loop
+    capture_stream_t *stream = (capture_stream_t *)source->data;
+    if(capture_pump(stream) < 0) {
+        log_ni_error("capture_read_cb() could not read the %s of app %s, errno %d; no longer capturing it", stream->stream, stream->capture->name, errno);
+        capture_close_stream(stream);
+    }
+}
+
+static bool capture_spliced(const capture_stream_t *stream) {
+    //whether the redirect file of stream is fed through its pipe; /dev/null has nothing to rotate
+    return stream->redirect.path && rotate_enabled(stream->redirect.policy) && (strcmp(stream->redirect.path, "/dev/null") != 0);
+}
+
+static ssize_t capture_pump(capture_stream_t *stream) {
+    //a line left over from before the app was switched to the raw format still goes out as a record
+    if((stream->redirect.path || stream->capture->config->raw) && (stream->length == 0)) {
+        return capture_splice(stream);
+    }
+    return capture_read(stream);
+}
+
+static ssize_t capture_read(capture_stream_t *stream) {
+    //returns the number of bytes read, 0 once the pipe is empty, or -1 on errors
+    ssize_t r = read(stream->source.fd, stream->buffer + stream->length, sizeof(stream->buffer) - stream->length);
+    if(r < 0) {
+        return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+    }
+    if(r == 0) {
+        //nanoinit holds a write end itself, so the pipe can't reach end of file
+        errno = EPIPE;
+        return -1;
+    }
+    stream->length += (size_t)r;
+
+    //one record per complete line; the unfinished rest waits for more data
+    char *start = stream->buffer;
+    char *end = stream->buffer + stream->length;
+    char *newline;
+    while((newline = (char *)memchr(start, '\n', (size_t)(end - start))) != 0) {
+        capture_emit(stream, start, (size_t)(newline - start));
+        start = newline + 1;
+    }
+
+    stream->length = (size_t)(end - start);
+    if(stream->length == sizeof(stream->buffer)) {
+        //a line longer than the buffer is split
+        capture_emit(stream, stream->buffer, stream->length);
+        stream->length = 0;
+    }
+    else if((stream->length > 0) && (start != stream->buffer)) {
+        memmove(stream->buffer, start, stream->length);
+    }
+
+    return r;
+}
+
+static ssize_t capture_splice(capture_stream_t *stream) {
+    //raw format and rotated redirects: the output is moved from the app's pipe to its destinations by the kernel, without
+    //passing through nanoinit; returns the number of bytes moved, 0 once the pipe is empty, or -1 on errors
+    capture_t *capture = stream->capture;
+    const nanoinit_capture_config_t *config = capture->config;
+
+    capture_destination_t destinations[CAPTURE_DESTINATIONS_MAX];
+    int count = 0;
+    if(stream->redirect.path) {
+        if(capture_target(capture, &stream->redirect, &stream->queued_redirect, &stream->copy_redirect, stream->stream, &destinations[count])) {
+            count++;
+        }
+    }
+    else {
+        if(config->console || !config_capture_enabled(config)) {
+            //anything nanoinit itself printed goes out first
+            fflush(stdout);
+            destinations[count++] = (capture_destination_t){ STDOUT_FILENO, &capture->copy_console, 0, 0 };
+        }
+        if(config->log && log_file_get()) {
+            destinations[count++] = (capture_destination_t){ log_file_get()->fd, &capture->copy_log, log_file_get(), 0 };
+        }
+        else if(config->log && log_file_enabled()) {
+            //the writer thread owns the file, so the output is copied and queued for it
+            destinations[count++] = (capture_destination_t){ CAPTURE_LOG_FD, &capture->copy_log, 0, 0 };
+        }
+        if(config->file && capture_target(capture, &capture->file, &capture->queued_file, &capture->copy_file, "output", &destinations[count])) {
+            count++;
+        }
+    }
+
+    if(count == 0) {
+        //nowhere to go; the output is dropped so the app doesn't block
+        ssize_t r = read(stream->source.fd, stream->buffer, sizeof(stream->buffer));
+        if(r < 0) {
+            return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+        }
+        return r;
+    }
+
+    //the length to move is what tee() duplicated; the last destination gets the original.
+    //A rotated file takes no more than fits, so it is rotated right at its max_size
+    size_t room = CAPTURE_RAW_MAX;
+    for(int i = 0; i < count; i++) {
+        if(destinations[i].file) {
+            room = rotate_room(destinations[i].file, room);
+        }
+    }
+    ssize_t length = (ssize_t)room;
+    if(count > 1) {
+        if((stream->tee_fds[0] < 0) && (pipe2(stream->tee_fds, O_CLOEXEC) != 0)) {
+            stream->tee_fds[0] = -1;
+            stream->tee_fds[1] = -1;
+            return -1;
+        }
+
+        for(int i = 0; i < count - 1; i++) {
+            ssize_t t = tee(stream->source.fd, stream->tee_fds[1], (size_t)length, SPLICE_F_NONBLOCK);
+            if(t <= 0) {
+                return ((t == 0) || (errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+            }
+
+            //the first tee() sets the length, the following ones duplicate the same bytes again
+            length = t;
+            if(capture_drain(stream->tee_fds[0], &destinations[i], (size_t)length) != 0) {
+                return -1;
+            }
+            capture_written(capture, destinations[i].file, (size_t)length);
+        }
+
+        if(capture_drain(stream->source.fd, &destinations[count - 1], (size_t)length) != 0) {
+            return -1;
+        }
+        capture_written(capture, destinations[count - 1].file, (size_t)length);
+        return length;
+    }
+
+    //a single destination is spliced into directly, moving whatever the pipe holds
+    ssize_t moved;
+    if(!*destinations[0].copy && (destinations[0].fd >= 0)) {
+        moved = splice(stream->source.fd, 0, destinations[0].fd, 0, (size_t)length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if((moved >= 0) || (errno != EINVAL)) {
+            if(moved < 0) {
+                return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+            }
+            capture_written(capture, destinations[0].file, (size_t)moved);
+            return moved;
+        }
+        *destinations[0].copy = true;
+    }
+
+    moved = read(stream->source.fd, stream->buffer, sizeof(stream->buffer));
+    if(moved < 0) {
+        return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+    }
+    capture_write(&destinations[0], stream->buffer, (size_t)moved);
+    capture_written(capture, destinations[0].file, (size_t)moved);
+    return moved;
+}
+
+static int capture_drain(int pipe_fd, const capture_destination_t *destination, size_t length) {
+    //moves exactly length bytes, which pipe_fd is known to hold, to destination; splice() falls back to read() and write()
+    //for destinations that refuse it; bytes a destination fails to take are still drained, so the streams stay in step
+    char buffer[CAPTURE_LINE_MAX];
+    bool failed = false;
+    while(length > 0) {
+        ssize_t n;
+        if(!*destination->copy && (destination->fd >= 0) && !failed) {
+            n = splice(pipe_fd, 0, destination->fd, 0, length, SPLICE_F_MOVE);
+            if(n < 0) {
+                if(errno == EINVAL) {
+                    *destination->copy = true;
+                }
+                else if(errno != EINTR) {
+                    failed = true;  //a full disk loses the output rather than stalling supervision
+                }
+                continue;
+            }
+        }
+        else {
+            n = read(pipe_fd, buffer, (length < sizeof(buffer)) ? length : sizeof(buffer));
+            if(n < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if(!failed) {
+                capture_write(destination, buffer, (size_t)n);
+            }
+        }
+
+        if(n == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+        length -= (size_t)n;
+    }
+
+    return 0;
+}
+
+static void capture_emit(capture_stream_t *stream, const char *line, size_t length) {
+    capture_t *capture = stream->capture;
+    const nanoinit_capture_config_t *config = capture->config;
+
+    //same time format as nanoinit's own log lines, so both sort together
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+
+    char record[CAPTURE_PREFIX_MAX + CAPTURE_LINE_MAX + 1];
+    int prefix = snprintf(record, CAPTURE_PREFIX_MAX, "[%llu.%03u] [%s] [%s] ", (unsigned long long)tv.tv_sec, (unsigned int)tv.tv_usec / 1000, capture->name, stream->stream);
+    if(prefix >= CAPTURE_PREFIX_MAX) {
+        prefix = CAPTURE_PREFIX_MAX - 1;
+    }
+    memcpy(record + prefix, line, length);
+    size_t size = (size_t)prefix + length;
+    record[size++] = '\n';
+
+    //the container output is also where an app whose capture was just turned off would have written
+    if(config->console || !config_capture_enabled(config)) {
+        fwrite(record, 1, size, stdout);
+        fflush(stdout);
+    }
+
+    if(config->log) {
+        log_record(record, size);
+    }
+
+    capture_destination_t destination;
+    if(config->file && capture_target(capture, &capture->file, &capture->queued_file, &capture->copy_file, "output", &destination)) {
+        capture_write(&destination, record, size);
+        capture_written(capture, destination.file, size);
+    }
+}
+
+static bool capture_target(capture_t *capture, rotate_file_t *file, writer_file_t **queued, bool *copy, const char *what, capture_destination_t *destination) {
+    //an app file as a destination: queued for the writer thread when it runs, written by nanoinit itself otherwise.
+    //file keeps the path and policy either way; false if the file can't be written
+    if(writer_running()) {
+        if(*queued == 0) {
+            *queued = writer_file_open(file->path, file->append, file->policy);
+        }
+
+        if(*queued) {
+            //the writer thread can't log, so what went wrong is reported with the next output
+            int errors = writer_file_errors(*queued);
+            if(errors & WRITER_ERROR_OPEN) {
+                log_ni_error("capture_target() could not open %s for the %s of app %s", file->path, what, capture->name);
+            }
+            if(errors & WRITER_ERROR_ROTATE) {
+                log_ni_error("capture_target() could not rotate %s of app %s; continuing in the old one", file->path, capture->name);
+            }
+            if(writer_file_failed(*queued)) {
+                return false;
+            }
+
+            *destination = (capture_destination_t){ CAPTURE_QUEUED_FD, copy, 0, *queued };
+            return true;
+        }
+    }
+
+    if(capture_open(capture, file, what) < 0) {
+        return false;
+    }
+
+    *destination = (capture_destination_t){ file->fd, copy, file, 0 };
+    return true;
+}
+
+static void capture_unqueue(writer_file_t **queued, const rotate_file_t *file, bool force) {
+    //the writer thread's file is given up when the definition changed it, or after a failed open to try again, like rotate_reset()
+    if(*queued && (force || writer_file_failed(*queued) || !writer_file_is(*queued, file->path, file->append, file->policy))) {
+        writer_file_close(*queued);
+        *queued = 0;
+    }
+}
+
+static int capture_open(capture_t *capture, rotate_file_t *file, const char *what) {
+    //opens file the first time it is written; a failure is logged once and not tried again until the app is reloaded or respawned
+    if(file->fd == -1) {
+        if(rotate_fd(file) < 0) {
+            log_ni_error("capture_open() could not open %s for the %s of app %s", file->path, what, capture->name);
+        }
+    }
+
+    return file->fd;
+}
+
+static void capture_written(capture_t *capture, rotate_file_t *file, size_t length) {
+    if(file && (rotate_written(file, length) != 0)) {
+        log_ni_error("capture_written() could not rotate %s of app %s; continuing in the old one", file->path, capture->name);
+    }
+}
+
+static void capture_write(const capture_destination_t *destination, const char *data, size_t length) {
+    if(destination->fd == CAPTURE_LOG_FD) {
+        log_record(data, length);
+        return;
+    }
+
+    if(destination->fd == CAPTURE_QUEUED_FD) {
+        writer_write(destination->queued, data, length);
+        return;
+    }
+
+    while(length > 0) {
+        ssize_t w = write(destination->fd, data, length);
+        if(w < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;     //a full disk loses the record rather than stalling supervision
+        }
+        data += w;
+        length -= (size_t)w;
+    }
+}
+
+static void capture_close_stream(capture_stream_t *stream) {
+    if(stream->source.fd >= 0) {
+        eventloop_remove(&stream->source);
+        close(stream->source.fd);
+        stream->source.fd = -1;
+    }
+}
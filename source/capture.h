@@ -0,0 +1,89 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+#include "eventloop.h"
+#include "rotate.h"
+#include "writer.h"
+
+#define CAPTURE_LINE_MAX            4096    //longer lines are split into several records
+#define CAPTURE_RAW_MAX             65536   //bytes moved per wakeup in raw format; the default pipe capacity
+
+typedef enum {
+    CAPTURE_STDOUT = 0,
+    CAPTURE_STDERR = 1,
+} capture_stream_id_t;
+
+typedef struct capture_s capture_t;
+
+typedef struct capture_stream_s {
+    capture_t *capture;
+    const char *stream;                 //"stdout" or "stderr", as written in records
+    rotate_file_t redirect;             //stdout or stderr file of the app; no path when the stream isn't redirected
+    bool copy_redirect;                 //splice() was refused by the redirect file
+    writer_file_t *queued_redirect;     //redirect written by the writer thread instead; 0 until first written
+    int write_fd;                       //handed to every process of the app; -1 while the stream has no pipe
+    eventloop_source_t source;          //read end
+    size_t length;                      //bytes of the unfinished line in buffer
+    char buffer[CAPTURE_LINE_MAX];
+    int tee_fds[2];                     //raw format with several destinations: every destination but the last gets its copy through this pipe; -1 until needed
+} capture_stream_t;
+
+//output of an app held by nanoinit: redirect files and captured streams. Both are opened once and kept for as long as the app
+//is defined, so restarts, overlap restarts and helper processes all write to the same place and nothing is lost in between.
+//A redirect file with a rotation policy is fed through a pipe as well, so nanoinit can rotate it without the app noticing.
+//With the writer thread running, the files nanoinit writes are queued for it instead, so a stalled volume can't block supervision
+struct capture_s {
+    const nanoinit_capture_config_t *config;
+    const char *name;                   //app name, as written in records
+    rotate_file_t file;                 //config->file, opened in append mode (at its end for the raw format) by the first record
+    writer_file_t *queued_file;         //config->file written by the writer thread instead; 0 until first written
+    bool copy_console;                  //splice() was refused by the destination, which is written from a buffer instead
+    bool copy_log;
+    bool copy_file;
+    capture_stream_t streams[2];
+};
+
+//whether app has any output for nanoinit to hold
+bool capture_needed(const nanoinit_application_config_t *app);
+
+capture_t *capture_create(const nanoinit_application_config_t *app);
+
+//points the capture at a reloaded definition of its app; changed files are reopened when next written
+void capture_configure(capture_t *capture, const nanoinit_application_config_t *app);
+
+//returns the descriptor a process of the app gets as stream: the write end of its pipe, created the first time, or its shared
+//redirect file; -1 keeps nanoinit's own stream
+int capture_fd(capture_t *capture, capture_stream_id_t stream);
+
+//reads whatever is still buffered in the pipes and writes out unfinished lines; called when a process of the app exits,
+//so its last line without a newline is not joined with the first one of the next process
+void capture_flush(capture_t *capture);
+
+//flushes the capture and frees it
+void capture_free(capture_t *capture);
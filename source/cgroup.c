@@ -0,0 +1,401 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "cgroup.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CGROUP_LINE_MAX             4096
+#define CGROUP_SUPERVISOR_NAME      "nanoinit"      //leaf nanoinit moves itself into
+#define CGROUP_APP_PREFIX           "app."          //keeps app cgroups apart from the supervisor leaf, whatever the app names
+#define CGROUP_MOVE_PASSES          8               //rounds of moving processes out of nanoinit's cgroup, for ones forked meanwhile
+
+static int cgroup_base_fd = -1;
+static bool cgroup_unavailable = false;     //set after a failed cgroup_init(), so spawns don't retry it every time
+
+static int cgroup_find_base(char *path, size_t size, size_t *mount_length);
+static int cgroup_move_procs(int from_fd, int to_fd);
+static int cgroup_write(int dir_fd, const char *file, const char *value);
+static int cgroup_read(int dir_fd, const char *file, char *buffer, size_t size);
+static bool cgroup_has_word(const char *list, const char *word);
+static void cgroup_app_dir(const char *name, char *dir, size_t size);
+
+int cgroup_init(void) {
+    if(cgroup_base_fd >= 0) {
+        return 0;
+    }
+
+    if(cgroup_unavailable) {
+        return -1;
+    }
+    cgroup_unavailable = true;
+
+    char path[CGROUP_LINE_MAX];
+    if(cgroup_find_base(path, sizeof(path), 0) != 0) {
+        log_ni_error("cgroup_init() no cgroup v2 hierarchy found; app limits are not applied");
+        return -1;
+    }
+
+    int base_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(base_fd < 0) {
+        log_ni_error("cgroup_init() could not open %s, errno %d; app limits are not applied", path, errno);
+        return -1;
+    }
+
+    //cgroup v2 only delegates controllers from a cgroup that has no processes of its own
+    if((mkdirat(base_fd, CGROUP_SUPERVISOR_NAME, 0755) != 0) && (errno != EEXIST)) {
+        log_ni_error("cgroup_init() could not create cgroup in %s, errno %d; app limits are not applied", path, errno);
+        close(base_fd);
+        return -1;
+    }
+
+    int leaf_fd = openat(base_fd, CGROUP_SUPERVISOR_NAME, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    char pid[16];
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    if((leaf_fd < 0) || (cgroup_write(leaf_fd, "cgroup.procs", pid) != 0)) {
+        log_ni_error("cgroup_init() could not move nanoinit into %s/%s, errno %d; app limits are not applied", path, CGROUP_SUPERVISOR_NAME, errno);
+        if(leaf_fd >= 0) {
+            close(leaf_fd);
+        }
+        close(base_fd);
+        return -1;
+    }
+
+    //apps started before the first one with limits (e.g. when a reload brings it in) are still in nanoinit's cgroup, and
+    //they would keep controllers from being enabled; they join nanoinit in its leaf. The root cgroup, the only one
+    //without cgroup.type, may have processes of its own, and its kernel threads can't be moved
+    bool root = (faccessat(base_fd, "cgroup.type", F_OK, 0) != 0);
+    if(!root && (cgroup_move_procs(base_fd, leaf_fd) != 0)) {
+        log_ni_error("cgroup_init() could not move running apps into %s/%s; limits may not be applied", path, CGROUP_SUPERVISOR_NAME);
+    }
+    close(leaf_fd);
+
+    //delegate the controllers the limits need, as far as nanoinit's cgroup has them
+    char controllers[CGROUP_LINE_MAX];
+    if(cgroup_read(base_fd, "cgroup.controllers", controllers, sizeof(controllers)) < 0) {
+        controllers[0] = 0;
+    }
+
+    const char *wanted[] = { "memory", "cpu", "io", "pids" };
+    for(size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]); i++) {
+        if(!cgroup_has_word(controllers, wanted[i])) {
+            log_ni_error("cgroup_init() %s controller is not available in %s", wanted[i], path);
+            continue;
+        }
+
+        char enable[32];
+        snprintf(enable, sizeof(enable), "+%s", wanted[i]);
+        if(cgroup_write(base_fd, "cgroup.subtree_control", enable) != 0) {
+            log_ni_error("cgroup_init() could not enable the %s controller in %s, errno %d", wanted[i], path, errno);
+        }
+    }
+
+    cgroup_base_fd = base_fd;
+    cgroup_unavailable = false;
+    log("cgroup_init() apps with limits get their own cgroup in %s", path);
+    return 0;
+}
+
+void cgroup_free(void) {
+    if(cgroup_base_fd >= 0) {
+        close(cgroup_base_fd);
+        cgroup_base_fd = -1;
+    }
+
+    cgroup_unavailable = false;
+}
+
+bool cgroup_limits_set(const nanoinit_cgroup_config_t *limits) {
+    return limits->memory_max || limits->memory_high || limits->cpu_max || limits->io_max || limits->pids_max;
+}
+
+int cgroup_app_open(const char *name, const nanoinit_cgroup_config_t *limits) {
+    if(cgroup_init() != 0) {
+        return -1;
+    }
+
+    char dir[CGROUP_LINE_MAX];
+    cgroup_app_dir(name, dir, sizeof(dir));
+    if((mkdirat(cgroup_base_fd, dir, 0755) != 0) && (errno != EEXIST)) {
+        log_app_error("cgroup_app_open() could not create cgroup %s for app %s, errno %d", dir, name, errno);
+        return -1;
+    }
+
+    int fd = openat(cgroup_base_fd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) {
+        log_app_error("cgroup_app_open() could not open cgroup %s for app %s, errno %d", dir, name, errno);
+        return -1;
+    }
+
+    //a limit that can't be set is reported, but doesn't keep the app from starting
+    const struct {
+        const char *file;
+        const char *value;
+    } files[] = {
+        { "memory.max", limits->memory_max },
+        { "memory.high", limits->memory_high },
+        { "cpu.max", limits->cpu_max },
+        { "io.max", limits->io_max },
+        { "pids.max", limits->pids_max },
+    };
+
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        if(files[i].value && (cgroup_write(fd, files[i].file, files[i].value) != 0)) {
+            log_app_error("cgroup_app_open() could not set %s to %s for app %s, errno %d", files[i].file, files[i].value, name, errno);
+        }
+    }
+
+    return fd;
+}
+
+void cgroup_app_close(int fd, const char *name) {
+    if(fd < 0) {
+        return;
+    }
+
+    close(fd);
+
+    //fails with EBUSY while processes the app left behind are still in it; the cgroup is then reused on the next start
+    char dir[CGROUP_LINE_MAX];
+    cgroup_app_dir(name, dir, sizeof(dir));
+    unlinkat(cgroup_base_fd, dir, AT_REMOVEDIR);
+}
+
+uint64_t cgroup_oom_kills(int fd) {
+    char events[CGROUP_LINE_MAX];
+    if((fd < 0) || (cgroup_read(fd, "memory.events", events, sizeof(events)) < 0)) {
+        return 0;
+    }
+
+    //"oom_kill N" line; not to be confused with "oom_group_kill"
+    char *line = events;
+    while(line) {
+        if(strncmp(line, "oom_kill ", 9) == 0) {
+            return strtoull(line + 9, 0, 10);
+        }
+
+        line = strchr(line, '\n');
+        if(line) {
+            line++;
+        }
+    }
+
+    return 0;
+}
+
+int cgroup_cpu_limit(void) {
+    char path[CGROUP_LINE_MAX];
+    size_t mount_length;
+    if(cgroup_find_base(path, sizeof(path), &mount_length) != 0) {
+        return 0;
+    }
+
+    //the tightest quota on the way up to the mount point is the one that applies; the root cgroup has no cpu.max
+    int limit = 0;
+    while(strlen(path) > mount_length) {
+        char value[64];
+        int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(dir_fd >= 0) {
+            long long quota, period;
+            if((cgroup_read(dir_fd, "cpu.max", value, sizeof(value)) > 0) && (sscanf(value, "%lld %lld", &quota, &period) == 2) && (quota > 0) && (period > 0)) {
+                int cpus = (int)((quota + period - 1) / period);
+                if((limit == 0) || (cpus < limit)) {
+                    limit = cpus;
+                }
+            }
+            close(dir_fd);
+        }
+
+        *strrchr(path, '/') = 0;
+    }
+
+    return limit;
+}
+
+static int cgroup_find_base(char *path, size_t size, size_t *mount_length) {
+    char line[CGROUP_LINE_MAX];
+    char relative[CGROUP_LINE_MAX] = {0};
+    bool found = false;
+
+    //"0::/path" is the unified hierarchy membership
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if(f == 0) {
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), f)) {
+        if(strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = 0;
+            snprintf(relative, sizeof(relative), "%s", line + 3);
+            found = true;
+            break;
+        }
+    }
+    fclose(f);
+
+    if(!found) {
+        return -1;
+    }
+
+    //mountinfo: id parent major:minor root mount_point options [optional fields] - fstype source super_options
+    f = fopen("/proc/self/mountinfo", "r");
+    if(f == 0) {
+        return -1;
+    }
+
+    found = false;
+    while(fgets(line, sizeof(line), f)) {
+        char *separator = strstr(line, " - cgroup2 ");
+        if(separator == 0) {
+            continue;
+        }
+        *separator = 0;
+
+        char root[CGROUP_LINE_MAX];
+        char mount_point[CGROUP_LINE_MAX];
+        if(sscanf(line, "%*s %*s %*s %4095s %4095s", root, mount_point) != 2) {
+            continue;
+        }
+
+        //the mount may expose only a subtree, e.g. inside a container without a cgroup namespace
+        const char *inside = relative;
+        size_t root_length = strlen(root);
+        if(strcmp(root, "/") != 0) {
+            if((strncmp(relative, root, root_length) != 0) || ((relative[root_length] != '/') && (relative[root_length] != 0))) {
+                continue;
+            }
+            inside = relative + root_length;
+        }
+
+        snprintf(path, size, "%s%s", mount_point, strcmp(inside, "/") ? inside : "");
+        if(mount_length) {
+            *mount_length = strlen(mount_point);
+        }
+        found = true;
+        break;
+    }
+    fclose(f);
+
+    return found ? 0 : -1;
+}
+
+static int cgroup_move_procs(int from_fd, int to_fd) {
+    //repeated until a pass finds nothing, as processes may fork while they are being moved
+    for(int pass = 0; pass < CGROUP_MOVE_PASSES; pass++) {
+        int fd = openat(from_fd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+        FILE *f = (fd >= 0) ? fdopen(fd, "r") : 0;
+        if(f == 0) {
+            if(fd >= 0) {
+                close(fd);
+            }
+            return -1;
+        }
+
+        int found = 0;
+        char pid[32];
+        while(fgets(pid, sizeof(pid), f)) {
+            pid[strcspn(pid, "\n")] = 0;
+            if(pid[0] == 0) {
+                continue;
+            }
+
+            //a process that exited meanwhile (ESRCH) is gone from the cgroup anyway
+            found++;
+            if((cgroup_write(to_fd, "cgroup.procs", pid) != 0) && (errno != ESRCH)) {
+                log_ni_error("cgroup_move_procs() could not move pid %s, errno %d", pid, errno);
+            }
+        }
+        fclose(f);
+
+        if(found == 0) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static int cgroup_write(int dir_fd, const char *file, const char *value) {
+    int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+
+    ssize_t length = (ssize_t)strlen(value);
+    ssize_t written = write(fd, value, length);
+    int write_errno = errno;
+    close(fd);
+
+    errno = write_errno;
+    return (written == length) ? 0 : -1;
+}
+
+static int cgroup_read(int dir_fd, const char *file, char *buffer, size_t size) {
+    int fd = openat(dir_fd, file, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if(length < 0) {
+        return -1;
+    }
+
+    buffer[length] = 0;
+    return (int)length;
+}
+
+static bool cgroup_has_word(const char *list, const char *word) {
+    size_t length = strlen(word);
+    for(const char *p = strstr(list, word); p; p = strstr(p + 1, word)) {
+        bool starts = (p == list) || (p[-1] == ' ');
+        bool ends = (p[length] == 0) || (p[length] == ' ') || (p[length] == '\n');
+        if(starts && ends) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void cgroup_app_dir(const char *name, char *dir, size_t size) {
+    snprintf(dir, size, "%s%s", CGROUP_APP_PREFIX, name);
+
+    //app names are JSON keys and may contain anything; a cgroup name is a single path component
+    for(char *p = dir; *p; p++) {
+        if((*p == '/') || (*p == '\n')) {
+            *p = '_';
+        }
+    }
+}
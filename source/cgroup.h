@@ -0,0 +1,49 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+
+//sets up per-app cgroups under nanoinit's own cgroup v2; nanoinit moves itself into a "nanoinit" leaf so controllers can be delegated to siblings
+//along with any app already running in its cgroup
+//returns -1 when no writable cgroup v2 hierarchy is available; safe to call again, only the first successful call does the work
+int cgroup_init(void);
+void cgroup_free(void);
+
+bool cgroup_limits_set(const nanoinit_cgroup_config_t *limits);
+
+//creates (or reuses) the app's cgroup and writes its limits; returns a directory fd for spawning into it, or -1
+int cgroup_app_open(const char *name, const nanoinit_cgroup_config_t *limits);
+
+//closes fd and removes the app's cgroup once it is empty
+void cgroup_app_close(int fd, const char *name);
+
+//oom_kill counter from memory.events; 0 when not available
+uint64_t cgroup_oom_kills(int fd);
+
+//CPUs nanoinit's cgroup and its ancestors allow by cpu.max, rounded up; 0 when unlimited or unknown
+int cgroup_cpu_limit(void);
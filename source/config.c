@@ -22,15 +22,38 @@
  * SOFTWARE.
  * */
 
+#define _GNU_SOURCE
+
 #include "config.h"
+#include "cgroup.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "log.h"
+#include "address.h"
 #include "edJSON/edJSON.h"
 
-static nanoinit_config_t config = {0};
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static nanoinit_config_t *config = 0;     //config being parsed; the edJSON callback fills it in
+
 
+#define CONFIG_DEFAULT_RESTART_DELAY_MS      100
+#define CONFIG_DEFAULT_RESTART_DELAY_MAX_MS  30000
+#define CONFIG_DEFAULT_RESTART_JITTER        0.2
+#define CONFIG_DEFAULT_RESTART_WINDOW_MS     60000
+#define CONFIG_DEFAULT_STOP_TIMEOUT_MS       10000
+#define CONFIG_INSTANCES_MAX                 1024
+#define CONFIG_DEFAULT_HEALTH_INTERVAL_MS    10000
+#define CONFIG_DEFAULT_HEALTH_TIMEOUT_MS     2000
+#define CONFIG_DEFAULT_HEALTH_THRESHOLD      3
+#define CONFIG_HEALTH_THRESHOLD_MAX          1000
 
 #define EDJSON_PATH_MAX             32      //this practically depends on the tree depth of the JSON object; nanoinit needs only 3 levels when used without a JSON object
 #define JSON_PARSE_BUFFER_SIZE      1024    //this should fit max build path length
@@ -55,8 +78,33 @@ typedef struct config_message_s {
 } config_message_t;
 
 static int edJSON_callback(const edJSON_path_t *path, size_t path_size, edJSON_value_t value, void *private);
+static int config_parse_ready(nanoinit_ready_config_t *ready, const char *spec);
+static int config_parse_listen(nanoinit_socket_config_t *socket, const char *spec);
+static int config_parse_health(nanoinit_health_config_t *health, const char *spec);
+static int config_parse_health_resolved(nanoinit_health_config_t *health, const char *spec);
+static int config_value_to_ms(edJSON_value_t value, int *ms);
+static double config_value_to_double(edJSON_value_t value);
+static int config_parse_mask(const char *list, unsigned long *mask, int bits);
+static char *config_parse_cgroup_limit(const char *key, edJSON_value_t value, const char *string);
+static int config_parse_rlimit(const char *name);
+static int config_check_online(const char *online_path, const unsigned long *mask, int bits, int fallback_count, const char *what, const char *app);
+static int config_build_graph(void);
+static bool config_depends_on_matches(const char *name, const nanoinit_application_config_t *app);
+static int config_expand_instances(void);
+static int config_instance_create(const nanoinit_application_config_t *app, int instance, const cpu_set_t *cpus, nanoinit_application_config_t *created);
+static int config_instance_string(const char *value, int instance, char **result);
+static int config_allowed_cpus(const nanoinit_application_config_t *app, cpu_set_t *cpus);
+static bool config_string_equal(const char *a, const char *b);
+
+nanoinit_config_t *config_init(const char *filename, const char *json_object) {
+    //every load parses into a fresh config, so a running config is never touched by a reload that fails
+    config = (nanoinit_config_t *)calloc(1, sizeof(nanoinit_config_t));
+    if(config == 0) {
+        log_ni_error("config_init() bad memory allocation");
+        return 0;
+    }
 
-const nanoinit_config_t *config_init(const char *filename, const char *json_object) {
+    bool has_config = false;
     char *json_content = 0;
     long length = 0;
     FILE *f = fopen(filename, "rb");
@@ -111,14 +159,15 @@ const nanoinit_config_t *config_init(const char *filename, const char *json_obje
         if(config_message.current_app == 0) {
             log_ni_error("config_init() bad memory allocation");
             free(json_content);
-            return &config;
+            config_free(config);
+            config = 0;
+            return 0;
         }
 
         int rc = edJSON_parse(json_content, edJSON_path, EDJSON_PATH_MAX, edJSON_callback, (void*)&config_message);
         free(json_content);
         free(config_message.current_app);
 
-        bool has_config = false;
         if(rc != EDJSON_SUCCESS) {
             log_ni_error("config_init() JSON parsing error");
         }
@@ -152,45 +201,392 @@ const nanoinit_config_t *config_init(const char *filename, const char *json_obje
 
         //validate config data
         if(has_config) {
-            for(int i = 0; i < config.application_count; i++) {
-                if(config.applications[i].name == 0) {
+            for(int i = 0; i < config->application_count; i++) {
+                if(config->applications[i].name == 0) {
+                    has_config = false;
+                    break;
+                }
+
+                if(config->applications[i].path == 0) {
+                    has_config = false;
+                    break;
+                }
+            }
+        }
+
+        //"instances" become one app each, before names are checked and dependencies resolved
+        if(has_config) {
+            if(config_expand_instances() != 0) {
+                has_config = false;
+            }
+        }
+
+        //apps are told apart by name, e.g. when a reload is compared against the running config
+        if(has_config) {
+            for(int i = 0; (i < config->application_count) && has_config; i++) {
+                for(int j = 0; j < i; j++) {
+                    if(strcmp(config->applications[i].name, config->applications[j].name) == 0) {
+                        log_ni_error("config_init() app %s is defined more than once", config->applications[i].name);
+                        has_config = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        //restart settings defaults
+        if(has_config) {
+            for(int i = 0; i < config->application_count; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                if(app->restart == NI_RESTART_UNSET) {
+                    app->restart = app->autorestart ? NI_RESTART_ALWAYS : NI_RESTART_NEVER;
+                }
+
+                if(app->restart_delay_max_ms < app->restart_delay_ms) {
+                    app->restart_delay_max_ms = app->restart_delay_ms;
+                }
+            }
+        }
+
+        //scheduling settings that only make sense together
+        if(has_config) {
+            for(int i = 0; i < config->application_count; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                bool realtime = (app->attr.sched_policy == SPAWN_SCHED_FIFO) || (app->attr.sched_policy == SPAWN_SCHED_RR);
+                if(realtime && (app->attr.sched_priority == 0)) {
+                    log_ni_error("config_init() sched_priority is required with sched_policy fifo and rr for app %s", app->name);
+                    has_config = false;
+                    break;
+                }
+
+                if(!realtime && (app->attr.sched_priority != 0)) {
+                    log_ni_error("config_init() sched_priority is only valid with sched_policy fifo and rr for app %s", app->name);
+                    has_config = false;
+                    break;
+                }
+
+                if((app->attr.ioprio_class == SPAWN_IOPRIO_UNSET) && (app->attr.ioprio_level != 0)) {
+                    log_ni_error("config_init() ioprio_level requires ioprio_class for app %s", app->name);
+                    has_config = false;
+                    break;
+                }
+            }
+        }
+
+        //an object without listen can't be bound; on_demand apps are started by their sockets
+        if(has_config) {
+            for(int i = 0; (i < config->application_count) && has_config; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                if((app->on_demand || app->idle_timeout_ms) && (app->socket_count == 0)) {
+                    log_ni_error("config_init() %s requires sockets for app %s", app->on_demand ? "on_demand" : "idle_timeout", app->name);
+                    has_config = false;
+                    break;
+                }
+
+                if(app->idle_timeout_ms && !app->on_demand) {
+                    log_ni_error("config_init() idle_timeout requires on_demand for app %s", app->name);
+                    has_config = false;
+                    break;
+                }
+
+                for(int j = 0; j < app->socket_count; j++) {
+                    if(app->sockets[j].listen == 0) {
+                        log_ni_error("config_init() socket %d has no listen address for app %s", j, app->name);
+                        has_config = false;
+                        break;
+                    }
+
+                    //addresses are only parsed per instance; a single app would silently use instance 0's
+                    if((app->instance_of == 0) && strstr(app->sockets[j].listen, "%i")) {
+                        log_ni_error("config_init() socket %s uses %%i, which requires instances, for app %s", app->sockets[j].listen, app->name);
+                        has_config = false;
+                        break;
+                    }
+                }
+
+                if(has_config && (app->instance_of == 0) && app->health.check && strstr(app->health.check, "%i")) {
+                    log_ni_error("config_init() health check %s uses %%i, which requires instances, for app %s", app->health.check, app->name);
+                    has_config = false;
+                    break;
+                }
+            }
+        }
+
+        //a probe needs a deadline, and back-to-back probes would keep the app busy answering them
+        if(has_config) {
+            for(int i = 0; i < config->application_count; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                if((app->health.interval_ms == 0) || (app->health.timeout_ms == 0)) {
+                    log_ni_error("config_init() health_interval and health_timeout should be above 0 for app %s", app->name);
                     has_config = false;
                     break;
                 }
+            }
+        }
+
+        //a soft limit above the hard one would only fail at spawn time
+        if(has_config) {
+            for(int i = 0; (i < config->application_count) && has_config; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                for(int j = 0; j < app->attr.rlimit_count; j++) {
+                    if(app->attr.rlimits[j].limit.rlim_cur > app->attr.rlimits[j].limit.rlim_max) {
+                        log_ni_error("config_init() soft rlimit is above the hard one for app %s", app->name);
+                        has_config = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        //pinning to an offline CPU or a missing node would only fail at spawn time
+        if(has_config) {
+            for(int i = 0; i < config->application_count; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+                if(app->attr.has_cpus && (config_check_online("/sys/devices/system/cpu/online", app->attr.cpus, SPAWN_CPUS_MAX, (int)sysconf(_SC_NPROCESSORS_ONLN), "cpu", app->name) != 0)) {
+                    has_config = false;
+                    break;
+                }
+
+                if(app->attr.has_numa_nodes && (config_check_online("/sys/devices/system/node/online", app->attr.numa_nodes, SPAWN_NUMA_NODES_MAX, 1, "numa node", app->name) != 0)) {
+                    has_config = false;
+                    break;
+                }
+            }
+        }
+
+        //resolve depends_on and check the dependency graph is acyclic
+        if(has_config) {
+            if(config_build_graph() != 0) {
+                has_config = false;
+            }
+        }
+
+        //precompile spawn plans, so respawns don't touch the config or the heap
+        if(has_config) {
+            int environ_count = 0;
+            while(environ[environ_count]) {
+                environ_count++;
+            }
+
+            for(int i = 0; i < config->application_count; i++) {
+                nanoinit_application_config_t *app = &config->applications[i];
+
+                //instances additionally get INSTANCE; the plan copies the strings, so they can live on the stack here
+                char *instance_envp[app->instance_of ? environ_count + 2 : 1];
+                char instance_env[32];
+                char *const *envp = environ;
+                if(app->instance_of) {
+                    memcpy(instance_envp, environ, sizeof(char *) * environ_count);
+                    snprintf(instance_env, sizeof(instance_env), "INSTANCE=%d", app->instance);
+                    instance_envp[environ_count] = instance_env;
+                    instance_envp[environ_count + 1] = 0;
+                    envp = instance_envp;
+                }
 
-                if(config.applications[i].path == 0) {
+                app->spawn_plan = spawn_plan_create(app->path, app->args, app->arg_count, envp, app->stdout_path, app->stderr_path, &app->attr);
+                if(app->spawn_plan == 0) {
+                    log_ni_error("config_init() could not build spawn plan for app %s", app->name);
                     has_config = false;
                     break;
                 }
             }
         }
         
-        //zero out config
-        if(!has_config) {
-            config_free();
-            memset(&config, 0, sizeof(nanoinit_config_t));
+    }
+
+    nanoinit_config_t *result = config;
+    config = 0;
+    if(!has_config) {
+        config_free(result);
+        return 0;
+    }
+
+    return result;
+}
+
+void config_free(nanoinit_config_t *loaded) {
+    if(loaded == 0) {
+        return;
+    }
+
+    for(int i = 0; i < loaded->application_count; i++) {
+        config_app_free(&loaded->applications[i]);
+    }
+
+    free(loaded->applications);
+    free(loaded);
+}
+
+void config_app_detach(nanoinit_application_config_t *app, nanoinit_application_config_t *detached) {
+    //the strings and the spawn plan move over; indices into the old config are meaningless on their own
+    *detached = *app;
+    free(detached->dependencies);
+    free(detached->dependents);
+    detached->dependencies = 0;
+    detached->dependency_count = 0;
+    detached->dependents = 0;
+    detached->dependent_count = 0;
+    for(int j = 0; j < detached->depends_on_count; j++) {
+        free(detached->depends_on[j]);
+    }
+    free(detached->depends_on);
+    detached->depends_on = 0;
+    detached->depends_on_count = 0;
+
+    memset(app, 0, sizeof(nanoinit_application_config_t));
+}
+
+bool config_app_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b) {
+    //everything an app is spawned and supervised with; derived data (indices, spawn plan) follows from it
+    if(!config_string_equal(a->name, b->name) || !config_string_equal(a->path, b->path)) {
+        return false;
+    }
+
+    if(a->arg_count != b->arg_count) {
+        return false;
+    }
+
+    for(int i = 0; i < a->arg_count; i++) {
+        if(strcmp(a->args[i], b->args[i]) != 0) {
+            return false;
+        }
+    }
+
+    if((a->autorestart != b->autorestart) || (a->manual != b->manual)) {
+        return false;
+    }
+
+    if((a->restart != b->restart) || (a->restart_mode != b->restart_mode) || (a->restart_delay_ms != b->restart_delay_ms) || (a->restart_delay_max_ms != b->restart_delay_max_ms) ||
+        (a->restart_jitter != b->restart_jitter) || (a->max_restarts != b->max_restarts) || (a->restart_window_ms != b->restart_window_ms)) {
+        return false;
+    }
+
+    if((a->stop_signal != b->stop_signal) || (a->stop_timeout_ms != b->stop_timeout_ms)) {
+        return false;
+    }
+
+    if((a->on_demand != b->on_demand) || (a->idle_timeout_ms != b->idle_timeout_ms)) {
+        return false;
+    }
+
+    if(!config_string_equal(a->stdout_path, b->stdout_path) || !config_string_equal(a->stderr_path, b->stderr_path)) {
+        return false;
+    }
+
+    if((a->capture.console != b->capture.console) || (a->capture.log != b->capture.log) || !config_string_equal(a->capture.file, b->capture.file) || (a->capture.raw != b->capture.raw)) {
+        return false;
+    }
+
+    if(!rotate_policy_equal(&a->log_rotate, &b->log_rotate)) {
+        return false;
+    }
+
+    if(!config_cgroup_equal(a, b)) {
+        return false;
+    }
+
+    //attr is zeroed with the rest of the app before parsing, so padding compares equal too
+    if(memcmp(&a->attr, &b->attr, sizeof(spawn_attr_t)) != 0) {
+        return false;
+    }
+
+    if(a->depends_on_count != b->depends_on_count) {
+        return false;
+    }
+
+    for(int i = 0; i < a->depends_on_count; i++) {
+        if(strcmp(a->depends_on[i], b->depends_on[i]) != 0) {
+            return false;
         }
     }
 
-    return &config;
+    if((a->ready.type != b->ready.type) || !config_string_equal(a->ready.path, b->ready.path) || (a->ready.timeout_ms != b->ready.timeout_ms) ||
+        (a->ready.address_length != b->ready.address_length) || (memcmp(&a->ready.address, &b->ready.address, a->ready.address_length) != 0)) {
+        return false;
+    }
+
+    //the address and the request follow from check
+    if((a->health.type != b->health.type) || !config_string_equal(a->health.check, b->health.check) || (a->health.interval_ms != b->health.interval_ms) ||
+        (a->health.timeout_ms != b->health.timeout_ms) || (a->health.threshold != b->health.threshold)) {
+        return false;
+    }
+
+    return config_sockets_equal(a, b);
+}
+
+bool config_capture_enabled(const nanoinit_capture_config_t *capture) {
+    return capture->console || capture->log || (capture->file != 0);
 }
 
-void config_free() {
-    for(int i = 0; i < config.application_count; i++) {
-        free(config.applications[i].name);
-        free(config.applications[i].path);
+bool config_cgroup_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b) {
+    return config_string_equal(a->cgroup.memory_max, b->cgroup.memory_max) && config_string_equal(a->cgroup.memory_high, b->cgroup.memory_high) &&
+        config_string_equal(a->cgroup.cpu_max, b->cgroup.cpu_max) && config_string_equal(a->cgroup.io_max, b->cgroup.io_max) &&
+        config_string_equal(a->cgroup.pids_max, b->cgroup.pids_max);
+}
+
+bool config_sockets_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b) {
+    //the address follows from listen
+    if(a->socket_count != b->socket_count) {
+        return false;
+    }
 
-        for(int j = 0; j < config.applications[i].arg_count; j++) {
-            free(config.applications[i].args[j]);
+    for(int i = 0; i < a->socket_count; i++) {
+        const nanoinit_socket_config_t *x = &a->sockets[i];
+        const nanoinit_socket_config_t *y = &b->sockets[i];
+        if(!config_string_equal(x->listen, y->listen) || (x->backlog != y->backlog) || (x->reuseport != y->reuseport) || !config_string_equal(x->name, y->name)) {
+            return false;
         }
+    }
 
-        free(config.applications[i].stdout_path);
-        free(config.applications[i].stderr_path);
+    return true;
+}
+
+void config_app_free(nanoinit_application_config_t *app) {
+    free(app->name);
+    free(app->path);
+
+    for(int j = 0; j < app->arg_count; j++) {
+        free(app->args[j]);
+    }
+
+    free(app->args);
+
+    for(int j = 0; j < app->depends_on_count; j++) {
+        free(app->depends_on[j]);
+    }
+    free(app->depends_on);
+    free(app->dependencies);
+    free(app->dependents);
+    free(app->ready.path);
+    free(app->health.check);
+    free(app->health.request);
+
+    free(app->stdout_path);
+    free(app->stderr_path);
+    free(app->capture.file);
+
+    for(int j = 0; j < app->socket_count; j++) {
+        free(app->sockets[j].listen);
+        free(app->sockets[j].name);
+    }
+    free(app->sockets);
+
+    free(app->cgroup.memory_max);
+    free(app->cgroup.memory_high);
+    free(app->cgroup.cpu_max);
+    free(app->cgroup.io_max);
+    free(app->cgroup.pids_max);
+
+    free(app->instance_of);
+    free(app->spawn_plan);
+}
+
+static bool config_string_equal(const char *a, const char *b) {
+    if((a == 0) || (b == 0)) {
+        return a == b;
     }
 
-    free(config.applications);
-    config.applications = 0;
-    config.application_count = 0;
+    return strcmp(a, b) == 0;
 }
 
 static int edJSON_callback(const edJSON_path_t *path, size_t path_size, edJSON_value_t value, void *private) {
@@ -255,20 +651,29 @@ switch_config_message_state:
                     return 1;
                 }
 
-                config.application_count++;
-                config.applications = (nanoinit_application_config_t *)realloc(config.applications, sizeof(nanoinit_application_config_t) * config.application_count);
-                if(config.applications == 0) {
+                config->application_count++;
+                config->applications = (nanoinit_application_config_t *)realloc(config->applications, sizeof(nanoinit_application_config_t) * config->application_count);
+                if(config->applications == 0) {
                     log_ni_error("edJSON_callback() bad memory allocation");
                     config_message->return_code = 3;
                     return 1;
                 }
 
                 //init memory
-                memset(&config.applications[config.application_count - 1], 0, sizeof(nanoinit_application_config_t));
+                memset(&config->applications[config->application_count - 1], 0, sizeof(nanoinit_application_config_t));
+                config->applications[config->application_count - 1].restart_delay_ms = CONFIG_DEFAULT_RESTART_DELAY_MS;
+                config->applications[config->application_count - 1].restart_delay_max_ms = CONFIG_DEFAULT_RESTART_DELAY_MAX_MS;
+                config->applications[config->application_count - 1].restart_jitter = CONFIG_DEFAULT_RESTART_JITTER;
+                config->applications[config->application_count - 1].restart_window_ms = CONFIG_DEFAULT_RESTART_WINDOW_MS;
+                config->applications[config->application_count - 1].stop_timeout_ms = CONFIG_DEFAULT_STOP_TIMEOUT_MS;
+                config->applications[config->application_count - 1].health.interval_ms = CONFIG_DEFAULT_HEALTH_INTERVAL_MS;
+                config->applications[config->application_count - 1].health.timeout_ms = CONFIG_DEFAULT_HEALTH_TIMEOUT_MS;
+                config->applications[config->application_count - 1].health.threshold = CONFIG_DEFAULT_HEALTH_THRESHOLD;
+                config->applications[config->application_count - 1].log_rotate.keep = ROTATE_DEFAULT_KEEP;
 
                 //set name
-                config.applications[config.application_count - 1].name = strdup(current_value);
-                if(config.applications[config.application_count - 1].name == 0) {
+                config->applications[config->application_count - 1].name = strdup(current_value);
+                if(config->applications[config->application_count - 1].name == 0) {
                     log_ni_error("edJSON_callback() bad memory allocation");
                     config_message->return_code = 3;
                     return 1;
@@ -298,13 +703,13 @@ switch_config_message_state:
             //if component is path
             if(strcmp(current_value, "path") == 0) {
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() path should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() path should not have child objects for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
                 if(value.value_type != EDJSON_VT_STRING) {
-                    log_ni_error("edJSON_callback() path value type should be string for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() path value type should be string for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
@@ -316,8 +721,8 @@ switch_config_message_state:
                 }
 
                 //set path
-                config.applications[config.application_count - 1].path = strdup(current_value);
-                if(config.applications[config.application_count - 1].path == 0) {
+                config->applications[config->application_count - 1].path = strdup(current_value);
+                if(config->applications[config->application_count - 1].path == 0) {
                     log_ni_error("edJSON_callback() bad memory allocation");
                     config_message->return_code = 3;
                     return 1;
@@ -326,18 +731,18 @@ switch_config_message_state:
 
             //if component is args
             else if(strcmp(current_value, "args") == 0) {
-                if(path[component].index >= 0) {
+                if((component < path_size) && (path[component].index >= 0)) {
                     component++;
                 }
 
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() argument itself should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() argument itself should not have child objects for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
                 if(value.value_type != EDJSON_VT_STRING) {
-                    log_ni_error("edJSON_callback() argument value type should be string for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() argument value type should be string for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
@@ -349,16 +754,16 @@ switch_config_message_state:
                 }
 
                 //add argument
-                config.applications[config.application_count - 1].arg_count++;
-                config.applications[config.application_count - 1].args = (char **)realloc(config.applications[config.application_count - 1].args, sizeof(char *) * config.applications[config.application_count - 1].arg_count);
-                if(config.applications[config.application_count - 1].args == 0) {
+                config->applications[config->application_count - 1].arg_count++;
+                config->applications[config->application_count - 1].args = (char **)realloc(config->applications[config->application_count - 1].args, sizeof(char *) * config->applications[config->application_count - 1].arg_count);
+                if(config->applications[config->application_count - 1].args == 0) {
                     log_ni_error("edJSON_callback() bad memory allocation");
                     config_message->return_code = 3;
                     return 1;
                 }
 
-                config.applications[config.application_count - 1].args[config.applications[config.application_count - 1].arg_count - 1] = strdup(current_value);
-                if(config.applications[config.application_count - 1].args[config.applications[config.application_count - 1].arg_count - 1] == 0) {
+                config->applications[config->application_count - 1].args[config->applications[config->application_count - 1].arg_count - 1] = strdup(current_value);
+                if(config->applications[config->application_count - 1].args[config->applications[config->application_count - 1].arg_count - 1] == 0) {
                     log_ni_error("edJSON_callback() bad memory allocation");
                     config_message->return_code = 3;
                     return 1;
@@ -368,49 +773,68 @@ switch_config_message_state:
             //if component is autorestart
             else if(strcmp(current_value, "autorestart") == 0) {
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() autorestart should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() autorestart should not have child objects for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
                 if(value.value_type != EDJSON_VT_BOOL) {
-                    log_ni_error("edJSON_callback() autorestart value type should be boolean for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() autorestart value type should be boolean for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
                 //set autorestart
-                config.applications[config.application_count - 1].autorestart = value.value.boolean;
+                config->applications[config->application_count - 1].autorestart = value.value.boolean;
             }
 
-            //if component is manual
-            else if(strcmp(current_value, "manual") == 0) {
+            //if component is restart
+            else if(strcmp(current_value, "restart") == 0) {
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() manual should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() restart should not have child objects for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
-                if(value.value_type != EDJSON_VT_BOOL) {
-                    log_ni_error("edJSON_callback() manual value type boolean be string for app %s", config.applications[config.application_count - 1].name);
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() restart value type should be string for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
-                //set manual
-                config.applications[config.application_count - 1].manual = value.value.boolean;
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set restart
+                if(strcmp(current_value, "always") == 0) {
+                    config->applications[config->application_count - 1].restart = NI_RESTART_ALWAYS;
+                }
+                else if(strcmp(current_value, "on-failure") == 0) {
+                    config->applications[config->application_count - 1].restart = NI_RESTART_ON_FAILURE;
+                }
+                else if(strcmp(current_value, "never") == 0) {
+                    config->applications[config->application_count - 1].restart = NI_RESTART_NEVER;
+                }
+                else {
+                    log_ni_error("edJSON_callback() restart value should be always, on-failure or never for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
             }
 
-            //if component is stdout
-            else if(strcmp(current_value, "stdout") == 0) {
+            //if component is restart_mode
+            else if(strcmp(current_value, "restart_mode") == 0) {
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() stdout should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() restart_mode should not have child objects for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
                 if(value.value_type != EDJSON_VT_STRING) {
-                    log_ni_error("edJSON_callback() stdout value type should be string for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() restart_mode value type should be string for app %s", config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
@@ -421,25 +845,143 @@ switch_config_message_state:
                     return 1;
                 }
 
-                //set stdout_path
-                config.applications[config.application_count - 1].stdout_path = strdup(current_value);
-                if(config.applications[config.application_count - 1].stdout_path == 0) {
-                    log_ni_error("edJSON_callback() bad memory allocation");
-                    config_message->return_code = 3;
+                //set restart_mode
+                if(strcmp(current_value, "stop") == 0) {
+                    config->applications[config->application_count - 1].restart_mode = NI_RESTART_MODE_STOP;
+                }
+                else if(strcmp(current_value, "overlap") == 0) {
+                    config->applications[config->application_count - 1].restart_mode = NI_RESTART_MODE_OVERLAP;
+                }
+                else {
+                    log_ni_error("edJSON_callback() restart_mode value should be stop or overlap for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
                     return 1;
                 }
             }
 
-            //if component is stderr
-            else if(strcmp(current_value, "stderr") == 0) {
+            //if component is restart_delay, restart_delay_max or restart_window
+            else if((strcmp(current_value, "restart_delay") == 0) || (strcmp(current_value, "restart_delay_max") == 0) || (strcmp(current_value, "restart_window") == 0)) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() %s should not have child objects for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                int *target = &config->applications[config->application_count - 1].restart_delay_ms;
+                if(strcmp(current_value, "restart_delay_max") == 0) {
+                    target = &config->applications[config->application_count - 1].restart_delay_max_ms;
+                }
+                else if(strcmp(current_value, "restart_window") == 0) {
+                    target = &config->applications[config->application_count - 1].restart_window_ms;
+                }
+
+                //set restart timing
+                if(config_value_to_ms(value, target) != 0) {
+                    log_ni_error("edJSON_callback() %s value should be a positive number of seconds for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is restart_jitter
+            else if(strcmp(current_value, "restart_jitter") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() restart_jitter should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                double jitter = config_value_to_double(value);
+                if((jitter < 0) || (jitter > 1)) {
+                    log_ni_error("edJSON_callback() restart_jitter value should be a number between 0 and 1 for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set restart_jitter
+                config->applications[config->application_count - 1].restart_jitter = jitter;
+            }
+
+            //if component is max_restarts
+            else if(strcmp(current_value, "max_restarts") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() max_restarts should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if((value.value_type != EDJSON_VT_INTEGER) || (value.value.integer < 0)) {
+                    log_ni_error("edJSON_callback() max_restarts value should be a positive integer for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set max_restarts
+                config->applications[config->application_count - 1].max_restarts = value.value.integer;
+            }
+
+            //if component is stop_signal
+            else if(strcmp(current_value, "stop_signal") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() stop_signal should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                int signo = -1;
+                if(value.value_type == EDJSON_VT_INTEGER) {
+                    signo = (int)value.value.integer;
+                }
+                else if(value.value_type == EDJSON_VT_STRING) {
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+
+                    signo = config_parse_signal(current_value);
+                }
+
+                if((signo <= 0) || (signo >= NSIG)) {
+                    log_ni_error("edJSON_callback() stop_signal value should be a signal name or number for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set stop_signal
+                config->applications[config->application_count - 1].stop_signal = signo;
+            }
+
+            //if component is stop_timeout
+            else if(strcmp(current_value, "stop_timeout") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() stop_timeout should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set stop_timeout
+                if(config_value_to_ms(value, &config->applications[config->application_count - 1].stop_timeout_ms) != 0) {
+                    log_ni_error("edJSON_callback() stop_timeout value should be a positive number of seconds for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is cpus or numa_nodes
+            else if((strcmp(current_value, "cpus") == 0) || (strcmp(current_value, "numa_nodes") == 0)) {
                 if(path_size != component) {
-                    log_ni_error("edJSON_callback() stderr should not have child objects for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() %s should not have child objects for app %s", current_value, config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
 
+                spawn_attr_t *attr = &config->applications[config->application_count - 1].attr;
+                bool cpus = (strcmp(current_value, "cpus") == 0);
+                const char *key = cpus ? "cpus" : "numa_nodes";
+
                 if(value.value_type != EDJSON_VT_STRING) {
-                    log_ni_error("edJSON_callback() stderr value type should be string for app %s", config.applications[config.application_count - 1].name);
+                    log_ni_error("edJSON_callback() %s value type should be string for app %s", key, config->applications[config->application_count - 1].name);
                     config_message->return_code = 2;
                     return 1;
                 }
@@ -450,30 +992,1652 @@ switch_config_message_state:
                     return 1;
                 }
 
-                //set stderr_path
-                config.applications[config.application_count - 1].stderr_path = strdup(current_value);
-                if(config.applications[config.application_count - 1].stderr_path == 0) {
-                    log_ni_error("edJSON_callback() bad memory allocation");
-                    config_message->return_code = 3;
+                //set cpus or numa_nodes
+                rc = cpus ? config_parse_mask(current_value, attr->cpus, SPAWN_CPUS_MAX) : config_parse_mask(current_value, attr->numa_nodes, SPAWN_NUMA_NODES_MAX);
+                if(rc != 0) {
+                    log_ni_error("edJSON_callback() %s value should be a list such as \"0-3,8\" for app %s", key, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
                     return 1;
                 }
-            }
 
-            //if component is anything lese
-            else {
-                config_message->return_code = 2;    //invalid parameter
-                return 1;
+                if(cpus) {
+                    attr->has_cpus = true;
+                }
+                else {
+                    attr->has_numa_nodes = true;
+                }
             }
-        } break;
 
-        case CONFIG_STATE_FINISHED: {
+            //if component is sched_policy
+            else if(strcmp(current_value, "sched_policy") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() sched_policy should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() sched_policy value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set sched_policy
+                spawn_attr_t *attr = &config->applications[config->application_count - 1].attr;
+                if(strcmp(current_value, "other") == 0) {
+                    attr->sched_policy = SPAWN_SCHED_OTHER;
+                }
+                else if(strcmp(current_value, "batch") == 0) {
+                    attr->sched_policy = SPAWN_SCHED_BATCH;
+                }
+                else if(strcmp(current_value, "idle") == 0) {
+                    attr->sched_policy = SPAWN_SCHED_IDLE;
+                }
+                else if(strcmp(current_value, "fifo") == 0) {
+                    attr->sched_policy = SPAWN_SCHED_FIFO;
+                }
+                else if(strcmp(current_value, "rr") == 0) {
+                    attr->sched_policy = SPAWN_SCHED_RR;
+                }
+                else {
+                    log_ni_error("edJSON_callback() sched_policy value should be other, batch, idle, fifo or rr for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is sched_priority, nice or ioprio_level
+            else if((strcmp(current_value, "sched_priority") == 0) || (strcmp(current_value, "nice") == 0) || (strcmp(current_value, "ioprio_level") == 0)) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() %s should not have child objects for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                spawn_attr_t *attr = &config->applications[config->application_count - 1].attr;
+                int *target = &attr->sched_priority;
+                int min = 1;
+                int max = 99;
+                if(strcmp(current_value, "nice") == 0) {
+                    target = &attr->nice;
+                    attr->has_nice = true;
+                    min = -20;
+                    max = 19;
+                }
+                else if(strcmp(current_value, "ioprio_level") == 0) {
+                    target = &attr->ioprio_level;
+                    min = 0;
+                    max = 7;
+                }
+
+                if((value.value_type != EDJSON_VT_INTEGER) || (value.value.integer < min) || (value.value.integer > max)) {
+                    log_ni_error("edJSON_callback() %s value should be an integer between %d and %d for app %s", current_value, min, max, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set sched_priority, nice or ioprio_level
+                *target = (int)value.value.integer;
+            }
+
+            //if component is ioprio_class
+            else if(strcmp(current_value, "ioprio_class") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() ioprio_class should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() ioprio_class value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set ioprio_class
+                spawn_attr_t *attr = &config->applications[config->application_count - 1].attr;
+                if(strcmp(current_value, "realtime") == 0) {
+                    attr->ioprio_class = SPAWN_IOPRIO_REALTIME;
+                }
+                else if(strcmp(current_value, "best-effort") == 0) {
+                    attr->ioprio_class = SPAWN_IOPRIO_BEST_EFFORT;
+                }
+                else if(strcmp(current_value, "idle") == 0) {
+                    attr->ioprio_class = SPAWN_IOPRIO_IDLE;
+                }
+                else {
+                    log_ni_error("edJSON_callback() ioprio_class value should be realtime, best-effort or idle for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is a cgroup limit
+            else if((strcmp(current_value, "memory_max") == 0) || (strcmp(current_value, "memory_high") == 0) || (strcmp(current_value, "cpu_max") == 0) ||
+                    (strcmp(current_value, "io_max") == 0) || (strcmp(current_value, "pids_max") == 0)) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() %s should not have child objects for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                nanoinit_cgroup_config_t *cgroup = &config->applications[config->application_count - 1].cgroup;
+                char **target = &cgroup->memory_max;
+                if(strcmp(current_value, "memory_high") == 0) {
+                    target = &cgroup->memory_high;
+                }
+                else if(strcmp(current_value, "cpu_max") == 0) {
+                    target = &cgroup->cpu_max;
+                }
+                else if(strcmp(current_value, "io_max") == 0) {
+                    target = &cgroup->io_max;
+                }
+                else if(strcmp(current_value, "pids_max") == 0) {
+                    target = &cgroup->pids_max;
+                }
+
+                char key[JSON_PARSE_BUFFER_SIZE];
+                strcpy(key, current_value);
+
+                if(value.value_type == EDJSON_VT_STRING) {
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+                }
+
+                //set the limit, in the format of the cgroup file
+                free(*target);
+                *target = config_parse_cgroup_limit(key, value, current_value);
+                if(*target == 0) {
+                    log_ni_error("edJSON_callback() invalid %s value for app %s", key, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is rlimits
+            else if(strcmp(current_value, "rlimits") == 0) {
+                //"rlimits": { "nofile": 65536, "core": [0, "unlimited"] }
+                if((component >= path_size) || (path[component].index >= 0)) {
+                    log_ni_error("edJSON_callback() rlimits should be an object for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, path[component].value, path[component].value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                int resource = config_parse_rlimit(current_value);
+                if(resource < 0) {
+                    log_ni_error("edJSON_callback() unknown rlimit %s for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+                component++;
+
+                //a single value sets both soft and hard limit; [soft, hard] sets them apart
+                int index = -1;
+                if((component < path_size) && (path[component].index >= 0)) {
+                    index = path[component].index;
+                    component++;
+                }
+
+                if((path_size != component) || (index > 1)) {
+                    log_ni_error("edJSON_callback() rlimit %s should be a value or [soft, hard] for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                char name[JSON_PARSE_BUFFER_SIZE];
+                strcpy(name, current_value);
+
+                long long number = -1;
+                bool unlimited = false;
+                if(value.value_type == EDJSON_VT_INTEGER) {
+                    number = value.value.integer;
+                }
+                else if(value.value_type == EDJSON_VT_STRING) {
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+
+                    if((strcmp(current_value, "unlimited") == 0) || (strcmp(current_value, "infinity") == 0)) {
+                        unlimited = true;
+                    }
+                    else if(config_parse_size(current_value, true, &number) != 0) {
+                        number = -1;
+                    }
+                }
+
+                if((number < 0) && !unlimited) {
+                    log_ni_error("edJSON_callback() rlimit %s value should be a positive integer, a size such as \"64M\" or \"unlimited\" for app %s", name, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                spawn_attr_t *attr = &config->applications[config->application_count - 1].attr;
+                spawn_rlimit_t *rlimit = 0;
+                for(int i = 0; i < attr->rlimit_count; i++) {
+                    if(attr->rlimits[i].resource == resource) {
+                        rlimit = &attr->rlimits[i];
+                    }
+                }
+
+                if(rlimit == 0) {
+                    rlimit = &attr->rlimits[attr->rlimit_count++];
+                    rlimit->resource = resource;
+                }
+
+                //set the rlimit
+                rlim_t limit = unlimited ? RLIM_INFINITY : (rlim_t)number;
+                if(index != 1) {
+                    rlimit->limit.rlim_cur = limit;
+                }
+
+                if(index != 0) {
+                    rlimit->limit.rlim_max = limit;
+                }
+                else {
+                    rlimit->limit.rlim_max = rlimit->limit.rlim_cur;    //until the hard limit follows
+                }
+            }
+
+            //if component is manual
+            else if(strcmp(current_value, "manual") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() manual should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_BOOL) {
+                    log_ni_error("edJSON_callback() manual value type boolean be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set manual
+                config->applications[config->application_count - 1].manual = value.value.boolean;
+            }
+
+            //if component is on_demand
+            else if(strcmp(current_value, "on_demand") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() on_demand should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_BOOL) {
+                    log_ni_error("edJSON_callback() on_demand value should be boolean for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set on_demand
+                config->applications[config->application_count - 1].on_demand = value.value.boolean;
+            }
+
+            //if component is instances
+            else if(strcmp(current_value, "instances") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() instances should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                int instances = 0;
+                if((value.value_type == EDJSON_VT_INTEGER) && (value.value.integer >= 1) && (value.value.integer <= CONFIG_INSTANCES_MAX)) {
+                    instances = (int)value.value.integer;
+                }
+                else if(value.value_type == EDJSON_VT_STRING) {
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+
+                    if(strcmp(current_value, "auto") == 0) {
+                        instances = -1;
+                    }
+                }
+
+                if(instances == 0) {
+                    log_ni_error("edJSON_callback() instances value should be an integer from 1 to %d or \"auto\" for app %s", CONFIG_INSTANCES_MAX, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set instances
+                config->applications[config->application_count - 1].instances = instances;
+            }
+
+            //if component is pin_instances
+            else if(strcmp(current_value, "pin_instances") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() pin_instances should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_BOOL) {
+                    log_ni_error("edJSON_callback() pin_instances value should be boolean for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set pin_instances
+                config->applications[config->application_count - 1].pin_instances = value.value.boolean;
+            }
+
+            //if component is idle_timeout
+            else if(strcmp(current_value, "idle_timeout") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() idle_timeout should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set idle_timeout
+                if(config_value_to_ms(value, &config->applications[config->application_count - 1].idle_timeout_ms) != 0) {
+                    log_ni_error("edJSON_callback() idle_timeout value should be a positive number of seconds for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is stdout
+            else if(strcmp(current_value, "stdout") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() stdout should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() stdout value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set stdout_path
+                config->applications[config->application_count - 1].stdout_path = strdup(current_value);
+                if(config->applications[config->application_count - 1].stdout_path == 0) {
+                    log_ni_error("edJSON_callback() bad memory allocation");
+                    config_message->return_code = 3;
+                    return 1;
+                }
+            }
+
+            //if component is stderr
+            else if(strcmp(current_value, "stderr") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() stderr should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() stderr value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set stderr_path
+                config->applications[config->application_count - 1].stderr_path = strdup(current_value);
+                if(config->applications[config->application_count - 1].stderr_path == 0) {
+                    log_ni_error("edJSON_callback() bad memory allocation");
+                    config_message->return_code = 3;
+                    return 1;
+                }
+            }
+
+            //if component is depends_on
+            else if(strcmp(current_value, "depends_on") == 0) {
+                if((component < path_size) && (path[component].index >= 0)) {
+                    component++;
+                }
+
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() depends_on itself should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() depends_on value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //add dependency
+                nanoinit_application_config_t *app = &config->applications[config->application_count - 1];
+                app->depends_on_count++;
+                app->depends_on = (char **)realloc(app->depends_on, sizeof(char *) * app->depends_on_count);
+                if(app->depends_on == 0) {
+                    log_ni_error("edJSON_callback() bad memory allocation");
+                    config_message->return_code = 3;
+                    return 1;
+                }
+
+                app->depends_on[app->depends_on_count - 1] = strdup(current_value);
+                if(app->depends_on[app->depends_on_count - 1] == 0) {
+                    log_ni_error("edJSON_callback() bad memory allocation");
+                    config_message->return_code = 3;
+                    return 1;
+                }
+            }
+
+            //if component is ready
+            else if(strcmp(current_value, "ready") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() ready should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() ready value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set ready
+                rc = config_parse_ready(&config->applications[config->application_count - 1].ready, current_value);
+                if(rc != 0) {
+                    log_ni_error("edJSON_callback() invalid ready value '%s' for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = (rc == -2) ? 3 : 2;
+                    return 1;
+                }
+            }
+
+            //if component is sockets
+            else if(strcmp(current_value, "sockets") == 0) {
+                //"sockets": "tcp:8080", or an array of such strings and of { "listen": ..., "backlog": ..., "reuseport": ..., "name": ... } objects
+                nanoinit_application_config_t *app = &config->applications[config->application_count - 1];
+                int index = 0;
+                if((component < path_size) && (path[component].index >= 0)) {
+                    index = path[component].index;
+                    component++;
+                }
+
+                //elements are reported in order, so a new index is always the next one
+                if(index == app->socket_count) {
+                    if(app->socket_count == SPAWN_LISTEN_FDS_MAX) {
+                        log_ni_error("edJSON_callback() more than %d sockets for app %s", SPAWN_LISTEN_FDS_MAX, app->name);
+                        config_message->return_code = 2;
+                        return 1;
+                    }
+
+                    nanoinit_socket_config_t *sockets = (nanoinit_socket_config_t *)realloc(app->sockets, sizeof(nanoinit_socket_config_t) * (app->socket_count + 1));
+                    if(sockets == 0) {
+                        log_ni_error("edJSON_callback() bad memory allocation");
+                        config_message->return_code = 3;
+                        return 1;
+                    }
+
+                    app->sockets = sockets;
+                    memset(&app->sockets[app->socket_count], 0, sizeof(nanoinit_socket_config_t));
+                    app->sockets[app->socket_count].backlog = SOMAXCONN;
+                    app->socket_count++;
+                }
+                if(index >= app->socket_count) {
+                    log_ni_error("edJSON_callback() invalid sockets array for app %s", app->name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+                nanoinit_socket_config_t *socket = &app->sockets[index];
+
+                const char *field = "listen";
+                char field_buffer[16];
+                if(component < path_size) {
+                    rc = edJSON_string_unescape(field_buffer, sizeof(field_buffer), path[component].value, path[component].value_size);
+                    if((rc < EDJSON_SUCCESS) || (path[component].index >= 0) || (component + 1 != path_size)) {
+                        log_ni_error("edJSON_callback() invalid socket parameter for app %s", app->name);
+                        config_message->return_code = 2;
+                        return 1;
+                    }
+                    field = field_buffer;
+                }
+
+                if((strcmp(field, "listen") == 0) || (strcmp(field, "name") == 0)) {
+                    if(value.value_type != EDJSON_VT_STRING) {
+                        log_ni_error("edJSON_callback() socket %s should be a string for app %s", field, app->name);
+                        config_message->return_code = 2;
+                        return 1;
+                    }
+
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+
+                    if(strcmp(field, "name") == 0) {
+                        //LISTEN_FDNAMES is colon-separated
+                        if((current_value[0] == 0) || strchr(current_value, ':')) {
+                            log_ni_error("edJSON_callback() socket name '%s' should be non-empty and without ':' for app %s", current_value, app->name);
+                            config_message->return_code = 2;
+                            return 1;
+                        }
+
+                        free(socket->name);
+                        socket->name = strdup(current_value);
+                        if(socket->name == 0) {
+                            log_ni_error("edJSON_callback() bad memory allocation");
+                            config_message->return_code = 3;
+                            return 1;
+                        }
+                    }
+                    else {
+                        rc = config_parse_listen(socket, current_value);
+                        if(rc != 0) {
+                            log_ni_error("edJSON_callback() invalid socket '%s' for app %s; expected tcp:[host:]port, udp:[host:]port or unix:/path", current_value, app->name);
+                            config_message->return_code = (rc == -2) ? 3 : 2;
+                            return 1;
+                        }
+                    }
+                }
+                else if(strcmp(field, "backlog") == 0) {
+                    if((value.value_type != EDJSON_VT_INTEGER) || (value.value.integer <= 0) || (value.value.integer > 65535)) {
+                        log_ni_error("edJSON_callback() socket backlog should be an integer from 1 to 65535 for app %s", app->name);
+                        config_message->return_code = 2;
+                        return 1;
+                    }
+                    socket->backlog = (int)value.value.integer;
+                }
+                else if(strcmp(field, "reuseport") == 0) {
+                    if(value.value_type != EDJSON_VT_BOOL) {
+                        log_ni_error("edJSON_callback() socket reuseport should be a boolean for app %s", app->name);
+                        config_message->return_code = 2;
+                        return 1;
+                    }
+                    socket->reuseport = value.value.boolean;
+                }
+                else {
+                    log_ni_error("edJSON_callback() unknown socket parameter %s for app %s", field, app->name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is capture
+            else if(strcmp(current_value, "capture") == 0) {
+                //"capture": "console", or an array of "console", "log" and "file:/path"
+                if((component < path_size) && (path[component].index >= 0)) {
+                    component++;
+                }
+
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() capture itself should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() capture value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //add capture destination
+                nanoinit_capture_config_t *capture = &config->applications[config->application_count - 1].capture;
+                if(strcmp(current_value, "console") == 0) {
+                    capture->console = true;
+                }
+                else if(strcmp(current_value, "log") == 0) {
+                    capture->log = true;
+                }
+                else if((strncmp(current_value, "file:", 5) == 0) && (current_value[5] != 0) && (capture->file == 0)) {
+                    capture->file = strdup(current_value + 5);
+                    if(capture->file == 0) {
+                        log_ni_error("edJSON_callback() bad memory allocation");
+                        config_message->return_code = 3;
+                        return 1;
+                    }
+                }
+                else {
+                    log_ni_error("edJSON_callback() invalid capture value '%s' for app %s; expected console, log or a single file:/path", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is capture_format
+            else if(strcmp(current_value, "capture_format") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() capture_format should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() capture_format value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set capture_format
+                if(strcmp(current_value, "tagged") == 0) {
+                    config->applications[config->application_count - 1].capture.raw = false;
+                }
+                else if(strcmp(current_value, "raw") == 0) {
+                    config->applications[config->application_count - 1].capture.raw = true;
+                }
+                else {
+                    log_ni_error("edJSON_callback() invalid capture_format '%s' for app %s; expected tagged or raw", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is log_max_size
+            else if(strcmp(current_value, "log_max_size") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() log_max_size should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                long long number = -1;
+                if(value.value_type == EDJSON_VT_INTEGER) {
+                    number = value.value.integer;
+                }
+                else if(value.value_type == EDJSON_VT_STRING) {
+                    rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                    if(rc < EDJSON_SUCCESS) {
+                        config_message->return_code = 4;
+                        return 1;
+                    }
+
+                    if(config_parse_size(current_value, true, &number) != 0) {
+                        number = -1;
+                    }
+                }
+
+                if(number < 0) {
+                    log_ni_error("edJSON_callback() log_max_size value should be a positive integer or a size such as \"10M\" for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set log_max_size
+                config->applications[config->application_count - 1].log_rotate.max_size = number;
+            }
+
+            //if component is log_max_age
+            else if(strcmp(current_value, "log_max_age") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() log_max_age should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set log_max_age
+                if(config_value_to_ms(value, &config->applications[config->application_count - 1].log_rotate.max_age_ms) != 0) {
+                    log_ni_error("edJSON_callback() log_max_age value should be a positive number of seconds for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is log_keep
+            else if(strcmp(current_value, "log_keep") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() log_keep should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if((value.value_type != EDJSON_VT_INTEGER) || (value.value.integer < 0) || (value.value.integer > ROTATE_KEEP_MAX)) {
+                    log_ni_error("edJSON_callback() log_keep value should be an integer from 0 to %d for app %s", ROTATE_KEEP_MAX, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set log_keep
+                config->applications[config->application_count - 1].log_rotate.keep = (int)value.value.integer;
+            }
+
+            //if component is health
+            else if(strcmp(current_value, "health") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() health should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if(value.value_type != EDJSON_VT_STRING) {
+                    log_ni_error("edJSON_callback() health value type should be string for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                rc = edJSON_string_unescape(current_value, JSON_PARSE_BUFFER_SIZE, value.value.string.value, value.value.string.value_size);
+                if(rc < EDJSON_SUCCESS) {
+                    config_message->return_code = 4;
+                    return 1;
+                }
+
+                //set health
+                rc = config_parse_health(&config->applications[config->application_count - 1].health, current_value);
+                if(rc != 0) {
+                    log_ni_error("edJSON_callback() invalid health value '%s' for app %s; expected tcp:[host:]port, http:[host:]port[/path] or unix:/path", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = (rc == -2) ? 3 : 2;
+                    return 1;
+                }
+            }
+
+            //if component is health_interval or health_timeout
+            else if((strcmp(current_value, "health_interval") == 0) || (strcmp(current_value, "health_timeout") == 0)) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() %s should not have child objects for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set health_interval or health_timeout
+                nanoinit_health_config_t *health = &config->applications[config->application_count - 1].health;
+                if(config_value_to_ms(value, (strcmp(current_value, "health_interval") == 0) ? &health->interval_ms : &health->timeout_ms) != 0) {
+                    log_ni_error("edJSON_callback() %s value should be a positive number of seconds for app %s", current_value, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is health_threshold
+            else if(strcmp(current_value, "health_threshold") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() health_threshold should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                if((value.value_type != EDJSON_VT_INTEGER) || (value.value.integer < 1) || (value.value.integer > CONFIG_HEALTH_THRESHOLD_MAX)) {
+                    log_ni_error("edJSON_callback() health_threshold value should be an integer from 1 to %d for app %s", CONFIG_HEALTH_THRESHOLD_MAX, config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set health_threshold
+                config->applications[config->application_count - 1].health.threshold = (int)value.value.integer;
+            }
+
+            //if component is ready_timeout
+            else if(strcmp(current_value, "ready_timeout") == 0) {
+                if(path_size != component) {
+                    log_ni_error("edJSON_callback() ready_timeout should not have child objects for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+
+                //set ready_timeout
+                if(config_value_to_ms(value, &config->applications[config->application_count - 1].ready.timeout_ms) != 0) {
+                    log_ni_error("edJSON_callback() ready_timeout value should be a positive number of seconds for app %s", config->applications[config->application_count - 1].name);
+                    config_message->return_code = 2;
+                    return 1;
+                }
+            }
+
+            //if component is anything lese
+            else {
+                config_message->return_code = 2;    //invalid parameter
+                return 1;
+            }
+        } break;
+
+        case CONFIG_STATE_FINISHED: {
             config_message->return_code = 0;
             return 1;   //stop parsing
         }
 
-        default:
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static int config_parse_ready(nanoinit_ready_config_t *ready, const char *spec) {
+    //"notify", "exit", "file:/path/to/file", "tcp:port" or "tcp:host:port"; host must be an IPv4 or IPv6 ([...]) literal
+    if(strcmp(spec, "notify") == 0) {
+        ready->type = NI_READY_NOTIFY;
+        return 0;
+    }
+
+    if(strcmp(spec, "exit") == 0) {
+        ready->type = NI_READY_EXIT;
+        return 0;
+    }
+
+    if(strncmp(spec, "file:", 5) == 0) {
+        if(spec[5] == 0) {
+            return -1;
+        }
+
+        free(ready->path);
+        ready->path = strdup(spec + 5);
+        if(ready->path == 0) {
+            return -2;
+        }
+
+        ready->type = NI_READY_FILE;
+        return 0;
+    }
+
+    if(strncmp(spec, "tcp:", 4) == 0) {
+        if(address_parse_inet(spec + 4, "127.0.0.1", &ready->address, &ready->address_length) != 0) {
+            return -1;
+        }
+
+        ready->type = NI_READY_TCP;
+        return 0;
+    }
+
+    return -1;
+}
+
+static int config_parse_listen(nanoinit_socket_config_t *socket, const char *spec) {
+    //a %i template is checked as instance 0; each instance parses its own address again when instances are expanded
+    char *resolved = 0;
+    if(config_instance_string(spec, 0, &resolved) != 0) {
+        return -2;
+    }
+
+    //listeners bind to every interface unless a host is given
+    int rc = -1;
+    if(strncmp(resolved, "tcp:", 4) == 0) {
+        socket->type = SOCK_STREAM;
+        rc = address_parse_inet(resolved + 4, "0.0.0.0", &socket->address, &socket->address_length);
+    }
+    else if(strncmp(resolved, "udp:", 4) == 0) {
+        socket->type = SOCK_DGRAM;
+        rc = address_parse_inet(resolved + 4, "0.0.0.0", &socket->address, &socket->address_length);
+    }
+    else if(strncmp(resolved, "unix:", 5) == 0) {
+        socket->type = SOCK_STREAM;
+        rc = address_parse_unix(resolved + 5, &socket->address, &socket->address_length);
+    }
+    free(resolved);
+    if(rc != 0) {
+        return -1;
+    }
+
+    free(socket->listen);
+    socket->listen = strdup(spec);
+    if(socket->listen == 0) {
+        return -2;
+    }
+
+    return 0;
+}
+
+static int config_parse_health(nanoinit_health_config_t *health, const char *spec) {
+    //"tcp:[host:]port", "http:[host:]port[/path]" or "unix:/path"; hosts default to 127.0.0.1, as probes run from inside the container
+    //like socket addresses, a %i template is checked as instance 0 and parsed again per instance
+    char *resolved = 0;
+    if(config_instance_string(spec, 0, &resolved) != 0) {
+        return -2;
+    }
+
+    int rc = config_parse_health_resolved(health, resolved);
+    free(resolved);
+    if(rc != 0) {
+        return rc;
+    }
+
+    char *check = strdup(spec);
+    if(check == 0) {
+        return -2;
+    }
+
+    free(health->check);
+    health->check = check;
+    return 0;
+}
+
+static int config_parse_health_resolved(nanoinit_health_config_t *health, const char *spec) {
+    nanoinit_health_type_t type;
+    char *request = 0;
+    int request_length = 0;
+    if(strncmp(spec, "tcp:", 4) == 0) {
+        type = NI_HEALTH_TCP;
+        if(address_parse_inet(spec + 4, "127.0.0.1", &health->address, &health->address_length) != 0) {
+            return -1;
+        }
+    }
+    else if(strncmp(spec, "http:", 5) == 0) {
+        type = NI_HEALTH_HTTP;
+        const char *path = strchr(spec + 5, '/');
+        size_t host_length = path ? (size_t)(path - (spec + 5)) : strlen(spec + 5);
+        char host[128];
+        if(host_length >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, spec + 5, host_length);
+        host[host_length] = 0;
+        if(address_parse_inet(host, "127.0.0.1", &health->address, &health->address_length) != 0) {
+            return -1;
+        }
+
+        if(path && (strpbrk(path, " \r\n") != 0)) {
+            return -1;
+        }
+
+        //the request never changes, so it is built here once; probes only write it out
+        const char *format = "GET %s HTTP/1.1\r\nHost: %s%s\r\nUser-Agent: nanoinit\r\nConnection: close\r\n\r\n";
+        const char *host_prefix = strchr(host, ':') ? "" : "localhost:";
+        request_length = snprintf(0, 0, format, path ? path : "/", host_prefix, host);
+        request = (char *)malloc(request_length + 1);
+        if(request == 0) {
+            return -2;
+        }
+        snprintf(request, request_length + 1, format, path ? path : "/", host_prefix, host);
+    }
+    else if(strncmp(spec, "unix:", 5) == 0) {
+        type = NI_HEALTH_UNIX;
+        if(address_parse_unix(spec + 5, &health->address, &health->address_length) != 0) {
+            return -1;
+        }
+    }
+    else {
+        return -1;
+    }
+
+    free(health->request);
+    health->type = type;
+    health->request = request;
+    health->request_length = request_length;
+    return 0;
+}
+
+static int config_value_to_ms(edJSON_value_t value, int *ms) {
+    //timeouts are given in seconds, as integer or floating point
+    double seconds = config_value_to_double(value);
+    if((seconds < 0) || (seconds > 2000000)) {
+        return -1;
+    }
+
+    *ms = (int)(seconds * 1000.0);
+    return 0;
+}
+
+int config_parse_signal(const char *name) {
+    static const struct {
+        const char *name;
+        int signo;
+    } signals[] = {
+        { "HUP", SIGHUP },
+        { "INT", SIGINT },
+        { "QUIT", SIGQUIT },
+        { "KILL", SIGKILL },
+        { "USR1", SIGUSR1 },
+        { "USR2", SIGUSR2 },
+        { "TERM", SIGTERM },
+        { "WINCH", SIGWINCH },
+        { "PWR", SIGPWR },
+        { "ABRT", SIGABRT },
+        { "ALRM", SIGALRM },
+        { "CONT", SIGCONT },
+        { "STOP", SIGSTOP },
+        { "TSTP", SIGTSTP },
+    };
+
+    //accepts "SIGTERM", "TERM" or "15"
+    if(strncmp(name, "SIG", 3) == 0) {
+        name += 3;
+    }
+
+    for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+        if(strcmp(name, signals[i].name) == 0) {
+            return signals[i].signo;
+        }
+    }
+
+    char *end;
+    long signo = strtol(name, &end, 10);
+    if((*name == 0) || (*end != 0)) {
+        return -1;
+    }
+
+    return (int)signo;
+}
+
+static char *config_parse_cgroup_limit(const char *key, edJSON_value_t value, const char *string) {
+    char result[64];
+    bool is_string = (value.value_type == EDJSON_VT_STRING);
+
+    //io_max is passed through as "MAJ:MIN rbps=... wbps=..."; the kernel validates it when the app's cgroup is set up
+    if(strcmp(key, "io_max") == 0) {
+        return (is_string && string[0]) ? strdup(string) : 0;
+    }
+
+    if(is_string && (strcmp(string, "max") == 0)) {
+        return strdup("max");
+    }
+
+    //cpu_max is a number of CPUs, or "quota period" in microseconds
+    if(strcmp(key, "cpu_max") == 0) {
+        if(is_string) {
+            long quota, period;
+            char extra;
+            if((sscanf(string, "%ld %ld %c", &quota, &period, &extra) != 2) || (quota <= 0) || (period <= 0)) {
+                return 0;
+            }
+            return strdup(string);
+        }
+
+        double cpus = config_value_to_double(value);
+        if(cpus <= 0) {
+            return 0;
+        }
+
+        snprintf(result, sizeof(result), "%ld 100000", (long)(cpus * 100000.0));
+        return strdup(result);
+    }
+
+    //pids_max is a count, memory limits are bytes with an optional K, M, G or T suffix
+    long long number = -1;
+    if(value.value_type == EDJSON_VT_INTEGER) {
+        number = value.value.integer;
+    }
+    else if(is_string && (config_parse_size(string, strcmp(key, "pids_max") != 0, &number) != 0)) {
+        return 0;
+    }
+
+    if(number < 0) {
+        return 0;
+    }
+
+    snprintf(result, sizeof(result), "%lld", number);
+    return strdup(result);
+}
+
+static int config_parse_rlimit(const char *name) {
+    static const struct {
+        const char *name;
+        int resource;
+    } rlimits[] = {
+        { "as", RLIMIT_AS },
+        { "core", RLIMIT_CORE },
+        { "cpu", RLIMIT_CPU },
+        { "data", RLIMIT_DATA },
+        { "fsize", RLIMIT_FSIZE },
+        { "locks", RLIMIT_LOCKS },
+        { "memlock", RLIMIT_MEMLOCK },
+        { "msgqueue", RLIMIT_MSGQUEUE },
+        { "nice", RLIMIT_NICE },
+        { "nofile", RLIMIT_NOFILE },
+        { "nproc", RLIMIT_NPROC },
+        { "rss", RLIMIT_RSS },
+        { "rtprio", RLIMIT_RTPRIO },
+        { "rttime", RLIMIT_RTTIME },
+        { "sigpending", RLIMIT_SIGPENDING },
+        { "stack", RLIMIT_STACK },
+    };
+
+    for(size_t i = 0; i < sizeof(rlimits) / sizeof(rlimits[0]); i++) {
+        if(strcmp(name, rlimits[i].name) == 0) {
+            return rlimits[i].resource;
+        }
+    }
+
+    return -1;
+}
+
+int config_parse_size(const char *string, bool suffixes, long long *number) {
+    char *end;
+    errno = 0;
+    *number = strtoll(string, &end, 10);
+    if((end == string) || (*number < 0) || (errno == ERANGE)) {
+        return -1;
+    }
+
+    if(suffixes) {
+        const char *units = "KMGT";
+        const char *unit = (*end) ? strchr(units, *end) : 0;
+        if(unit) {
+            //a size that doesn't fit would wrap into a bogus limit
+            int shift = 10 * (int)(unit - units + 1);
+            if(*number > (LLONG_MAX >> shift)) {
+                return -1;
+            }
+            *number <<= shift;
+            end++;
+        }
+    }
+
+    return (*end == 0) ? 0 : -1;
+}
+
+static int config_parse_mask(const char *list, unsigned long *mask, int bits) {
+    //kernel list format, as in /sys/devices/system/cpu/online: "0-3,8,10-11"
+    const size_t word_bits = 8 * sizeof(unsigned long);
+    memset(mask, 0, bits / 8);
+
+    const char *cursor = list;
+    do {
+        char *end;
+        long first = strtol(cursor, &end, 10);
+        if((end == cursor) || (first < 0)) {
+            return -1;
+        }
+
+        long last = first;
+        cursor = end;
+        if(*cursor == '-') {
+            cursor++;
+            last = strtol(cursor, &end, 10);
+            if((end == cursor) || (last < first)) {
+                return -1;
+            }
+            cursor = end;
+        }
+
+        if(last >= bits) {
+            return -1;
+        }
+
+        for(long i = first; i <= last; i++) {
+            mask[i / word_bits] |= 1UL << (i % word_bits);
+        }
+    } while((*cursor == ',') && (*++cursor != 0));
+
+    //trailing newline as found in sysfs
+    return ((*cursor == 0) || (*cursor == '\n')) ? 0 : -1;
+}
+
+static int config_check_online(const char *online_path, const unsigned long *mask, int bits, int fallback_count, const char *what, const char *app) {
+    const size_t word_bits = 8 * sizeof(unsigned long);
+    unsigned long online[SPAWN_MASK_WORDS(SPAWN_CPUS_MAX > SPAWN_NUMA_NODES_MAX ? SPAWN_CPUS_MAX : SPAWN_NUMA_NODES_MAX)];
+
+    char list[JSON_PARSE_BUFFER_SIZE] = {0};
+    FILE *f = fopen(online_path, "r");
+    bool have_list = false;
+    if(f) {
+        have_list = (fgets(list, sizeof(list), f) != 0) && (config_parse_mask(list, online, bits) == 0);
+        fclose(f);
+    }
+
+    if(!have_list) {
+        //no sysfs (or no NUMA support): assume the first fallback_count are online
+        memset(online, 0, bits / 8);
+        for(int i = 0; (i < fallback_count) && (i < bits); i++) {
+            online[i / word_bits] |= 1UL << (i % word_bits);
+        }
+    }
+
+    for(int i = 0; i < bits; i++) {
+        if((mask[i / word_bits] & (1UL << (i % word_bits))) && !(online[i / word_bits] & (1UL << (i % word_bits)))) {
+            log_ni_error("config_init() %s %d of app %s is not online", what, i, app);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static double config_value_to_double(edJSON_value_t value) {
+    //-1 for anything that is not a number
+    if(value.value_type == EDJSON_VT_INTEGER) {
+        return value.value.integer;
+    }
+
+    if(value.value_type == EDJSON_VT_DOUBLE) {
+        return value.value.floating;
+    }
+
+    return -1;
+}
+
+static int config_expand_instances(void) {
+    int total = 0;
+    bool expand = false;
+    for(int i = 0; i < config->application_count; i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        if(app->pin_instances && (app->instances == 0)) {
+            log_ni_error("config_init() pin_instances requires instances for app %s", app->name);
+            return -1;
+        }
+
+        if(app->instances == 0) {
+            total++;
+            continue;
+        }
+
+        //"auto" is one per CPU the app may run on, within nanoinit's cgroup CPU quota; evaluated again on every reload
+        if(app->instances < 0) {
+            cpu_set_t cpus;
+            app->instances = (config_allowed_cpus(app, &cpus) == 0) ? CPU_COUNT(&cpus) : 1;
+            int limit = cgroup_cpu_limit();
+            if((limit > 0) && (limit < app->instances)) {
+                app->instances = limit;
+            }
+            if(app->instances < 1) {
+                app->instances = 1;
+            }
+            log("config_init() running %d instances of %s", app->instances, app->name);
+        }
+
+        total += app->instances;
+        expand = true;
+    }
+
+    if(!expand) {
+        return 0;
+    }
+
+    nanoinit_application_config_t *expanded = (nanoinit_application_config_t *)calloc(total + 1, sizeof(nanoinit_application_config_t));
+    if(expanded == 0) {
+        log_ni_error("config_init() bad memory allocation");
+        return -1;
+    }
+
+    //apps without instances are moved over as they are; instances are deep copies of their definition
+    int count = 0;
+    int rc = 0;
+    for(int i = 0; (i < config->application_count) && (rc == 0); i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        if(app->instances == 0) {
+            expanded[count++] = *app;
+            continue;
+        }
+
+        cpu_set_t cpus;
+        if(app->pin_instances && (config_allowed_cpus(app, &cpus) != 0)) {
+            log_ni_error("config_init() could not read the CPUs to pin the instances of app %s to", app->name);
+            rc = -1;
             break;
+        }
+
+        for(int k = 0; (k < app->instances) && (rc == 0); k++) {
+            rc = config_instance_create(app, k, app->pin_instances ? &cpus : 0, &expanded[count++]);
+        }
+    }
+
+    if(rc != 0) {
+        //the original definitions are still whole; only the copies go
+        for(int i = 0; i < count; i++) {
+            if(expanded[i].instances != 0) {
+                config_app_free(&expanded[i]);
+            }
+        }
+        free(expanded);
+        return -1;
+    }
+
+    for(int i = 0; i < config->application_count; i++) {
+        if(config->applications[i].instances != 0) {
+            config_app_free(&config->applications[i]);
+        }
+    }
+    free(config->applications);
+    config->applications = expanded;
+    config->application_count = total;
+    return 0;
+}
+
+static int config_instance_create(const nanoinit_application_config_t *app, int instance, const cpu_set_t *cpus, nanoinit_application_config_t *created) {
+    //"<name>@<instance>"; %i in args, redirects, the capture file, the ready file, socket addresses and the health check becomes the instance number
+    //created is zeroed and keeps instances set, so a failed copy can be released with config_app_free()
+    created->instances = app->instances;
+    created->instance = instance;
+
+    char name[JSON_PARSE_BUFFER_SIZE];
+    snprintf(name, sizeof(name), "%s@%d", app->name, instance);
+    if((config_instance_string(name, -1, &created->name) != 0) || (config_instance_string(app->name, -1, &created->instance_of) != 0) ||
+        (config_instance_string(app->path, -1, &created->path) != 0)) {
+        log_ni_error("config_init() bad memory allocation");
+        return -1;
+    }
+
+    created->autorestart = app->autorestart;
+    created->manual = app->manual;
+    created->restart = app->restart;
+    created->restart_mode = app->restart_mode;
+    created->restart_delay_ms = app->restart_delay_ms;
+    created->restart_delay_max_ms = app->restart_delay_max_ms;
+    created->restart_jitter = app->restart_jitter;
+    created->max_restarts = app->max_restarts;
+    created->restart_window_ms = app->restart_window_ms;
+    created->stop_signal = app->stop_signal;
+    created->stop_timeout_ms = app->stop_timeout_ms;
+    created->attr = app->attr;
+    created->on_demand = app->on_demand;
+    created->idle_timeout_ms = app->idle_timeout_ms;
+    created->pin_instances = app->pin_instances;
+    created->ready = app->ready;
+    created->ready.path = 0;
+    created->health = app->health;
+    created->health.check = 0;
+    created->health.request = 0;
+    created->capture.console = app->capture.console;
+    created->capture.log = app->capture.log;
+    created->capture.raw = app->capture.raw;
+    created->log_rotate = app->log_rotate;
+
+    created->args = (char **)calloc(app->arg_count + 1, sizeof(char *));
+    created->depends_on = (char **)calloc(app->depends_on_count + 1, sizeof(char *));
+    created->sockets = (nanoinit_socket_config_t *)calloc(app->socket_count + 1, sizeof(nanoinit_socket_config_t));
+    if((created->args == 0) || (created->depends_on == 0) || (created->sockets == 0)) {
+        log_ni_error("config_init() bad memory allocation");
+        return -1;
+    }
+
+    for(int j = 0; j < app->arg_count; j++, created->arg_count++) {
+        if(config_instance_string(app->args[j], instance, &created->args[j]) != 0) {
+            log_ni_error("config_init() bad memory allocation");
+            return -1;
+        }
+    }
+
+    for(int j = 0; j < app->depends_on_count; j++, created->depends_on_count++) {
+        if(config_instance_string(app->depends_on[j], -1, &created->depends_on[j]) != 0) {
+            log_ni_error("config_init() bad memory allocation");
+            return -1;
+        }
+    }
+
+    if((config_instance_string(app->stdout_path, instance, &created->stdout_path) != 0) || (config_instance_string(app->stderr_path, instance, &created->stderr_path) != 0) ||
+        (config_instance_string(app->capture.file, instance, &created->capture.file) != 0) ||
+        (config_instance_string(app->ready.path, instance, &created->ready.path) != 0) ||
+        (config_instance_string(app->cgroup.memory_max, -1, &created->cgroup.memory_max) != 0) || (config_instance_string(app->cgroup.memory_high, -1, &created->cgroup.memory_high) != 0) ||
+        (config_instance_string(app->cgroup.cpu_max, -1, &created->cgroup.cpu_max) != 0) || (config_instance_string(app->cgroup.io_max, -1, &created->cgroup.io_max) != 0) ||
+        (config_instance_string(app->cgroup.pids_max, -1, &created->cgroup.pids_max) != 0)) {
+        log_ni_error("config_init() bad memory allocation");
+        return -1;
+    }
+
+    //a per-instance port (%i) is probed on each instance's own address
+    if(app->health.check) {
+        char *check = 0;
+        if(config_instance_string(app->health.check, instance, &check) != 0) {
+            log_ni_error("config_init() bad memory allocation");
+            return -1;
+        }
+
+        int parsed = config_parse_health(&created->health, check);
+        free(check);
+        if(parsed != 0) {
+            if(parsed == -2) {
+                log_ni_error("config_init() bad memory allocation");
+            }
+            else {
+                log_ni_error("config_init() invalid health check '%s' for instance %d of app %s", app->health.check, instance, app->name);
+            }
+            return -1;
+        }
+    }
+
+    //each instance binds its own sockets: a per-instance address (%i) or a shared one with reuseport
+    for(int j = 0; j < app->socket_count; j++, created->socket_count++) {
+        nanoinit_socket_config_t *socket = &created->sockets[j];
+        *socket = app->sockets[j];
+        socket->listen = 0;
+        socket->name = 0;
+
+        char *listen = 0;
+        if((config_instance_string(app->sockets[j].name, -1, &socket->name) != 0) || (config_instance_string(app->sockets[j].listen, instance, &listen) != 0)) {
+            free(listen);
+            log_ni_error("config_init() bad memory allocation");
+            return -1;
+        }
+
+        int parsed = (strcmp(listen, app->sockets[j].listen) != 0) ? config_parse_listen(socket, listen) : 0;
+        if(parsed == 0) {
+            free(socket->listen);
+            socket->listen = listen;
+        }
+        else {
+            free(listen);
+            if(parsed == -2) {
+                log_ni_error("config_init() bad memory allocation");
+            }
+            else {
+                log_ni_error("config_init() invalid socket '%s' for instance %d of app %s", app->sockets[j].listen, instance, app->name);
+            }
+            return -1;
+        }
+    }
+
+    if(cpus) {
+        //instance i gets the i-th allowed CPU, wrapping around when there are more instances than CPUs
+        int count = CPU_COUNT(cpus);
+        int wanted = instance % count;
+        memset(created->attr.cpus, 0, sizeof(created->attr.cpus));
+        created->attr.has_cpus = true;
+        for(int cpu = 0; cpu < SPAWN_CPUS_MAX; cpu++) {
+            if(CPU_ISSET(cpu, cpus) && (wanted-- == 0)) {
+                CPU_SET(cpu, (cpu_set_t *)created->attr.cpus);
+                break;
+            }
+        }
     }
 
     return 0;
 }
+
+static int config_instance_string(const char *value, int instance, char **result) {
+    //copies value, replacing %i with instance (unless instance is -1) and %% with %; a missing value stays missing
+    *result = 0;
+    if(value == 0) {
+        return 0;
+    }
+
+    size_t length = strlen(value) + 1;
+    if(instance >= 0) {
+        for(const char *p = strstr(value, "%i"); p; p = strstr(p + 2, "%i")) {
+            length += 16;
+        }
+    }
+
+    char *copy = (char *)malloc(length);
+    if(copy == 0) {
+        return -1;
+    }
+
+    char *out = copy;
+    for(const char *p = value; *p; p++) {
+        if((instance >= 0) && (p[0] == '%') && (p[1] == 'i')) {
+            out += sprintf(out, "%d", instance);
+            p++;
+        }
+        else if((instance >= 0) && (p[0] == '%') && (p[1] == '%')) {
+            *out++ = '%';
+            p++;
+        }
+        else {
+            *out++ = *p;
+        }
+    }
+    *out = 0;
+
+    *result = copy;
+    return 0;
+}
+
+static int config_allowed_cpus(const nanoinit_application_config_t *app, cpu_set_t *cpus) {
+    //the app's own cpus when set, otherwise the CPUs nanoinit itself may run on
+    if(app->attr.has_cpus) {
+        memcpy(cpus, app->attr.cpus, sizeof(cpu_set_t));
+        return (CPU_COUNT(cpus) > 0) ? 0 : -1;
+    }
+
+    CPU_ZERO(cpus);
+    if(sched_getaffinity(0, sizeof(cpu_set_t), cpus) != 0) {
+        return -1;
+    }
+
+    return (CPU_COUNT(cpus) > 0) ? 0 : -1;
+}
+
+static bool config_depends_on_matches(const char *name, const nanoinit_application_config_t *app) {
+    return (strcmp(name, app->name) == 0) || (app->instance_of && (strcmp(name, app->instance_of) == 0));
+}
+
+static int config_build_graph(void) {
+    //resolve depends_on names to indices; the name of an app with instances stands for all of them
+    for(int i = 0; i < config->application_count; i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        if(app->depends_on_count == 0) {
+            continue;
+        }
+
+        int matches = 0;
+        for(int j = 0; j < app->depends_on_count; j++) {
+            for(int k = 0; k < config->application_count; k++) {
+                if(config_depends_on_matches(app->depends_on[j], &config->applications[k])) {
+                    matches++;
+                }
+            }
+        }
+
+        app->dependencies = (int *)malloc(sizeof(int) * (matches + 1));
+        if(app->dependencies == 0) {
+            log_ni_error("config_build_graph() bad memory allocation");
+            return -1;
+        }
+
+        for(int j = 0; j < app->depends_on_count; j++) {
+            int found = 0;
+            for(int k = 0; k < config->application_count; k++) {
+                if(!config_depends_on_matches(app->depends_on[j], &config->applications[k])) {
+                    continue;
+                }
+
+                if(k == i) {
+                    log_ni_error("config_build_graph() app %s depends on itself", app->name);
+                    return -1;
+                }
+
+                app->dependencies[app->dependency_count++] = k;
+                config->applications[k].dependent_count++;
+                found++;
+            }
+
+            if(found == 0) {
+                log_ni_error("config_build_graph() app %s depends on unknown app %s", app->name, app->depends_on[j]);
+                return -1;
+            }
+        }
+    }
+
+    //reverse edges, so an app becoming ready finds its dependents directly
+    for(int i = 0; i < config->application_count; i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        if(app->dependent_count) {
+            app->dependents = (int *)malloc(sizeof(int) * app->dependent_count);
+            if(app->dependents == 0) {
+                log_ni_error("config_build_graph() bad memory allocation");
+                return -1;
+            }
+            app->dependent_count = 0;
+        }
+    }
+
+    for(int i = 0; i < config->application_count; i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        for(int j = 0; j < app->dependency_count; j++) {
+            nanoinit_application_config_t *dependency = &config->applications[app->dependencies[j]];
+            dependency->dependents[dependency->dependent_count++] = i;
+        }
+    }
+
+    //Kahn's algorithm; whatever can't be ordered is part of a cycle
+    int *pending = (int *)malloc(sizeof(int) * (config->application_count + 1));
+    int *queue = (int *)malloc(sizeof(int) * (config->application_count + 1));
+    if((pending == 0) || (queue == 0)) {
+        log_ni_error("config_build_graph() bad memory allocation");
+        free(pending);
+        free(queue);
+        return -1;
+    }
+
+    int queue_head = 0;
+    int queue_tail = 0;
+    for(int i = 0; i < config->application_count; i++) {
+        pending[i] = config->applications[i].dependency_count;
+        if(pending[i] == 0) {
+            queue[queue_tail++] = i;
+        }
+    }
+
+    while(queue_head < queue_tail) {
+        nanoinit_application_config_t *app = &config->applications[queue[queue_head++]];
+        for(int j = 0; j < app->dependent_count; j++) {
+            pending[app->dependents[j]]--;
+            if(pending[app->dependents[j]] == 0) {
+                queue[queue_tail++] = app->dependents[j];
+            }
+        }
+    }
+
+    int rc = 0;
+    if(queue_tail != config->application_count) {
+        for(int i = 0; i < config->application_count; i++) {
+            if(pending[i]) {
+                log_ni_error("config_build_graph() app %s is part of a dependency cycle", config->applications[i].name);
+            }
+        }
+        rc = -1;
+    }
+
+    free(pending);
+    free(queue);
+    return rc;
+}
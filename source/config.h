@@ -25,6 +25,84 @@
 #pragma once
 
 #include <stdbool.h>
+#include <sys/socket.h>
+#include "rotate.h"
+#include "spawn.h"
+
+typedef enum {
+    NI_READY_NONE = 0,          //app is ready as soon as it is spawned
+    NI_READY_NOTIFY,            //app writes to the fd given in NANOINIT_NOTIFY_FD
+    NI_READY_FILE,              //path exists
+    NI_READY_TCP,               //a TCP connect to address succeeds
+    NI_READY_EXIT,              //app exited with status 0; for one-shot setup tasks
+} nanoinit_ready_type_t;
+
+typedef struct nanoinit_ready_config_s {
+    nanoinit_ready_type_t type;
+    char *path;                         //NI_READY_FILE
+    struct sockaddr_storage address;    //NI_READY_TCP
+    socklen_t address_length;
+    int timeout_ms;                     //0 waits forever
+} nanoinit_ready_config_t;
+
+typedef enum {
+    NI_HEALTH_NONE = 0,         //no health checks
+    NI_HEALTH_TCP,              //a TCP connect to address succeeds
+    NI_HEALTH_HTTP,             //a GET of path over TCP answers with a 2xx or 3xx status
+    NI_HEALTH_UNIX,             //a connect to the unix stream socket at address succeeds
+} nanoinit_health_type_t;
+
+typedef struct nanoinit_health_config_s {
+    nanoinit_health_type_t type;
+    char *check;                        //"tcp:...", "http:..." or "unix:...", as found in config
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    char *request;                      //NI_HEALTH_HTTP: the whole GET request, built once when parsed
+    int request_length;
+    int interval_ms;                    //between the end of a probe and the start of the next one
+    int timeout_ms;                     //a probe taking longer fails
+    int threshold;                      //consecutive failed probes after which the app is restarted
+} nanoinit_health_config_t;
+
+//where the output of an app is sent when nanoinit captures it; every line becomes one "[time] [app] [stream] line" record, unless raw is set
+typedef struct nanoinit_capture_config_s {
+    bool console;                       //nanoinit's own stdout, i.e. the container output
+    bool log;                           //nanoinit's log file (-l)
+    char *file;                         //file of this app, appended to; 0 for none
+    bool raw;                           //output is passed on unchanged, moved with splice()/tee() instead of being read by nanoinit
+} nanoinit_capture_config_t;
+
+//cgroup v2 limits, as written to the app's cgroup files; 0 leaves a limit unset
+typedef struct nanoinit_cgroup_config_s {
+    char *memory_max;
+    char *memory_high;
+    char *cpu_max;
+    char *io_max;
+    char *pids_max;
+} nanoinit_cgroup_config_t;
+
+//listening socket nanoinit binds once and passes to every process the app runs as (LISTEN_FDS)
+typedef struct nanoinit_socket_config_s {
+    char *listen;                       //"tcp:[host:]port", "udp:[host:]port" or "unix:/path", as found in config
+    int type;                           //SOCK_STREAM or SOCK_DGRAM
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    int backlog;                        //stream sockets only
+    bool reuseport;
+    char *name;                         //LISTEN_FDNAMES entry; 0 is unnamed
+} nanoinit_socket_config_t;
+
+typedef enum {
+    NI_RESTART_UNSET = 0,       //follows autorestart
+    NI_RESTART_ALWAYS,
+    NI_RESTART_ON_FAILURE,      //non-zero exit status or killed by a signal
+    NI_RESTART_NEVER,
+} nanoinit_restart_policy_t;
+
+typedef enum {
+    NI_RESTART_MODE_STOP = 0,   //the running process is stopped, then the new one is spawned
+    NI_RESTART_MODE_OVERLAP,    //the new process is spawned first; the old one is stopped once the new one is ready
+} nanoinit_restart_mode_t;
 
 typedef struct nanoinit_application_config_s {
     char *name;
@@ -36,8 +114,45 @@ typedef struct nanoinit_application_config_s {
     bool autorestart;
     bool manual;
 
+    nanoinit_restart_policy_t restart;
+    nanoinit_restart_mode_t restart_mode;  //for restarts through the control socket and reloads
+    int restart_delay_ms;       //delay before the second consecutive restart; doubles on every further one
+    int restart_delay_max_ms;   //backoff cap; a process that stayed up longer than this resets the backoff
+    double restart_jitter;      //backoff delays are randomized by +/- this fraction
+    int max_restarts;           //circuit breaker: give up after this many restarts within restart_window_ms; 0 is unlimited
+    int restart_window_ms;
+
+    int stop_signal;            //sent on shutdown; 0 forwards the signal nanoinit received
+    int stop_timeout_ms;        //SIGKILL follows if the app is still running after this long; 0 waits forever
+
     char *stdout_path;
     char *stderr_path;
+    nanoinit_capture_config_t capture;  //streams without a stdout/stderr redirect are captured when any destination is set
+    rotate_policy_t log_rotate;         //for the stdout/stderr redirect files and the capture file
+
+    spawn_attr_t attr;          //placement and scheduling: cpus, numa_nodes, sched_policy, nice, ioprio
+    nanoinit_cgroup_config_t cgroup;
+
+    int socket_count;
+    nanoinit_socket_config_t *sockets;
+    bool on_demand;             //spawned on the first connection to one of its sockets instead of at startup
+    int idle_timeout_ms;        //on_demand apps are stopped after this long without a new connection; 0 keeps them running
+
+    int depends_on_count;
+    char **depends_on;          //app names, as found in config
+    int dependency_count;
+    int *dependencies;          //indices of depends_on in applications, resolved after parsing; one per instance of an app with instances
+    int dependent_count;
+    int *dependents;            //indices of the apps that depend on this one
+    nanoinit_ready_config_t ready;
+    nanoinit_health_config_t health;    //probed from the event loop once the app is ready
+
+    int instances;              //as found in config; 0 when unset, -1 for "auto"
+    bool pin_instances;         //instance i is pinned to the i-th of its allowed CPUs
+    char *instance_of;          //set on the "<name>@<i>" apps an "instances" definition expands into; 0 otherwise
+    int instance;
+
+    spawn_plan_t *spawn_plan;   //built from the fields above once the config is validated
 } nanoinit_application_config_t;
 
 typedef struct nanoinit_config_s {
@@ -45,5 +160,22 @@ typedef struct nanoinit_config_s {
     int application_count;
 } nanoinit_config_t;
 
-const nanoinit_config_t *config_init(const char *filename, const char *json_object);
-void config_free();
+//returns a newly allocated config, or 0 if the file can't be read or the config is invalid
+nanoinit_config_t *config_init(const char *filename, const char *json_object);
+void config_free(nanoinit_config_t *config);
+
+//moves app out of its config into detached, which keeps it valid after the config is freed; dependency links are dropped
+void config_app_detach(nanoinit_application_config_t *app, nanoinit_application_config_t *detached);
+void config_app_free(nanoinit_application_config_t *app);
+bool config_app_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b);
+bool config_cgroup_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b);
+bool config_sockets_equal(const nanoinit_application_config_t *a, const nanoinit_application_config_t *b);
+
+//whether nanoinit captures any output of the app
+bool config_capture_enabled(const nanoinit_capture_config_t *capture);
+
+//decimal, with an optional binary K, M, G or T suffix when suffixes is set; returns 0 or -1
+int config_parse_size(const char *string, bool suffixes, long long *number);
+
+//"SIGTERM", "TERM" or "15"; returns the signal number or -1
+int config_parse_signal(const char *name);
@@ -0,0 +1,191 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "control.h"
+#include "address.h"
+#include "log.h"
+#include "server.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CONTROL_CLIENTS_MAX         4       //requests served at once; further connections are closed right away
+#define CONTROL_TIMEOUT_MS          5000    //a client that doesn't send its request or read the reply in time is dropped
+#define CONTROL_LISTEN_BACKLOG      8
+
+static control_handler_t control_handler = 0;
+
+static bool control_peer_allowed(int fd);
+static bool control_complete(const char *request);
+static void control_run(server_client_t *client);
+
+static server_t control_server = {
+    .name = "control",
+    .clients_max = CONTROL_CLIENTS_MAX,
+    .request_max = CONTROL_REQUEST_MAX,
+    .timeout_ms = CONTROL_TIMEOUT_MS,
+    .backlog = CONTROL_LISTEN_BACKLOG,
+    .private_socket = true,
+    .accept = control_peer_allowed,
+    .complete = control_complete,
+    .respond = control_run,
+    .listen_source = { .fd = -1 },
+};
+
+int control_init(const char *path, control_handler_t handler) {
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    if(address_parse_unix(path, &address, &address_length) != 0) {
+        log_ni_error("control_init() invalid control socket path %s", path);
+        return -1;
+    }
+
+    if(server_init(&control_server, &address, address_length, path) != 0) {
+        log_ni_error("control_init() could not listen on %s", path);
+        return -1;
+    }
+
+    control_handler = handler;
+    return 0;
+}
+
+void control_free(void) {
+    server_free(&control_server);
+    control_handler = 0;
+}
+
+int control_send(const char *path, const char *command) {
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    if(address_parse_unix(path, &address, &address_length) != 0) {
+        fprintf(stderr, "nanoinit: invalid control socket path %s\n", path);
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if((fd < 0) || (connect(fd, (const struct sockaddr *)&address, address_length) != 0)) {
+        fprintf(stderr, "nanoinit: could not connect to %s: %s\n", path, strerror(errno));
+        if(fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    //one request per connection; the reply ends when nanoinit closes the connection
+    size_t length = strlen(command);
+    if((length >= CONTROL_REQUEST_MAX) || (send(fd, command, length, MSG_NOSIGNAL) != (ssize_t)length) || (send(fd, "\n", 1, MSG_NOSIGNAL) != 1)) {
+        fprintf(stderr, "nanoinit: could not send command\n");
+        close(fd);
+        return 1;
+    }
+
+    buffer_t reply = {0};
+    char chunk[4096];
+    ssize_t count;
+    while((count = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer_printf(&reply, "%.*s", (int)count, chunk);
+    }
+    close(fd);
+
+    if((count < 0) || reply.failed || (reply.length == 0)) {
+        fprintf(stderr, "nanoinit: no reply from nanoinit\n");
+        buffer_free(&reply);
+        return 1;
+    }
+
+    //"ok" is only a status; anything following it is the command's output
+    int rc = 1;
+    char *body = strchr(reply.data, '\n');
+    body = body ? body + 1 : reply.data + reply.length;
+    if(strncmp(reply.data, "ok\n", 3) == 0) {
+        fputs(body, stdout);
+        rc = 0;
+    }
+    else {
+        fprintf(stderr, "nanoinit: %s", reply.data);
+    }
+
+    buffer_free(&reply);
+    return rc;
+}
+
+static bool control_peer_allowed(int fd) {
+    //the socket file permissions are the first barrier; this one also holds when the socket is reached through a bind mount
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+
+    if((credentials.uid != 0) && (credentials.uid != geteuid())) {
+        log_ni_error("control_peer_allowed() rejected control connection from uid %d (pid=%d)", (int)credentials.uid, (int)credentials.pid);
+        return false;
+    }
+
+    return true;
+}
+
+static bool control_complete(const char *request) {
+    return strchr(request, '\n') != 0;
+}
+
+static void control_run(server_client_t *client) {
+    *strchr(client->request, '\n') = 0;
+
+    //"command [argument...]", separated by spaces
+    char *argv[CONTROL_ARGS_MAX + 1];
+    int argc = 0;
+    char *save = 0;
+    for(char *token = strtok_r(client->request, " \t\r", &save); token; token = strtok_r(0, " \t\r", &save)) {
+        if(argc == CONTROL_ARGS_MAX) {
+            argc++;
+            break;
+        }
+        argv[argc++] = token;
+    }
+    argv[(argc <= CONTROL_ARGS_MAX) ? argc : CONTROL_ARGS_MAX] = 0;
+
+    if(argc == 0) {
+        buffer_printf(&client->reply, "error empty command\n");
+    }
+    else if(argc > CONTROL_ARGS_MAX) {
+        buffer_printf(&client->reply, "error too many arguments\n");
+    }
+    else {
+        control_handler(argc, argv, &client->reply);
+    }
+
+    if(client->reply.failed) {
+        log_ni_error("control_run() could not allocate memory for reply");
+        buffer_reset(&client->reply);
+        buffer_printf(&client->reply, "error out of memory\n");
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include "buffer.h"
+
+#define CONTROL_DEFAULT_SOCKET      "/run/nanoinit.sock"
+#define CONTROL_ARGS_MAX            4           //command and its arguments
+#define CONTROL_REQUEST_MAX         512
+
+//runs one request; the first reply line is "ok" or "error <reason>", optionally followed by more lines
+typedef void (*control_handler_t)(int argc, char **argv, buffer_t *reply);
+
+//listens on the unix socket at path from the event loop; only root and nanoinit's own user may connect; returns 0 or -1
+int control_init(const char *path, control_handler_t handler);
+void control_free(void);
+
+//client side: sends command to the nanoinit listening on path and prints the reply; returns 0 on "ok", 1 otherwise
+int control_send(const char *path, const char *command);
@@ -0,0 +1,281 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "eventloop.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define EVENTLOOP_MAX_EVENTS        64      //events dispatched per epoll_wait() call; the rest are picked up on the next call
+
+static int epoll_fd = -1;
+
+//events of the epoll_wait() batch being dispatched; a source removed by a callback is dropped from the rest of the batch
+static struct epoll_event *dispatch_events = 0;
+static int dispatch_count = 0;
+static int dispatch_index = 0;
+
+static uint64_t wakeups = 0;            //epoll_wait() returns, for metrics
+
+//binary min-heap of armed timers, ordered by deadline
+static eventloop_timer_t **timer_heap = 0;
+static int timer_count = 0;
+static int timer_capacity = 0;
+
+static void eventloop_timer_swap(int a, int b);
+static void eventloop_timer_sift_up(int index);
+static void eventloop_timer_sift_down(int index);
+static int eventloop_timer_run_expired(void);
+
+int eventloop_init(void) {
+    if(epoll_fd >= 0) {
+        return 0;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd < 0) {
+        log_ni_error("eventloop_init() epoll_create1() failed with errno %d", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+void eventloop_free(void) {
+    if(epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+
+    for(int i = 0; i < timer_count; i++) {
+        timer_heap[i]->heap_index = -1;
+    }
+
+    free(timer_heap);
+    timer_heap = 0;
+    timer_count = 0;
+    timer_capacity = 0;
+}
+
+int eventloop_add(eventloop_source_t *source, uint32_t events) {
+    struct epoll_event ev = {0};
+    ev.events = events;
+    ev.data.ptr = source;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source->fd, &ev) != 0) {
+        log_ni_error("eventloop_add() epoll_ctl() failed for fd %d with errno %d", source->fd, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+int eventloop_modify(eventloop_source_t *source, uint32_t events) {
+    struct epoll_event ev = {0};
+    ev.events = events;
+    ev.data.ptr = source;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, source->fd, &ev) != 0) {
+        log_ni_error("eventloop_modify() epoll_ctl() failed for fd %d with errno %d", source->fd, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+int eventloop_remove(eventloop_source_t *source) {
+    //the source may be freed as soon as this returns
+    for(int i = dispatch_index + 1; i < dispatch_count; i++) {
+        if(dispatch_events[i].data.ptr == source) {
+            dispatch_events[i].data.ptr = 0;
+        }
+    }
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, 0) != 0) {
+        log_ni_error("eventloop_remove() epoll_ctl() failed for fd %d with errno %d", source->fd, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+void eventloop_timer_init(eventloop_timer_t *timer, eventloop_timer_cb_t callback, void *data) {
+    timer->deadline = 0;
+    timer->heap_index = -1;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+int eventloop_timer_start(eventloop_timer_t *timer, uint64_t delay_ms) {
+    eventloop_timer_stop(timer);
+
+    if(timer_count == timer_capacity) {
+        int capacity = timer_capacity ? timer_capacity * 2 : 16;
+        eventloop_timer_t **heap = (eventloop_timer_t **)realloc(timer_heap, sizeof(eventloop_timer_t *) * capacity);
+        if(heap == 0) {
+            log_ni_error("eventloop_timer_start() could not allocate memory for timer heap");
+            return -1;
+        }
+
+        timer_heap = heap;
+        timer_capacity = capacity;
+    }
+
+    timer->deadline = eventloop_now() + delay_ms;
+    timer->heap_index = timer_count;
+    timer_heap[timer_count] = timer;
+    timer_count++;
+    eventloop_timer_sift_up(timer->heap_index);
+
+    return 0;
+}
+
+void eventloop_timer_stop(eventloop_timer_t *timer) {
+    int index = timer->heap_index;
+    if(index < 0) {
+        return;
+    }
+
+    timer_count--;
+    if(index != timer_count) {
+        eventloop_timer_swap(index, timer_count);
+        eventloop_timer_sift_up(index);
+        eventloop_timer_sift_down(index);
+    }
+
+    timer->heap_index = -1;
+}
+
+bool eventloop_timer_armed(const eventloop_timer_t *timer) {
+    return timer->heap_index >= 0;
+}
+
+uint64_t eventloop_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+uint64_t eventloop_wakeups(void) {
+    return wakeups;
+}
+
+int eventloop_run_once(int timeout_ms) {
+    struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+
+    //sleep no longer than until the nearest timer deadline
+    if(timer_count) {
+        uint64_t now = eventloop_now();
+        uint64_t deadline = timer_heap[0]->deadline;
+        int timer_timeout = (deadline > now) ? (int)(deadline - now) : 0;
+        if((timeout_ms < 0) || (timer_timeout < timeout_ms)) {
+            timeout_ms = timer_timeout;
+        }
+    }
+
+    int count = epoll_wait(epoll_fd, events, EVENTLOOP_MAX_EVENTS, timeout_ms);
+    wakeups++;
+    if(count < 0) {
+        if(errno == EINTR) {
+            return 0;
+        }
+
+        log_ni_error("eventloop_run_once() epoll_wait() failed with errno %d", errno);
+        return -1;
+    }
+
+    dispatch_events = events;
+    dispatch_count = count;
+    for(dispatch_index = 0; dispatch_index < count; dispatch_index++) {
+        eventloop_source_t *source = (eventloop_source_t *)events[dispatch_index].data.ptr;
+        if(source) {
+            source->callback(source, events[dispatch_index].events);
+        }
+    }
+    dispatch_events = 0;
+    dispatch_count = 0;
+    dispatch_index = 0;
+
+    return count + eventloop_timer_run_expired();
+}
+
+static int eventloop_timer_run_expired(void) {
+    int expired = 0;
+    uint64_t now = eventloop_now();
+    while(timer_count && (timer_heap[0]->deadline <= now)) {
+        eventloop_timer_t *timer = timer_heap[0];
+        eventloop_timer_stop(timer);
+        timer->callback(timer);
+        expired++;
+    }
+
+    return expired;
+}
+
+static void eventloop_timer_swap(int a, int b) {
+    eventloop_timer_t *t = timer_heap[a];
+    timer_heap[a] = timer_heap[b];
+    timer_heap[b] = t;
+    timer_heap[a]->heap_index = a;
+    timer_heap[b]->heap_index = b;
+}
+
+static void eventloop_timer_sift_up(int index) {
+    while(index > 0) {
+        int parent = (index - 1) / 2;
+        if(timer_heap[parent]->deadline <= timer_heap[index]->deadline) {
+            break;
+        }
+
+        eventloop_timer_swap(parent, index);
+        index = parent;
+    }
+}
+
+static void eventloop_timer_sift_down(int index) {
+    while(1) {
+        int smallest = index;
+        int left = index * 2 + 1;
+        int right = left + 1;
+
+        if((left < timer_count) && (timer_heap[left]->deadline < timer_heap[smallest]->deadline)) {
+            smallest = left;
+        }
+
+        if((right < timer_count) && (timer_heap[right]->deadline < timer_heap[smallest]->deadline)) {
+            smallest = right;
+        }
+
+        if(smallest == index) {
+            break;
+        }
+
+        eventloop_timer_swap(smallest, index);
+        index = smallest;
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct eventloop_source_s eventloop_source_t;
+
+//called from eventloop_run_once() with the epoll events received for source
+typedef void (*eventloop_cb_t)(eventloop_source_t *source, uint32_t events);
+
+struct eventloop_source_s {
+    int fd;
+    eventloop_cb_t callback;
+    void *data;
+};
+
+typedef struct eventloop_timer_s eventloop_timer_t;
+
+//called from eventloop_run_once() once the timer deadline has passed; the timer is already disarmed and may be restarted
+typedef void (*eventloop_timer_cb_t)(eventloop_timer_t *timer);
+
+struct eventloop_timer_s {
+    uint64_t deadline;          //CLOCK_MONOTONIC, in ms
+    int heap_index;             //-1 when not armed
+    eventloop_timer_cb_t callback;
+    void *data;
+};
+
+int eventloop_init(void);
+void eventloop_free(void);
+
+int eventloop_add(eventloop_source_t *source, uint32_t events);
+int eventloop_modify(eventloop_source_t *source, uint32_t events);
+int eventloop_remove(eventloop_source_t *source);
+
+void eventloop_timer_init(eventloop_timer_t *timer, eventloop_timer_cb_t callback, void *data);
+int eventloop_timer_start(eventloop_timer_t *timer, uint64_t delay_ms);
+void eventloop_timer_stop(eventloop_timer_t *timer);
+bool eventloop_timer_armed(const eventloop_timer_t *timer);
+
+uint64_t eventloop_now(void);   //CLOCK_MONOTONIC, in ms
+uint64_t eventloop_wakeups(void);   //number of times the loop woke up so far
+
+//blocks until at least one event is dispatched, a timer expires or timeout_ms expires (-1 blocks forever); returns the number of dispatched events and timers or -1
+int eventloop_run_once(int timeout_ms);
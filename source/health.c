@@ -0,0 +1,203 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "health.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define HEALTH_STATUS_LINE_LENGTH   12      //"HTTP/1.1 200"
+
+static void health_probe_cb(eventloop_source_t *source, uint32_t events);
+static void health_interval_cb(eventloop_timer_t *timer);
+static void health_timeout_cb(eventloop_timer_t *timer);
+static int health_http(health_check_t *check);
+static void health_done(health_check_t *check, bool healthy);
+static void health_close_probe(health_check_t *check);
+
+void health_init(health_check_t *check, const nanoinit_health_config_t *config, health_cb_t callback, void *data) {
+    check->config = config;
+    check->callback = callback;
+    check->data = data;
+
+    check->failures = 0;
+    check->connected = false;
+    check->probe_source.fd = -1;
+    check->probe_source.callback = health_probe_cb;
+    check->probe_source.data = check;
+
+    eventloop_timer_init(&check->interval_timer, health_interval_cb, check);
+    eventloop_timer_init(&check->timeout_timer, health_timeout_cb, check);
+}
+
+void health_start(health_check_t *check) {
+    health_cancel(check);
+    check->failures = 0;
+    if(check->config->type != NI_HEALTH_NONE) {
+        eventloop_timer_start(&check->interval_timer, check->config->interval_ms);
+    }
+}
+
+void health_cancel(health_check_t *check) {
+    health_close_probe(check);
+    eventloop_timer_stop(&check->interval_timer);
+    eventloop_timer_stop(&check->timeout_timer);
+}
+
+static void health_interval_cb(eventloop_timer_t *timer) {
+    health_check_t *check = (health_check_t *)timer->data;
+
+    //one non-blocking connection per probe; the rest happens in health_probe_cb() as the socket becomes ready
+    int fd = socket(check->config->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        log_ni_error("health_interval_cb() socket() failed with errno %d", errno);
+        health_done(check, false);
+        return;
+    }
+
+    //a unix socket with a full backlog answers EAGAIN, which counts as a failure like a refused connection
+    if((connect(fd, (const struct sockaddr *)&check->config->address, check->config->address_length) != 0) && (errno != EINPROGRESS)) {
+        close(fd);
+        health_done(check, false);
+        return;
+    }
+
+    check->connected = false;
+    check->sent = 0;
+    check->received = 0;
+    check->probe_source.fd = fd;
+    if(eventloop_add(&check->probe_source, EPOLLOUT) != 0) {
+        close(fd);
+        check->probe_source.fd = -1;
+        health_done(check, false);
+        return;
+    }
+
+    eventloop_timer_start(&check->timeout_timer, check->config->timeout_ms);
+}
+
+static void health_probe_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    health_check_t *check = (health_check_t *)source->data;
+    if(!check->connected) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if((getsockopt(source->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0) || (error != 0)) {
+            health_done(check, false);
+            return;
+        }
+
+        if(check->config->type != NI_HEALTH_HTTP) {
+            health_done(check, true);
+            return;
+        }
+        check->connected = true;
+    }
+
+    int rc = health_http(check);
+    if(rc != 0) {
+        health_done(check, rc > 0);
+    }
+}
+
+static int health_http(health_check_t *check) {
+    //returns 1 for a 2xx or 3xx status, -1 for anything else, 0 while the exchange is still going on
+    int fd = check->probe_source.fd;
+    size_t request_length = (size_t)check->config->request_length;
+    if(check->sent < request_length) {
+        while(check->sent < request_length) {
+            ssize_t w = send(fd, check->config->request + check->sent, request_length - check->sent, MSG_NOSIGNAL);
+            if(w < 0) {
+                return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+            }
+            check->sent += (size_t)w;
+        }
+
+        if(eventloop_modify(&check->probe_source, EPOLLIN) != 0) {
+            return -1;
+        }
+        return 0;
+    }
+
+    //only the status line is looked at; the rest of the response is dropped with the connection
+    while(check->received < HEALTH_STATUS_LINE_LENGTH) {
+        ssize_t r = recv(fd, check->status_line + check->received, HEALTH_STATUS_LINE_LENGTH - check->received, 0);
+        if(r == 0) {
+            return -1;
+        }
+        if(r < 0) {
+            return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+        }
+        check->received += (size_t)r;
+    }
+
+    const char *line = check->status_line;
+    if((strncmp(line, "HTTP/1.", 7) != 0) || (line[8] != ' ') || ((line[9] != '2') && (line[9] != '3'))) {
+        return -1;
+    }
+    return 1;
+}
+
+static void health_timeout_cb(eventloop_timer_t *timer) {
+    health_check_t *check = (health_check_t *)timer->data;
+    health_done(check, false);
+}
+
+static void health_done(health_check_t *check, bool healthy) {
+    health_close_probe(check);
+    eventloop_timer_stop(&check->timeout_timer);
+
+    if(healthy) {
+        int failures = check->failures;
+        check->failures = 0;
+        if(failures > 0) {
+            check->callback(check, true);
+        }
+    }
+    else {
+        check->failures++;
+        if(check->failures >= check->config->threshold) {
+            check->callback(check, false);
+            return;
+        }
+        check->callback(check, false);
+    }
+
+    eventloop_timer_start(&check->interval_timer, check->config->interval_ms);
+}
+
+static void health_close_probe(health_check_t *check) {
+    if(check->probe_source.fd >= 0) {
+        eventloop_remove(&check->probe_source);
+        close(check->probe_source.fd);
+        check->probe_source.fd = -1;
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+#include "eventloop.h"
+
+typedef struct health_check_s health_check_t;
+
+//called after every failed probe and after the first passing one that follows; once failures reaches the threshold, probing stops until health_start()
+typedef void (*health_cb_t)(health_check_t *check, bool healthy);
+
+struct health_check_s {
+    const nanoinit_health_config_t *config;
+    health_cb_t callback;
+    void *data;
+
+    int failures;                       //consecutive failed probes
+    bool connected;                     //the probe connection is established
+    size_t sent;                        //NI_HEALTH_HTTP: bytes of the request written so far
+    size_t received;                    //NI_HEALTH_HTTP: bytes of the status line read so far
+    char status_line[16];               //"HTTP/1.x NNN", the part of the response that is checked
+    eventloop_source_t probe_source;    //in-flight probe connection
+    eventloop_timer_t interval_timer;
+    eventloop_timer_t timeout_timer;
+};
+
+void health_init(health_check_t *check, const nanoinit_health_config_t *config, health_cb_t callback, void *data);
+
+//starts probing every health interval; the first probe runs one interval from now; does nothing without a health check
+void health_start(health_check_t *check);
+
+//stops probing and closes the probe connection; safe to call at any time
+void health_cancel(health_check_t *check);
@@ -22,20 +22,63 @@
  * SOFTWARE.
  * */
 
-#define _GNU_SOURCE         //for asprintf
+#define _GNU_SOURCE
 
 #include "log.h"
+#include "writer.h"
+#include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+
+#define LOG_BUFFER_SIZE     16384   //pending records, formatted once and shared by every sink
+#define LOG_RECORDS_MAX     64
+#define LOG_LINE_MAX        2048    //nanoinit's own lines, newline included, are cut to this length
+
+#define LOG_WRITER_EXIT_MS  2000    //how long log_free() waits for the writer to drain the ring; a stalled volume doesn't hold up the exit
+
+#define LOG_SINK_FILE       0x01
+#define LOG_SINK_STDOUT     0x02
+#define LOG_SINK_STDERR     0x04
+
+typedef struct log_pending_s {
+    uint32_t offset;                //into log_buffer
+    uint32_t length;
+    int sinks;                      //LOG_SINK_*
+} log_pending_t;
 
 static int instances = 0;
 static int app_verbosity_level = 0;
-static FILE *log_file = 0;
+static rotate_policy_t log_policy = {0};
+static rotate_file_t log_file = { .fd = -1 };
+static bool log_to_file = false;
+
+//with an async writer the log file is written by the writer thread, and log_file only keeps its path
+static writer_file_t *log_writer_file = 0;
+
+static log_flush_t log_flush_policy = LOG_FLUSH_IMMEDIATE;
+static int log_flush_interval_ms = 0;
+static char log_buffer[LOG_BUFFER_SIZE];
+static size_t log_used = 0;
+static log_pending_t log_pending[LOG_RECORDS_MAX];
+static int log_pending_count = 0;
+static uint64_t log_pending_since = 0;  //CLOCK_MONOTONIC ms of the oldest pending record
+static bool log_flushing = false;
 
-int log_init(int verbosity_level, const char *log_path) {
+static char *log_reserve(size_t length);
+static void log_commit(size_t length, int sinks);
+static size_t log_flush_sink(int sink, int fd);
+static void log_written(size_t length);
+static void log_queue(void);
+static uint64_t log_now(void);
+
+int log_init(int verbosity_level, const char *log_path, const rotate_policy_t *rotate, log_flush_t flush, int flush_interval_ms, const log_async_t *async) {
     instances++;
     if(instances > 1) {
         log_ni_error("log_init() called too many times");
@@ -48,29 +91,148 @@ int log_init(int verbosity_level, const char *log_path) {
     }
 
     app_verbosity_level = verbosity_level;
+    log_flush_policy = flush;
+    log_flush_interval_ms = flush_interval_ms;
+
+    //the writer thread takes app files as well, so it runs with or without a log file
+    if(async && async->enabled && (writer_start(async->ring_size, async->overflow) != 0)) {
+        log_ni_error("log_init() could not start the writer thread; writing files from the supervisor");
+    }
+
     if(log_path) {
-        log_file = fopen(log_path, "w");
-        if(log_file == 0) {
+        if(rotate) {
+            log_policy = *rotate;
+        }
+        rotate_init(&log_file, &log_policy);
+
+        //appended to, so the log of the previous run survives a container restart; close-on-exec, so apps never inherit it
+        if((rotate_set_path(&log_file, log_path, true) != 0) || (rotate_fd(&log_file) < 0)) {
+            rotate_set_path(&log_file, 0, true);
             log_ni_error("log_init() could not open logfile '%s' for writing; logging to file is disabled", log_path);
             return -3;
         }
+        log_to_file = true;
+
+        //opened here all the same, so a log file that can't be written is reported right away
+        log_writer_file = writer_file_open(log_path, true, &log_policy);
+        if(log_writer_file) {
+            rotate_close(&log_file);
+        }
     }
 
     return 0;
 }
 
 void log_free(void) {
-    if(log_file) {
-        fclose(log_file);
-        log_file = 0;
-    }
+    log_flush();
+    writer_file_close(log_writer_file);
+    log_writer_file = 0;
+    writer_stop(LOG_WRITER_EXIT_MS);
+    rotate_set_path(&log_file, 0, true);
+    log_to_file = false;
 
     instances--;
     app_verbosity_level = 0;
+    log_flush_policy = LOG_FLUSH_IMMEDIATE;
+}
+
+void log_flush(void) {
+    //records logged while flushing, such as a failed rotation, are picked up by the next round
+    if(log_flushing) {
+        return;
+    }
+
+    log_flushing = true;
+    while(log_pending_count > 0) {
+        size_t written = 0;
+        if(log_writer_file) {
+            log_queue();
+        }
+        else if(log_to_file) {
+            written = log_flush_sink(LOG_SINK_FILE, log_file.fd);
+        }
+        log_flush_sink(LOG_SINK_STDERR, STDERR_FILENO);
+        log_flush_sink(LOG_SINK_STDOUT, STDOUT_FILENO);
+        log_pending_count = 0;
+        log_used = 0;
+
+        if(written > 0) {
+            log_written(written);
+        }
+    }
+    log_flushing = false;
+}
+
+int log_tick(void) {
+    //the writer thread can't log, so its rotation errors are reported from here
+    if(log_writer_file && (writer_file_errors(log_writer_file) & WRITER_ERROR_ROTATE)) {
+        log_ni_error("log_tick() could not rotate logfile '%s'; continuing in the old one", log_file.path);
+    }
+
+    if(log_pending_count == 0) {
+        return -1;
+    }
+
+    if(log_flush_policy == LOG_FLUSH_TIMED) {
+        uint64_t age = log_now() - log_pending_since;
+        if(age < (uint64_t)log_flush_interval_ms) {
+            return (int)((uint64_t)log_flush_interval_ms - age);
+        }
+    }
+
+    log_flush();
+    return -1;
+}
+
+void log_record(const char *record, size_t length) {
+    if(!log_to_file) {
+        return;
+    }
+
+    char *pending = log_reserve(length);
+    if(pending == 0) {
+        //too long to be buffered; written on its own, after what is already pending
+        log_flush();
+        if(log_writer_file) {
+            writer_write(log_writer_file, record, length);
+            return;
+        }
+
+        size_t left = length;
+        while(left > 0) {
+            ssize_t w = write(log_file.fd, record, left);
+            if(w < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            record += w;
+            left -= (size_t)w;
+        }
+        log_written(length - left);
+        return;
+    }
+
+    memcpy(pending, record, length);
+    log_commit(length, LOG_SINK_FILE);
+}
+
+rotate_file_t *log_file_get(void) {
+    if(!log_to_file || log_writer_file) {
+        return 0;
+    }
+
+    log_flush();
+    return &log_file;
+}
+
+bool log_file_enabled(void) {
+    return log_to_file;
 }
 
 void _log_add(int verbosity_level, const char *format, ...) {
-    if((verbosity_level < 0) || (verbosity_level > 2)) {
+    if((verbosity_level < 0) || (verbosity_level > LOG_INFO)) {
         log_ni_error("_log_add() invalid verbosity level: %d; assuming NI-ERROR", verbosity_level);
         verbosity_level = 0;
     }
@@ -80,7 +242,18 @@ void _log_add(int verbosity_level, const char *format, ...) {
         return;
     }
 
-    
+    //nothing is formatted for a record no sink takes
+    int sinks = log_to_file ? LOG_SINK_FILE : 0;
+    if(verbosity_level == LOG_INFO) {
+        sinks |= LOG_SINK_STDOUT;
+    }
+    else if(verbosity_level <= app_verbosity_level) {
+        sinks |= (verbosity_level > 1) ? LOG_SINK_STDOUT : LOG_SINK_STDERR;
+    }
+    if(sinks == 0) {
+        return;
+    }
+
     struct timeval tv;
     int result = gettimeofday(&tv, 0);
     if(result != 0) {
@@ -95,46 +268,129 @@ void _log_add(int verbosity_level, const char *format, ...) {
 
     unsigned long long ts_sec = (unsigned long long)(tv.tv_sec);
     unsigned int ts_msec = (unsigned int)(tv.tv_usec) / 1000;
-    
-    char *format_with_timestamp = 0;
-    result = asprintf(&format_with_timestamp, "[%llu.%03u] [nanoinit] %s\n", ts_sec, ts_msec, format);
-    (void)result;
-    
-    if(format_with_timestamp == 0) {
-        //asprintf failed, fallback
-        format_with_timestamp = (char *)format;
-        if(verbosity_level != 0) {  //prevent recursion
-            log_ni_error("_log_add() asprintf() failed to generate string");
-        }
+
+    //formatted once, straight into the buffer
+    char *record = log_reserve(LOG_LINE_MAX);
+    if(record == 0) {
+        return;     //only while flushing, i.e. an error about the log file itself
     }
 
-    
+    int length = snprintf(record, LOG_LINE_MAX, "[%llu.%03u] [nanoinit] ", ts_sec, ts_msec);
     va_list arg;
+    va_start(arg, format);
+    int message = vsnprintf(record + length, LOG_LINE_MAX - length, format, arg);
+    va_end(arg);
+    if(message > 0) {
+        length += message;
+    }
+    if(length > LOG_LINE_MAX - 1) {
+        length = LOG_LINE_MAX - 1;
+    }
+    record[length++] = '\n';
+
+    log_commit((size_t)length, sinks);
+}
+
+static char *log_reserve(size_t length) {
+    //returns room for a record of up to length bytes at the end of the buffer, or 0 if it never fits
+    if(length > LOG_BUFFER_SIZE) {
+        return 0;
+    }
+
+    if((log_used + length > LOG_BUFFER_SIZE) || (log_pending_count == LOG_RECORDS_MAX)) {
+        log_flush();
+        if(log_pending_count > 0) {
+            return 0;
+        }
+    }
 
-    //log to file
-    if(log_file) {
-        va_start(arg, format);
-        vfprintf(log_file, format_with_timestamp, arg);
-        fflush(log_file);
-        va_end(arg);
+    return log_buffer + log_used;
+}
+
+static void log_commit(size_t length, int sinks) {
+    if(log_pending_count == 0) {
+        log_pending_since = log_now();
+    }
+
+    log_pending[log_pending_count].offset = (uint32_t)log_used;
+    log_pending[log_pending_count].length = (uint32_t)length;
+    log_pending[log_pending_count].sinks = sinks;
+    log_pending_count++;
+    log_used += length;
+
+    if(log_flush_policy == LOG_FLUSH_IMMEDIATE) {
+        log_flush();
+    }
+}
+
+static size_t log_flush_sink(int sink, int fd) {
+    //one writev() gathers every pending record of the sink; neighbouring records share one iovec
+    if(fd < 0) {
+        return 0;
     }
 
-    //print
-    if(verbosity_level <= app_verbosity_level) {
-        FILE *output = stderr;
-        if(verbosity_level > 1) {
-            output = stdout;
+    struct iovec iov[LOG_RECORDS_MAX];
+    int count = 0;
+    for(int i = 0; i < log_pending_count; i++) {
+        if((log_pending[i].sinks & sink) == 0) {
+            continue;
         }
 
-        va_start(arg, format);
-        vfprintf(output, format_with_timestamp, arg);
-        va_end(arg);
-        if(format_with_timestamp == format) {
-            fprintf(output, "\n"); //newline is missing
+        char *start = log_buffer + log_pending[i].offset;
+        if((count > 0) && ((char *)iov[count - 1].iov_base + iov[count - 1].iov_len == start)) {
+            iov[count - 1].iov_len += log_pending[i].length;
+        }
+        else {
+            iov[count].iov_base = start;
+            iov[count].iov_len = log_pending[i].length;
+            count++;
         }
     }
 
-    if(format_with_timestamp != format) {
-        free(format_with_timestamp);
+    size_t written = 0;
+    struct iovec *next = iov;
+    while(count > 0) {
+        ssize_t w = writev(fd, next, count);
+        if(w < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;      //a full disk loses records rather than stalling supervision
+        }
+
+        written += (size_t)w;
+        while((count > 0) && ((size_t)w >= next->iov_len)) {
+            w -= (ssize_t)next->iov_len;
+            next++;
+            count--;
+        }
+        if(count > 0) {
+            next->iov_base = (char *)next->iov_base + w;
+            next->iov_len -= (size_t)w;
+        }
+    }
+
+    return written;
+}
+
+static void log_written(size_t length) {
+    //a failed rotation restarts the count, so the error logged here doesn't trigger another one
+    if(rotate_written(&log_file, length) != 0) {
+        log_ni_error("log_written() could not rotate logfile '%s'; continuing in the old one", log_file.path);
+    }
+}
+
+static uint64_t log_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void log_queue(void) {
+    //each record is queued on its own, so overflow drops whole records
+    for(int i = 0; i < log_pending_count; i++) {
+        if(log_pending[i].sinks & LOG_SINK_FILE) {
+            writer_write(log_writer_file, log_buffer + log_pending[i].offset, log_pending[i].length);
+        }
     }
 }
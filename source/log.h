@@ -24,15 +24,55 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "ring.h"
+#include "rotate.h"
 
 #define LOG_NI_ERROR    0
 #define LOG_APP_ERROR   1
 #define LOG_LOG         2
+#define LOG_INFO        3   //output that was asked for, e.g. a report; shown on stdout whatever the verbosity level
 
-int log_init(int verbosity_level, const char *log_path);
+//when records formatted into the log buffer are written out; a full buffer is written out right away whatever the policy
+typedef enum {
+    LOG_FLUSH_IMMEDIATE = 0,    //every record as soon as it is logged
+    LOG_FLUSH_LOOP,             //once per event loop iteration, so a burst of records costs one write per sink
+    LOG_FLUSH_TIMED,            //once the oldest pending record is flush_interval_ms old
+} log_flush_t;
+
+//hands the log file and app files to the writer thread (see writer.h), so a slow or stalled volume never blocks the
+//supervisor; records are queued in a bounded ring and overflow drops them or blocks as configured
+typedef struct log_async_s {
+    bool enabled;
+    ring_overflow_t overflow;
+    size_t ring_size;
+} log_async_t;
+
+#define LOG_ASYNC_RING_SIZE         1048576
+
+//the log file is appended to and rotated according to rotate, which may be 0; async may be 0 for synchronous writes
+int log_init(int verbosity_level, const char *log_path, const rotate_policy_t *rotate, log_flush_t flush, int flush_interval_ms, const log_async_t *async);
 void log_free(void);
 
+//writes out all pending records
+void log_flush(void);
+
+//called at the end of every event loop iteration; flushes what the policy says is due and returns the ms until the
+//remaining records are, or -1 when nothing is pending
+int log_tick(void);
+
+//appends an already formatted record, such as a captured app line, to the log file; does nothing without one
+void log_record(const char *record, size_t length);
+
+//the log file, for writers that bypass the logger and account their writes themselves; pending records are written out
+//first, so the file stays in order; 0 without a log file, and while the writer thread owns it
+rotate_file_t *log_file_get(void);
+
+//whether log_record() takes records for the log file
+bool log_file_enabled(void);
+
 //don't use directly; use macros defined below
 void _log_add(int verbose_level, const char *format, ...);
 
@@ -41,4 +81,5 @@ void _log_add(int verbose_level, const char *format, ...);
 #define log_ni_error(format, args...)   _log_add(LOG_NI_ERROR, format, ## args);
 #define log_app_error(format, args...)  _log_add(LOG_APP_ERROR, format, ## args);
 #define log(format, args...)            _log_add(LOG_LOG, format, ## args);
+#define log_info(format, args...)       _log_add(LOG_INFO, format, ## args);
 #pragma GCC diagnostic pop
@@ -26,20 +26,20 @@
 #include "arguments.h"
 #include "config.h"
 #include "log.h"
-#include "nanoinit.h"
+#include "control.h"
 #include "supervisor.h"
 
 #include <stdlib.h>
 
 int main(int argc, char **argv) {
     const nanoinit_arguments_t *arguments;
-    const nanoinit_config_t *config;
+    nanoinit_config_t *config;
     
     //load and parse arguments; if any argument is not present, a default value is assumed
     arguments = arguments_init(argc, argv);
 
     //initialize logger based on verbosity_level and log_path returned by arguments
-    int rc = log_init(arguments->verbosity_level, arguments->log_path);
+    int rc = log_init(arguments->verbosity_level, arguments->log_path, &arguments->log_rotate, arguments->log_flush, arguments->log_flush_interval_ms, &arguments->log_async);
     if(rc != 0) {
         log_ni_error("log_init() failed");
     }
@@ -47,7 +47,11 @@ int main(int argc, char **argv) {
     if(arguments->special_mode != NI_NO_SPECIAL_MODE) {
         switch(arguments->special_mode) {
             case NI_COMMAND_RELOAD:
-                nanoinit_send_reload();
+                rc = control_send(arguments->control_socket, "reload");
+                break;
+
+            case NI_COMMAND_CONTROL:
+                rc = control_send(arguments->control_socket, arguments->control_command);
                 break;
 
             default:
@@ -64,12 +68,11 @@ int main(int argc, char **argv) {
         log_ni_error("config_init() failed; using zero-config");
     }
 
-    //start supervisor; this function returns only on nanoinit exit; on fork-exec the freeing is taken care of there
+    //start supervisor; this function returns only on nanoinit exit; it owns the config from now on, as a reload replaces it
     rc = supervisor_start(arguments, config);
 
 main_exit:
     //free resources
-    config_free();
     arguments_free();
     log_free();
 
@@ -0,0 +1,184 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "metrics.h"
+#include "address.h"
+#include "eventloop.h"
+#include "log.h"
+#include "server.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define METRICS_CLIENTS_MAX         8       //scrapes served at once; further connections are closed right away
+#define METRICS_REQUEST_MAX         2048    //request line and headers; the body of a GET is ignored
+#define METRICS_TIMEOUT_MS          5000    //a client that doesn't send its request or read the response in time is dropped
+#define METRICS_LISTEN_BACKLOG      16
+
+static const double metrics_buckets[METRICS_HISTOGRAM_BUCKETS] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1 };
+
+static metrics_render_cb_t metrics_render = 0;
+static uint64_t scrapes = 0;
+
+static bool metrics_complete(const char *request);
+static void metrics_respond(server_client_t *client);
+static void metrics_render_self(buffer_t *buffer);
+
+static server_t metrics_server = {
+    .name = "metrics",
+    .clients_max = METRICS_CLIENTS_MAX,
+    .request_max = METRICS_REQUEST_MAX,
+    .timeout_ms = METRICS_TIMEOUT_MS,
+    .backlog = METRICS_LISTEN_BACKLOG,
+    .complete = metrics_complete,
+    .respond = metrics_respond,
+    .listen_source = { .fd = -1 },
+};
+
+int metrics_init(const char *spec, metrics_render_cb_t render) {
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    bool is_unix = (strncmp(spec, "unix:", 5) == 0);
+    if(is_unix) {
+        if(address_parse_unix(spec + 5, &address, &address_length) != 0) {
+            log_ni_error("metrics_init() invalid unix socket path %s", spec + 5);
+            return -1;
+        }
+    }
+    else if((strncmp(spec, "tcp:", 4) != 0) || (address_parse_inet(spec + 4, "127.0.0.1", &address, &address_length) != 0)) {
+        log_ni_error("metrics_init() invalid address %s; expected unix:/path, tcp:port or tcp:host:port", spec);
+        return -1;
+    }
+
+    if(server_init(&metrics_server, &address, address_length, is_unix ? spec + 5 : 0) != 0) {
+        log_ni_error("metrics_init() could not listen on %s", spec);
+        return -1;
+    }
+
+    metrics_render = render;
+    log("metrics_init() serving metrics on %s", spec);
+    return 0;
+}
+
+void metrics_free(void) {
+    server_free(&metrics_server);
+    metrics_render = 0;
+}
+
+void metrics_header(buffer_t *buffer, const char *name, const char *type, const char *help) {
+    buffer_printf(buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+const char *metrics_escape(const char *value, char *buffer, size_t size) {
+    size_t length = 0;
+    for(; *value && (length + 2 < size); value++) {
+        if((*value == '\\') || (*value == '"')) {
+            buffer[length++] = '\\';
+            buffer[length++] = *value;
+        }
+        else if(*value == '\n') {
+            buffer[length++] = '\\';
+            buffer[length++] = 'n';
+        }
+        else {
+            buffer[length++] = *value;
+        }
+    }
+    buffer[length] = 0;
+
+    return buffer;
+}
+
+void metrics_histogram_observe(metrics_histogram_t *histogram, double value) {
+    int bucket = 0;
+    while((bucket < METRICS_HISTOGRAM_BUCKETS) && (value > metrics_buckets[bucket])) {
+        bucket++;
+    }
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum += value;
+}
+
+void metrics_histogram_render(buffer_t *buffer, const char *name, const char *labels, const metrics_histogram_t *histogram) {
+    uint64_t cumulative = 0;
+    for(int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        cumulative += histogram->buckets[i];
+        buffer_printf(buffer, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels, metrics_buckets[i], (unsigned long long)cumulative);
+    }
+    buffer_printf(buffer, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels, (unsigned long long)histogram->count);
+    buffer_printf(buffer, "%s_sum{%s} %.6f\n", name, labels, histogram->sum);
+    buffer_printf(buffer, "%s_count{%s} %llu\n", name, labels, (unsigned long long)histogram->count);
+}
+
+static bool metrics_complete(const char *request) {
+    //the request only needs to be complete, it is not parsed beyond the request line
+    return strstr(request, "\r\n\r\n") || strstr(request, "\n\n");
+}
+
+static void metrics_respond(server_client_t *client) {
+    const char *status = "200 OK";
+    buffer_t *body = &client->reply;
+
+    if((strncmp(client->request, "GET /metrics ", 13) == 0) || (strncmp(client->request, "GET / ", 6) == 0)) {
+        scrapes++;
+        metrics_render_self(body);
+        metrics_render(body);
+    }
+    else {
+        status = "404 Not Found";
+        buffer_printf(body, "not found\n");
+    }
+
+    if(body->failed) {
+        log_ni_error("metrics_respond() could not allocate memory for metrics");
+        status = "500 Internal Server Error";
+        body->length = 0;
+    }
+
+    client->header_length = (size_t)snprintf(client->header, SERVER_HEADER_MAX, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status, body->length);
+}
+
+static void metrics_render_self(buffer_t *buffer) {
+    //current RSS from statm; ru_maxrss would only give the peak
+    long resident_pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "re");
+    if(statm) {
+        if(fscanf(statm, "%*s %ld", &resident_pages) != 1) {
+            resident_pages = 0;
+        }
+        fclose(statm);
+    }
+
+    metrics_header(buffer, "nanoinit_resident_memory_bytes", "gauge", "Resident memory of nanoinit itself.");
+    buffer_printf(buffer, "nanoinit_resident_memory_bytes %lld\n", (long long)resident_pages * sysconf(_SC_PAGESIZE));
+    metrics_header(buffer, "nanoinit_loop_wakeups_total", "counter", "Times the supervisor event loop woke up.");
+    buffer_printf(buffer, "nanoinit_loop_wakeups_total %llu\n", (unsigned long long)eventloop_wakeups());
+    metrics_header(buffer, "nanoinit_scrapes_total", "counter", "Metrics scrapes served.");
+    buffer_printf(buffer, "nanoinit_scrapes_total %llu\n", (unsigned long long)scrapes);
+}
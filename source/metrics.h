@@ -0,0 +1,53 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "buffer.h"
+
+#define METRICS_HISTOGRAM_BUCKETS   12
+
+//latency histogram, in seconds; buckets are not cumulative, they are summed up when rendered
+typedef struct metrics_histogram_s {
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS + 1];   //last one is +Inf
+    uint64_t count;
+    double sum;
+} metrics_histogram_t;
+
+//renders the supervised apps' metrics; nanoinit's own metrics are rendered before it is called
+typedef void (*metrics_render_cb_t)(buffer_t *buffer);
+
+//serves the metrics on "unix:/path/to/socket", "tcp:port" or "tcp:host:port" from the event loop; returns 0 or -1
+int metrics_init(const char *spec, metrics_render_cb_t render);
+void metrics_free(void);
+
+void metrics_header(buffer_t *buffer, const char *name, const char *type, const char *help);
+
+//escapes value for use inside a label's double quotes; returns buffer
+const char *metrics_escape(const char *value, char *buffer, size_t size);
+
+void metrics_histogram_observe(metrics_histogram_t *histogram, double value);
+void metrics_histogram_render(buffer_t *buffer, const char *name, const char *labels, const metrics_histogram_t *histogram);
@@ -0,0 +1,178 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "pidmap.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define PIDMAP_MIN_CAPACITY         16
+
+static size_t pidmap_slot(const pidmap_t *map, pid_t pid);
+static int pidmap_resize(pidmap_t *map, size_t capacity);
+
+int pidmap_init(pidmap_t *map, size_t expected_count) {
+    map->entries = 0;
+    map->capacity = 0;
+    map->count = 0;
+
+    //keep the load factor at or below 1/2 so probe sequences stay short
+    size_t capacity = PIDMAP_MIN_CAPACITY;
+    while(capacity < expected_count * 2) {
+        capacity <<= 1;
+    }
+
+    return pidmap_resize(map, capacity);
+}
+
+void pidmap_free(pidmap_t *map) {
+    free(map->entries);
+    map->entries = 0;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+int pidmap_reserve(pidmap_t *map, size_t count) {
+    size_t capacity = map->capacity ? map->capacity : PIDMAP_MIN_CAPACITY;
+    while(capacity < count * 2) {
+        capacity <<= 1;
+    }
+
+    return (capacity == map->capacity) ? 0 : pidmap_resize(map, capacity);
+}
+
+int pidmap_insert(pidmap_t *map, pid_t pid, void *value) {
+    if((map->count + 1) * 2 > map->capacity) {
+        if(pidmap_resize(map, map->capacity * 2) != 0) {
+            return -1;
+        }
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t i = pidmap_slot(map, pid);
+    while(map->entries[i].pid != 0) {
+        if(map->entries[i].pid == pid) {
+            map->entries[i].value = value;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+
+    map->entries[i].pid = pid;
+    map->entries[i].value = value;
+    map->count++;
+    return 0;
+}
+
+void *pidmap_find(const pidmap_t *map, pid_t pid) {
+    if(map->capacity == 0) {
+        return 0;
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t i = pidmap_slot(map, pid);
+    while(map->entries[i].pid != 0) {
+        if(map->entries[i].pid == pid) {
+            return map->entries[i].value;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return 0;
+}
+
+void *pidmap_remove(pidmap_t *map, pid_t pid) {
+    if(map->capacity == 0) {
+        return 0;
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t i = pidmap_slot(map, pid);
+    while(map->entries[i].pid != pid) {
+        if(map->entries[i].pid == 0) {
+            return 0;   //not found
+        }
+        i = (i + 1) & mask;
+    }
+
+    void *value = map->entries[i].value;
+    map->count--;
+
+    //backward-shift deletion: pull following entries of the cluster into the hole, so no tombstones are needed
+    size_t hole = i;
+    size_t j = i;
+    while(1) {
+        j = (j + 1) & mask;
+        if(map->entries[j].pid == 0) {
+            break;
+        }
+
+        size_t home = pidmap_slot(map, map->entries[j].pid);
+        //entry j may move into the hole only if its home slot is not cyclically in (hole, j]
+        if(((j - home) & mask) >= ((j - hole) & mask)) {
+            map->entries[hole] = map->entries[j];
+            hole = j;
+        }
+    }
+
+    map->entries[hole].pid = 0;
+    map->entries[hole].value = 0;
+    return value;
+}
+
+static size_t pidmap_slot(const pidmap_t *map, pid_t pid) {
+    //murmur3 finalizer; spreads consecutive PIDs over the whole table
+    uint32_t h = (uint32_t)pid;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (size_t)h & (map->capacity - 1);
+}
+
+static int pidmap_resize(pidmap_t *map, size_t capacity) {
+    pidmap_entry_t *entries = (pidmap_entry_t *)calloc(capacity, sizeof(pidmap_entry_t));
+    if(entries == 0) {
+        log_ni_error("pidmap_resize() could not allocate memory for %zu entries", capacity);
+        return -1;
+    }
+
+    pidmap_entry_t *old_entries = map->entries;
+    size_t old_capacity = map->capacity;
+
+    map->entries = entries;
+    map->capacity = capacity;
+    map->count = 0;
+
+    for(size_t i = 0; i < old_capacity; i++) {
+        if(old_entries[i].pid != 0) {
+            pidmap_insert(map, old_entries[i].pid, old_entries[i].value);
+        }
+    }
+
+    free(old_entries);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//open-addressing pid -> pointer hash table; lookups, inserts and removals are O(1) on average
+typedef struct pidmap_entry_s {
+    pid_t pid;                  //0 marks an empty slot
+    void *value;
+} pidmap_entry_t;
+
+typedef struct pidmap_s {
+    pidmap_entry_t *entries;
+    size_t capacity;            //always a power of 2
+    size_t count;
+} pidmap_t;
+
+int pidmap_init(pidmap_t *map, size_t expected_count);
+void pidmap_free(pidmap_t *map);
+
+//makes room for count entries, so inserting up to that many never allocates and cannot fail
+int pidmap_reserve(pidmap_t *map, size_t count);
+
+int pidmap_insert(pidmap_t *map, pid_t pid, void *value);
+void *pidmap_find(const pidmap_t *map, pid_t pid);
+void *pidmap_remove(pidmap_t *map, pid_t pid);
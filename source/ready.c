@@ -0,0 +1,229 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "ready.h"
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define READY_POLL_INTERVAL_MS      100     //how often file existence and TCP ports are checked
+
+static void ready_done(ready_check_t *check, bool ready);
+static void ready_notify_cb(eventloop_source_t *source, uint32_t events);
+static void ready_connect_cb(eventloop_source_t *source, uint32_t events);
+static void ready_poll_cb(eventloop_timer_t *timer);
+static void ready_timeout_cb(eventloop_timer_t *timer);
+static void ready_close_source(eventloop_source_t *source);
+
+void ready_init(ready_check_t *check, const nanoinit_ready_config_t *config, ready_cb_t callback, void *data) {
+    check->config = config;
+    check->callback = callback;
+    check->data = data;
+
+    check->notify_fd = -1;
+    check->notify_read_fd = -1;
+    check->notify_source.fd = -1;
+    check->notify_source.callback = ready_notify_cb;
+    check->notify_source.data = check;
+    check->connect_source.fd = -1;
+    check->connect_source.callback = ready_connect_cb;
+    check->connect_source.data = check;
+
+    eventloop_timer_init(&check->poll_timer, ready_poll_cb, check);
+    eventloop_timer_init(&check->timeout_timer, ready_timeout_cb, check);
+}
+
+int ready_prepare(ready_check_t *check) {
+    ready_cancel(check);
+
+    switch(check->config->type) {
+        case NI_READY_NOTIFY: {
+            int fds[2];
+            if(pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+                log_ni_error("ready_prepare() pipe2() failed with errno %d", errno);
+                return -1;
+            }
+
+            //the child end must block like a regular fd; it stays close-on-exec here and is made inheritable in the child
+            fcntl(fds[1], F_SETFL, 0);
+            check->notify_read_fd = fds[0];
+            check->notify_fd = fds[1];
+            return check->notify_fd;
+        }
+
+        case NI_READY_FILE:
+            //a file left over from a previous run must not count
+            unlink(check->config->path);
+            return -1;
+
+        default:
+            return -1;
+    }
+}
+
+void ready_start(ready_check_t *check) {
+    if(check->notify_fd >= 0) {
+        close(check->notify_fd);
+        check->notify_fd = -1;
+    }
+
+    switch(check->config->type) {
+        case NI_READY_NONE:
+            ready_done(check, true);
+            return;
+
+        case NI_READY_NOTIFY:
+            check->notify_source.fd = check->notify_read_fd;
+            check->notify_read_fd = -1;
+            if((check->notify_source.fd < 0) || (eventloop_add(&check->notify_source, EPOLLIN) != 0)) {
+                //nothing to wait on; don't block dependents forever
+                if(check->notify_source.fd >= 0) {
+                    close(check->notify_source.fd);
+                    check->notify_source.fd = -1;
+                }
+                ready_done(check, true);
+                return;
+            }
+            break;
+
+        case NI_READY_FILE:
+        case NI_READY_TCP:
+            eventloop_timer_start(&check->poll_timer, 0);
+            break;
+
+        case NI_READY_EXIT:
+            //signalled by the supervisor when the app exits cleanly
+            break;
+    }
+
+    if(check->config->timeout_ms > 0) {
+        eventloop_timer_start(&check->timeout_timer, check->config->timeout_ms);
+    }
+}
+
+void ready_cancel(ready_check_t *check) {
+    if(check->notify_fd >= 0) {
+        close(check->notify_fd);
+        check->notify_fd = -1;
+    }
+
+    if(check->notify_read_fd >= 0) {
+        close(check->notify_read_fd);
+        check->notify_read_fd = -1;
+    }
+
+    ready_close_source(&check->notify_source);
+    ready_close_source(&check->connect_source);
+    eventloop_timer_stop(&check->poll_timer);
+    eventloop_timer_stop(&check->timeout_timer);
+}
+
+static void ready_done(ready_check_t *check, bool ready) {
+    ready_cancel(check);
+    check->callback(check, ready);
+}
+
+static void ready_notify_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    ready_check_t *check = (ready_check_t *)source->data;
+
+    char buffer[64];
+    ssize_t r = read(source->fd, buffer, sizeof(buffer));
+    if(r > 0) {
+        ready_done(check, true);
+    }
+    else if((r == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+        //app closed the notify fd without writing; keep waiting for the timeout or the exit
+        ready_close_source(&check->notify_source);
+    }
+}
+
+static void ready_connect_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    ready_check_t *check = (ready_check_t *)source->data;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if((getsockopt(source->fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0) && (error == 0)) {
+        ready_done(check, true);
+        return;
+    }
+
+    ready_close_source(&check->connect_source);
+    eventloop_timer_start(&check->poll_timer, READY_POLL_INTERVAL_MS);
+}
+
+static void ready_poll_cb(eventloop_timer_t *timer) {
+    ready_check_t *check = (ready_check_t *)timer->data;
+
+    if(check->config->type == NI_READY_FILE) {
+        if(access(check->config->path, F_OK) == 0) {
+            ready_done(check, true);
+            return;
+        }
+    }
+    else if(check->config->type == NI_READY_TCP) {
+        int fd = socket(check->config->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd >= 0) {
+            if(connect(fd, (const struct sockaddr *)&check->config->address, check->config->address_length) == 0) {
+                close(fd);
+                ready_done(check, true);
+                return;
+            }
+
+            if(errno == EINPROGRESS) {
+                check->connect_source.fd = fd;
+                if(eventloop_add(&check->connect_source, EPOLLOUT) == 0) {
+                    return;     //ready_connect_cb() takes over
+                }
+                check->connect_source.fd = -1;
+            }
+
+            close(fd);
+        }
+    }
+
+    eventloop_timer_start(&check->poll_timer, READY_POLL_INTERVAL_MS);
+}
+
+static void ready_timeout_cb(eventloop_timer_t *timer) {
+    ready_check_t *check = (ready_check_t *)timer->data;
+    ready_done(check, false);
+}
+
+static void ready_close_source(eventloop_source_t *source) {
+    if(source->fd >= 0) {
+        eventloop_remove(source);
+        close(source->fd);
+        source->fd = -1;
+    }
+}
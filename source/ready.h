@@ -0,0 +1,58 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include "config.h"
+#include "eventloop.h"
+
+typedef struct ready_check_s ready_check_t;
+
+//called once per spawn: with ready set when the app signalled readiness, or with ready cleared when ready_timeout expired
+typedef void (*ready_cb_t)(ready_check_t *check, bool ready);
+
+struct ready_check_s {
+    const nanoinit_ready_config_t *config;
+    ready_cb_t callback;
+    void *data;
+
+    int notify_fd;                      //write end handed to the child; -1 when not used
+    int notify_read_fd;                 //read end, until ready_start() moves it to notify_source
+    eventloop_source_t notify_source;   //read end of the notify pipe
+    eventloop_source_t connect_source;  //in-flight non-blocking connect for NI_READY_TCP
+    eventloop_timer_t poll_timer;       //NI_READY_FILE and NI_READY_TCP retry interval
+    eventloop_timer_t timeout_timer;
+};
+
+void ready_init(ready_check_t *check, const nanoinit_ready_config_t *config, ready_cb_t callback, void *data);
+
+//called before spawning; returns the notify fd the child must inherit, or -1
+int ready_prepare(ready_check_t *check);
+
+//called after a successful spawn; starts watching for readiness
+void ready_start(ready_check_t *check);
+
+//stops watching and releases all fds; safe to call at any time
+void ready_cancel(ready_check_t *check);
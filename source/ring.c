@@ -0,0 +1,224 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_HEADER         sizeof(uint32_t)
+
+static void ring_copy_in(ring_t *ring, uint64_t position, const void *data, size_t length);
+static void ring_copy_out(const ring_t *ring, uint64_t position, void *data, size_t length);
+static bool ring_fits(ring_t *ring, size_t need);
+static void ring_wake(ring_t *ring);
+
+int ring_init(ring_t *ring, size_t size, ring_overflow_t overflow) {
+    memset(ring, 0, sizeof(ring_t));
+
+    ring->size = RING_SIZE_MIN;
+    while(ring->size < size) {
+        ring->size <<= 1;
+    }
+    ring->overflow = overflow;
+    ring->data = (char *)malloc(ring->size);
+    if(ring->data == 0) {
+        return -1;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->closed, false);
+    atomic_init(&ring->kicked, false);
+    atomic_init(&ring->consumer_waiting, false);
+    atomic_init(&ring->producer_waiting, false);
+    pthread_mutex_init(&ring->mutex, 0);
+    pthread_cond_init(&ring->cond, 0);
+    return 0;
+}
+
+void ring_free(ring_t *ring) {
+    if(ring->data) {
+        pthread_cond_destroy(&ring->cond);
+        pthread_mutex_destroy(&ring->mutex);
+        free(ring->data);
+        ring->data = 0;
+    }
+}
+
+int ring_push(ring_t *ring, const void *record, size_t length) {
+    struct iovec part = { (void *)record, length };
+    return ring_pushv(ring, &part, 1);
+}
+
+int ring_pushv(ring_t *ring, const struct iovec *parts, int count) {
+    size_t length = 0;
+    for(int i = 0; i < count; i++) {
+        length += parts[i].iov_len;
+    }
+
+    size_t need = RING_HEADER + length;
+    if(length > RING_RECORD_MAX) {
+        atomic_fetch_add(&ring->dropped, 1);
+        return -1;
+    }
+
+    while(!ring_fits(ring, need)) {
+        if(ring->overflow == RING_DROP_NEWEST) {
+            atomic_fetch_add(&ring->dropped, 1);
+            return -1;
+        }
+
+        if(ring->overflow == RING_DROP_OLDEST) {
+            //the consumer may be popping the same record; whoever moves the tail first has it
+            uint64_t tail = atomic_load(&ring->tail);
+            uint32_t oldest;
+            ring_copy_out(ring, tail, &oldest, RING_HEADER);
+            if(atomic_compare_exchange_strong(&ring->tail, &tail, tail + RING_HEADER + oldest)) {
+                atomic_fetch_add(&ring->dropped, 1);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&ring->mutex);
+        atomic_store(&ring->producer_waiting, true);
+        while(!ring_fits(ring, need) && !atomic_load(&ring->closed)) {
+            pthread_cond_wait(&ring->cond, &ring->mutex);
+        }
+        atomic_store(&ring->producer_waiting, false);
+        pthread_mutex_unlock(&ring->mutex);
+
+        if(atomic_load(&ring->closed)) {
+            atomic_fetch_add(&ring->dropped, 1);
+            return -1;
+        }
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t header = (uint32_t)length;
+    ring_copy_in(ring, head, &header, RING_HEADER);
+    uint64_t position = head + RING_HEADER;
+    for(int i = 0; i < count; i++) {
+        ring_copy_in(ring, position, parts[i].iov_base, parts[i].iov_len);
+        position += parts[i].iov_len;
+    }
+    atomic_store(&ring->head, head + need);
+
+    if(atomic_load(&ring->consumer_waiting)) {
+        ring_wake(ring);
+    }
+    return 0;
+}
+
+ssize_t ring_pop(ring_t *ring, void *out, size_t size) {
+    while(true) {
+        uint64_t tail = atomic_load(&ring->tail);
+        uint64_t head = atomic_load(&ring->head);
+        if(tail == head) {
+            return 0;
+        }
+
+        //the record is copied before the tail is moved past it; if the producer dropped it meanwhile, the copy may be
+        //torn and is thrown away
+        uint32_t length;
+        ring_copy_out(ring, tail, &length, RING_HEADER);
+        if((length > RING_RECORD_MAX) || (length > size)) {
+            if(atomic_load(&ring->tail) != tail) {
+                continue;
+            }
+            return -1;
+        }
+        ring_copy_out(ring, tail + RING_HEADER, out, length);
+        if(!atomic_compare_exchange_strong(&ring->tail, &tail, tail + RING_HEADER + length)) {
+            continue;
+        }
+
+        if(atomic_load(&ring->producer_waiting)) {
+            ring_wake(ring);
+        }
+        return (ssize_t)length;
+    }
+}
+
+bool ring_wait(ring_t *ring) {
+    //the waiting flag is set before the ring is checked and the producer checks it after pushing, so a record pushed
+    //meanwhile is never slept over
+    pthread_mutex_lock(&ring->mutex);
+    atomic_store(&ring->consumer_waiting, true);
+    while((atomic_load(&ring->head) == atomic_load(&ring->tail)) && !atomic_load(&ring->closed) && !atomic_load(&ring->kicked)) {
+        pthread_cond_wait(&ring->cond, &ring->mutex);
+    }
+    atomic_store(&ring->consumer_waiting, false);
+    bool more = (atomic_load(&ring->head) != atomic_load(&ring->tail)) || !atomic_load(&ring->closed);
+    atomic_store(&ring->kicked, false);
+    pthread_mutex_unlock(&ring->mutex);
+
+    return more;
+}
+
+void ring_kick(ring_t *ring) {
+    atomic_store(&ring->kicked, true);
+    ring_wake(ring);
+}
+
+void ring_close(ring_t *ring) {
+    atomic_store(&ring->closed, true);
+    ring_wake(ring);
+}
+
+uint64_t ring_dropped(ring_t *ring) {
+    return atomic_load(&ring->dropped);
+}
+
+static void ring_copy_in(ring_t *ring, uint64_t position, const void *data, size_t length) {
+    size_t offset = (size_t)(position & (ring->size - 1));
+    size_t first = ring->size - offset;
+    if(first > length) {
+        first = length;
+    }
+
+    memcpy(ring->data + offset, data, first);
+    memcpy(ring->data, (const char *)data + first, length - first);
+}
+
+static void ring_copy_out(const ring_t *ring, uint64_t position, void *data, size_t length) {
+    size_t offset = (size_t)(position & (ring->size - 1));
+    size_t first = ring->size - offset;
+    if(first > length) {
+        first = length;
+    }
+
+    memcpy(data, ring->data + offset, first);
+    memcpy((char *)data + first, ring->data, length - first);
+}
+
+static bool ring_fits(ring_t *ring, size_t need) {
+    return atomic_load(&ring->head) - atomic_load(&ring->tail) + need <= ring->size;
+}
+
+static void ring_wake(ring_t *ring) {
+    pthread_mutex_lock(&ring->mutex);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+}
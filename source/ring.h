@@ -0,0 +1,84 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define RING_SIZE_MIN               65536
+#define RING_RECORD_MAX             16384   //longer records have to be split by the producer
+
+//what ring_push() does when the record doesn't fit
+typedef enum {
+    RING_DROP_OLDEST = 0,           //discards the oldest records until it fits
+    RING_DROP_NEWEST,               //discards the record being pushed
+    RING_BLOCK,                     //waits for the consumer to make room
+} ring_overflow_t;
+
+//bounded ring of variable length records, for one producer and one consumer thread. Records are a uint32_t length
+//followed by the bytes; head and tail only ever grow and are taken modulo size
+typedef struct ring_s {
+    char *data;
+    size_t size;                    //a power of two
+    ring_overflow_t overflow;
+    _Atomic uint64_t head;          //moved by the producer only
+    _Atomic uint64_t tail;          //moved by the consumer, and by the producer dropping the oldest record
+    _Atomic uint64_t dropped;       //records lost to overflow
+    atomic_bool closed;
+    atomic_bool kicked;             //ring_kick() was called since the consumer last woke up
+    atomic_bool consumer_waiting;
+    atomic_bool producer_waiting;
+    pthread_mutex_t mutex;          //only to sleep on cond; never taken while the ring has work
+    pthread_cond_t cond;
+} ring_t;
+
+//size is rounded up to a power of two, at least RING_SIZE_MIN
+int ring_init(ring_t *ring, size_t size, ring_overflow_t overflow);
+void ring_free(ring_t *ring);
+
+//producer: copies the record into the ring; returns -1 if it was dropped
+int ring_push(ring_t *ring, const void *record, size_t length);
+
+//producer: same, for a record gathered from count parts
+int ring_pushv(ring_t *ring, const struct iovec *parts, int count);
+
+//consumer: copies the oldest record into out; returns its length, 0 if the ring is empty, or -1 if it is longer than size
+ssize_t ring_pop(ring_t *ring, void *out, size_t size);
+
+//consumer: sleeps until there is a record to pop or ring_kick() is called; returns false once the ring is closed and empty
+bool ring_wait(ring_t *ring);
+
+//wakes the consumer without a record, for it to look at state kept outside the ring
+void ring_kick(ring_t *ring);
+
+//wakes the consumer for good, so it can drain what is left and exit
+void ring_close(ring_t *ring);
+
+uint64_t ring_dropped(ring_t *ring);
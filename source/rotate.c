@@ -0,0 +1,177 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "rotate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static int rotate_open(rotate_file_t *file);
+static void rotate_shift(const char *path, int keep);
+static uint64_t rotate_now(void);
+
+bool rotate_enabled(const rotate_policy_t *policy) {
+    return policy && ((policy->max_size > 0) || (policy->max_age_ms > 0));
+}
+
+bool rotate_policy_equal(const rotate_policy_t *a, const rotate_policy_t *b) {
+    return (a->max_size == b->max_size) && (a->max_age_ms == b->max_age_ms) && (a->keep == b->keep);
+}
+
+void rotate_init(rotate_file_t *file, const rotate_policy_t *policy) {
+    memset(file, 0, sizeof(rotate_file_t));
+    file->policy = policy;
+    file->fd = -1;
+}
+
+int rotate_set_path(rotate_file_t *file, const char *path, bool append) {
+    bool same_path = (file->path && path) ? (strcmp(file->path, path) == 0) : (file->path == path);
+    if(same_path && (file->append == append)) {
+        return 0;
+    }
+
+    rotate_close(file);
+    free(file->path);
+    file->path = 0;
+    file->append = append;
+    if(path) {
+        file->path = strdup(path);
+        if(file->path == 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int rotate_fd(rotate_file_t *file) {
+    if((file->fd == -1) && file->path) {
+        rotate_open(file);
+    }
+
+    return file->fd;
+}
+
+size_t rotate_room(const rotate_file_t *file, size_t length) {
+    if(!file->regular || !rotate_enabled(file->policy) || (file->policy->max_size == 0)) {
+        return length;
+    }
+
+    unsigned long long max_size = (unsigned long long)file->policy->max_size;
+    unsigned long long room = (file->size < max_size) ? max_size - file->size : 1;
+    return (room < length) ? (size_t)room : length;
+}
+
+int rotate_written(rotate_file_t *file, size_t length) {
+    file->size += length;
+    if(!file->regular || !rotate_enabled(file->policy)) {
+        return 0;
+    }
+
+    const rotate_policy_t *policy = file->policy;
+    bool due = (policy->max_size > 0) && (file->size >= (unsigned long long)policy->max_size);
+    due = due || ((policy->max_age_ms > 0) && (rotate_now() - file->opened_ms >= (uint64_t)policy->max_age_ms));
+    if(!due) {
+        return 0;
+    }
+
+    //the new file is opened before the old one is closed, so a failed open keeps writing to the old one under its new name
+    rotate_shift(file->path, policy->keep);
+    int old_fd = file->fd;
+    if(rotate_open(file) < 0) {
+        file->fd = old_fd;
+        file->size = 0;
+        file->opened_ms = rotate_now();
+        return -1;
+    }
+
+    close(old_fd);
+    return 0;
+}
+
+void rotate_reset(rotate_file_t *file) {
+    if(file->fd == ROTATE_FAILED) {
+        file->fd = -1;
+    }
+}
+
+void rotate_close(rotate_file_t *file) {
+    if(file->fd >= 0) {
+        close(file->fd);
+    }
+    file->fd = -1;
+}
+
+static int rotate_open(rotate_file_t *file) {
+    //splice() refuses files opened in append mode, so those that are spliced into start at the end instead
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (file->append ? O_APPEND : 0);
+    int fd = open(file->path, flags, 0666);
+    if(fd < 0) {
+        file->fd = ROTATE_FAILED;
+        return -1;
+    }
+
+    struct stat st;
+    file->regular = (fstat(fd, &st) == 0) && S_ISREG(st.st_mode);
+    file->size = file->regular ? (unsigned long long)st.st_size : 0;
+    if(!file->append && file->regular) {
+        lseek(fd, 0, SEEK_END);
+    }
+
+    file->fd = fd;
+    file->opened_ms = rotate_now();
+    return 0;
+}
+
+static void rotate_shift(const char *path, int keep) {
+    //path.<keep - 1> replaces path.<keep>, and so on down to path itself becoming path.1
+    size_t length = strlen(path) + 16;
+    char from[length];
+    char to[length];
+    if(keep == 0) {
+        unlink(path);
+        return;
+    }
+
+    for(int i = keep - 1; i >= 1; i--) {
+        snprintf(from, length, "%s.%d", path, i);
+        snprintf(to, length, "%s.%d", path, i + 1);
+        rename(from, to);     //gaps are normal while fewer than keep rotations happened
+    }
+
+    snprintf(to, length, "%s.1", path);
+    rename(path, to);
+}
+
+static uint64_t rotate_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
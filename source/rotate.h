@@ -0,0 +1,73 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROTATE_DEFAULT_KEEP         5       //old files kept when rotation is configured without a keep count
+#define ROTATE_KEEP_MAX             1000
+
+//when a file is rotated; a policy with neither max_size nor max_age_ms set never rotates
+typedef struct rotate_policy_s {
+    long long max_size;                 //bytes; 0 for no limit
+    int max_age_ms;                     //since nanoinit opened the file; 0 for no limit
+    int keep;                           //rotated files kept as path.1 (newest) to path.<keep>; 0 deletes the file instead
+} rotate_policy_t;
+
+//file nanoinit writes to and rotates: once the policy is exceeded, path is renamed to path.1 and a new one is opened in its place
+typedef struct rotate_file_s {
+    const rotate_policy_t *policy;      //0 never rotates
+    char *path;                         //0 while unset
+    bool append;                        //opened in append mode; without it, writes start at the end of the existing file
+    int fd;                             //-1 until opened, ROTATE_FAILED after open() failed
+    unsigned long long size;
+    uint64_t opened_ms;                 //CLOCK_MONOTONIC
+    bool regular;                       //only regular files are rotated, never e.g. /dev/null
+} rotate_file_t;
+
+#define ROTATE_FAILED               -2      //fd after open() failed; not tried again until the path changes or rotate_reset() is called
+
+bool rotate_enabled(const rotate_policy_t *policy);
+bool rotate_policy_equal(const rotate_policy_t *a, const rotate_policy_t *b);
+
+void rotate_init(rotate_file_t *file, const rotate_policy_t *policy);
+
+//sets the path to write to; a different path or mode closes the current file, and the new one is opened by the next rotate_fd()
+int rotate_set_path(rotate_file_t *file, const char *path, bool append);
+
+//returns the descriptor of the file, opening it the first time; a negative value if it can't be opened
+int rotate_fd(rotate_file_t *file);
+
+//returns how many of length bytes fit before the file reaches its max_size, at least 1
+size_t rotate_room(const rotate_file_t *file, size_t length);
+
+//accounts length bytes written to the file and rotates it once the policy is exceeded; returns -1 if the rotation failed
+int rotate_written(rotate_file_t *file, size_t length);
+
+//forgets a failed open(), so the next rotate_fd() tries again
+void rotate_reset(rotate_file_t *file);
+void rotate_close(rotate_file_t *file);
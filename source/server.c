@@ -0,0 +1,292 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "address.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+static void server_release(server_t *server);
+static void server_listen_cb(eventloop_source_t *source, uint32_t events);
+static void server_client_cb(eventloop_source_t *source, uint32_t events);
+static void server_timeout_cb(eventloop_timer_t *timer);
+static void server_send(server_client_t *client);
+static void server_client_close(server_client_t *client);
+
+int server_init(server_t *server, const struct sockaddr_storage *address, socklen_t address_length, const char *unix_path) {
+    server->clients = (server_client_t *)calloc(server->clients_max, sizeof(server_client_t));
+    server->requests = (char *)malloc(server->clients_max * server->request_max);
+    if((server->clients == 0) || (server->requests == 0)) {
+        log_ni_error("server_init() bad memory allocation for %s", server->name);
+        server_release(server);
+        return -1;
+    }
+
+    for(int i = 0; i < server->clients_max; i++) {
+        server_client_t *client = &server->clients[i];
+        client->server = server;
+        client->source.fd = -1;
+        client->source.callback = server_client_cb;
+        client->source.data = client;
+        client->request = server->requests + i * server->request_max;
+        eventloop_timer_init(&client->timeout_timer, server_timeout_cb, client);
+    }
+
+    int fd = socket(address->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        log_ni_error("server_init() socket() failed for %s with errno %d", server->name, errno);
+        server_release(server);
+        return -1;
+    }
+
+    if(unix_path) {
+        //a socket left behind by a previous run would make bind() fail
+        if(address_unlink_stale(unix_path) != 0) {
+            log_ni_error("server_init() %s is in use by another process", unix_path);
+            close(fd);
+            server_release(server);
+            return -1;
+        }
+    }
+    else {
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    }
+
+    //a private socket is created without group and other permissions, so there is no window in which others can connect
+    mode_t mask = server->private_socket ? umask(0077) : 0;
+    int rc = bind(fd, (const struct sockaddr *)address, address_length);
+    if(server->private_socket) {
+        umask(mask);
+    }
+
+    if((rc != 0) || (listen(fd, server->backlog) != 0)) {
+        log_ni_error("server_init() could not listen for %s, errno %d", server->name, errno);
+        close(fd);
+        server_release(server);
+        return -1;
+    }
+
+    server->unix_path = unix_path ? strdup(unix_path) : 0;
+    server->listen_source.fd = fd;
+    server->listen_source.callback = server_listen_cb;
+    server->listen_source.data = server;
+    if(eventloop_add(&server->listen_source, EPOLLIN) != 0) {
+        close(fd);
+        server->listen_source.fd = -1;
+        if(server->unix_path) {
+            unlink(server->unix_path);
+        }
+        server_release(server);
+        return -1;
+    }
+
+    return 0;
+}
+
+void server_free(server_t *server) {
+    //client slots are only set up by a successful server_init()
+    if(server->listen_source.fd < 0) {
+        return;
+    }
+
+    for(int i = 0; i < server->clients_max; i++) {
+        if(server->clients[i].source.fd >= 0) {
+            server_client_close(&server->clients[i]);
+        }
+    }
+
+    eventloop_remove(&server->listen_source);
+    close(server->listen_source.fd);
+    server->listen_source.fd = -1;
+
+    if(server->unix_path) {
+        unlink(server->unix_path);
+    }
+    server_release(server);
+}
+
+static void server_release(server_t *server) {
+    for(int i = 0; server->clients && (i < server->clients_max); i++) {
+        buffer_free(&server->clients[i].reply);
+    }
+
+    free(server->clients);
+    server->clients = 0;
+    free(server->requests);
+    server->requests = 0;
+    free(server->unix_path);
+    server->unix_path = 0;
+}
+
+static void server_listen_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+    server_t *server = (server_t *)source->data;
+
+    int fd;
+    while((fd = accept4(source->fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if(server->accept && !server->accept(fd)) {
+            close(fd);
+            continue;
+        }
+
+        server_client_t *client = 0;
+        for(int i = 0; i < server->clients_max; i++) {
+            if(server->clients[i].source.fd < 0) {
+                client = &server->clients[i];
+                break;
+            }
+        }
+
+        if(client == 0) {
+            log("server_listen_cb() too many concurrent %s clients; connection dropped", server->name);
+            close(fd);
+            continue;
+        }
+
+        client->source.fd = fd;
+        client->request_length = 0;
+        client->replying = false;
+        client->waiting_output = false;
+        client->sent = 0;
+        if(eventloop_add(&client->source, EPOLLIN) != 0) {
+            close(fd);
+            client->source.fd = -1;
+            continue;
+        }
+
+        //a client without its timeout could hold the slot forever
+        if(eventloop_timer_start(&client->timeout_timer, (uint64_t)server->timeout_ms) != 0) {
+            server_client_close(client);
+        }
+    }
+}
+
+static void server_client_cb(eventloop_source_t *source, uint32_t events) {
+    server_client_t *client = (server_client_t *)source->data;
+    server_t *server = client->server;
+    if(client->replying) {
+        server_send(client);
+        return;
+    }
+
+    if(events & (EPOLLERR | EPOLLHUP)) {
+        server_client_close(client);
+        return;
+    }
+
+    ssize_t count = read(source->fd, client->request + client->request_length, server->request_max - 1 - client->request_length);
+    if(count < 0) {
+        if((errno != EAGAIN) && (errno != EINTR)) {
+            server_client_close(client);
+        }
+        return;
+    }
+
+    if(count == 0) {
+        server_client_close(client);
+        return;
+    }
+
+    client->request_length += (size_t)count;
+    client->request[client->request_length] = 0;
+    if(server->complete(client->request)) {
+        buffer_reset(&client->reply);
+        client->header_length = 0;
+        server->respond(client);
+        client->replying = true;
+        client->sent = 0;
+        server_send(client);
+    }
+    else if(client->request_length == server->request_max - 1) {
+        server_client_close(client);
+    }
+}
+
+static void server_timeout_cb(eventloop_timer_t *timer) {
+    server_client_close((server_client_t *)timer->data);
+}
+
+static void server_send(server_client_t *client) {
+    //MSG_NOSIGNAL: a client going away must not raise SIGPIPE in nanoinit
+    while(true) {
+        struct iovec iov[2];
+        struct msghdr msg = {0};
+        size_t total = client->header_length + client->reply.length;
+        if(client->sent >= total) {
+            server_client_close(client);
+            return;
+        }
+
+        if(client->sent < client->header_length) {
+            iov[0].iov_base = client->header + client->sent;
+            iov[0].iov_len = client->header_length - client->sent;
+            iov[1].iov_base = client->reply.data;
+            iov[1].iov_len = client->reply.length;
+            msg.msg_iovlen = client->reply.length ? 2 : 1;
+        }
+        else {
+            iov[0].iov_base = client->reply.data + (client->sent - client->header_length);
+            iov[0].iov_len = total - client->sent;
+            msg.msg_iovlen = 1;
+        }
+        msg.msg_iov = iov;
+
+        ssize_t count = sendmsg(client->source.fd, &msg, MSG_NOSIGNAL);
+        if(count < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            //the rest is sent as the client reads; the timeout still applies
+            if(errno == EAGAIN) {
+                if(client->waiting_output || (eventloop_modify(&client->source, EPOLLOUT) == 0)) {
+                    client->waiting_output = true;
+                    return;
+                }
+            }
+
+            server_client_close(client);
+            return;
+        }
+
+        client->sent += (size_t)count;
+    }
+}
+
+static void server_client_close(server_client_t *client) {
+    eventloop_timer_stop(&client->timeout_timer);
+    eventloop_remove(&client->source);
+    close(client->source.fd);
+    client->source.fd = -1;
+}
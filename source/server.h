@@ -0,0 +1,84 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include "buffer.h"
+#include "eventloop.h"
+
+#define SERVER_HEADER_MAX           160
+
+typedef struct server_s server_t;
+
+//one connection: a single request is read, one reply is sent, then the connection is closed
+typedef struct server_client_s {
+    server_t *server;
+    eventloop_source_t source;          //fd is -1 while the slot is free
+    eventloop_timer_t timeout_timer;
+    char *request;                      //request_max bytes of the server, kept NUL-terminated
+    size_t request_length;
+    bool replying;                      //request read; header and reply are being sent
+    bool waiting_output;                //socket buffer was full; registered for EPOLLOUT
+    char header[SERVER_HEADER_MAX];     //sent before reply; header_length is 0 for none
+    size_t header_length;
+    buffer_t reply;
+    size_t sent;                        //of header followed by reply
+} server_client_t;
+
+//whether the peer connected on fd may be served
+typedef bool (*server_accept_cb_t)(int fd);
+
+//whether request already holds a whole request
+typedef bool (*server_complete_cb_t)(const char *request);
+
+//fills client->reply, and client->header if needed, for the request in client->request; both start out empty
+typedef void (*server_respond_cb_t)(server_client_t *client);
+
+//stream socket server run from the event loop, shared by the control socket and the metrics endpoint
+struct server_s {
+    //set before server_init()
+    const char *name;                   //in log lines
+    int clients_max;                    //requests served at once; further connections are closed right away
+    size_t request_max;                 //terminating NUL included; a longer request drops the connection
+    int timeout_ms;                     //a client that doesn't send its request or read the reply in time is dropped
+    int backlog;
+    bool private_socket;                //unix socket created without group and other permissions
+    server_accept_cb_t accept;          //0 serves every peer
+    server_complete_cb_t complete;
+    server_respond_cb_t respond;
+
+    eventloop_source_t listen_source;   //fd is -1 while not listening; set it so before server_init()
+    char *unix_path;                    //socket file, removed by server_free(); 0 for inet addresses
+    server_client_t *clients;
+    char *requests;                     //request buffers of all clients, in one block
+};
+
+//listens on address; unix_path is the socket file of a unix address, where a stale socket is removed first, or 0; returns 0 or -1
+int server_init(server_t *server, const struct sockaddr_storage *address, socklen_t address_length, const char *unix_path);
+
+//closes the connections and the listening socket; does nothing if server_init() did not succeed
+void server_free(server_t *server);
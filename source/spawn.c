@@ -0,0 +1,604 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "spawn.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/mempolicy.h>
+
+#define SPAWN_STACK_SIZE            (64 * 1024)     //child only runs a handful of syscalls before execve
+#define SPAWN_EXTRA_ENV_MAX         4               //per-spawn variables appended to the plan environment
+
+#ifndef SYS_ioprio_set
+#define SYS_ioprio_set              251
+#endif
+
+#ifndef SYS_clone3
+#define SYS_clone3                  435
+#endif
+
+#ifndef SYS_close_range
+#define SYS_close_range             436
+#endif
+
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC         (1U << 2)
+#endif
+
+#define SPAWN_SWEEP_FALLBACK_MAX    65536           //highest fd marked close-on-exec one by one on kernels without close_range()
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP           0x200000000ULL
+#endif
+
+#define SPAWN_IOPRIO_WHO_PROCESS    1
+#define SPAWN_IOPRIO_CLASS_SHIFT    13
+
+typedef struct spawn_report_s {
+    enum {
+        SPAWN_STAGE_NONE = 0,
+        SPAWN_STAGE_CGROUP,
+        SPAWN_STAGE_REDIRECT,
+        SPAWN_STAGE_AFFINITY,
+        SPAWN_STAGE_MEMPOLICY,
+        SPAWN_STAGE_NICE,
+        SPAWN_STAGE_SCHED,
+        SPAWN_STAGE_IOPRIO,
+        SPAWN_STAGE_LISTEN_FDS,
+        SPAWN_STAGE_RLIMIT,
+        SPAWN_STAGE_EXEC,
+    } failed_stage;
+    int failed_errno;
+} spawn_report_t;
+
+typedef struct spawn_child_s {
+    const spawn_request_t *request;
+    char *const *envp;          //plan environment plus per-spawn variables
+    sigset_t sigmask;           //mask to restore right before execve
+    int report_fd;              //fork strategy only; -1 when the report is written directly in shared memory
+    bool in_cgroup;             //created by clone3(CLONE_INTO_CGROUP), so already in request->cgroup_fd
+    char *listen_pid;           //digits of the LISTEN_PID entry, written by the child once it knows its pid; 0 without listen fds
+
+    spawn_report_t report;      //filled by the child on failure
+} spawn_child_t;
+
+static spawn_strategy_t spawn_strategy = SPAWN_STRATEGY_VFORK;
+static void *spawn_stack = 0;
+
+static int spawn_child(void *arg);
+static const char *spawn_plan_redirect(const char *path);
+static char *spawn_plan_copy_string(char **cursor, const char *value);
+static void spawn_child_fail(spawn_child_t *child, int stage);
+static int spawn_sched_policy(spawn_sched_policy_t policy);
+static void spawn_sweep_fds(int first);
+static int spawn_place_fds(spawn_child_t *child);
+static void spawn_format_pid(char *out, pid_t pid);
+static pid_t spawn_vfork(spawn_child_t *child);
+static pid_t spawn_fork(spawn_child_t *child);
+static pid_t spawn_clone3_into_cgroup(int cgroup_fd);
+
+int spawn_init(spawn_strategy_t strategy) {
+    spawn_strategy = strategy;
+
+    if(spawn_strategy == SPAWN_STRATEGY_VFORK) {
+        spawn_stack = mmap(0, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if(spawn_stack == MAP_FAILED) {
+            log_ni_error("spawn_init() could not allocate child stack; falling back to fork");
+            spawn_stack = 0;
+            spawn_strategy = SPAWN_STRATEGY_FORK;
+        }
+    }
+
+    return 0;
+}
+
+void spawn_free(void) {
+    if(spawn_stack) {
+        munmap(spawn_stack, SPAWN_STACK_SIZE);
+        spawn_stack = 0;
+    }
+}
+
+spawn_plan_t *spawn_plan_create(const char *path, char *const *args, int arg_count, char *const *envp, const char *stdout_path, const char *stderr_path, const spawn_attr_t *attr) {
+    stdout_path = spawn_plan_redirect(stdout_path);
+    stderr_path = spawn_plan_redirect(stderr_path);
+
+    int env_count = 0;
+    while(envp && envp[env_count]) {
+        env_count++;
+    }
+
+    //layout: plan | argv[arg_count + 2] | envp[env_count + 1] | strings
+    size_t size = sizeof(spawn_plan_t) + sizeof(char *) * (arg_count + 2) + sizeof(char *) * (env_count + 1);
+    size += strlen(path) + 1;
+    for(int i = 0; i < arg_count; i++) {
+        size += strlen(args[i]) + 1;
+    }
+    for(int i = 0; i < env_count; i++) {
+        size += strlen(envp[i]) + 1;
+    }
+    size += stdout_path ? strlen(stdout_path) + 1 : 0;
+    size += stderr_path ? strlen(stderr_path) + 1 : 0;
+
+    spawn_plan_t *plan = (spawn_plan_t *)malloc(size);
+    if(plan == 0) {
+        log_ni_error("spawn_plan_create() could not allocate memory for %s", path);
+        return 0;
+    }
+
+    char **plan_argv = (char **)(plan + 1);
+    char **plan_envp = plan_argv + arg_count + 2;
+    char *cursor = (char *)(plan_envp + env_count + 1);
+
+    plan->path = spawn_plan_copy_string(&cursor, path);
+    plan_argv[0] = (char *)plan->path;
+    for(int i = 0; i < arg_count; i++) {
+        plan_argv[i + 1] = spawn_plan_copy_string(&cursor, args[i]);
+    }
+    plan_argv[arg_count + 1] = 0;
+
+    for(int i = 0; i < env_count; i++) {
+        plan_envp[i] = spawn_plan_copy_string(&cursor, envp[i]);
+    }
+    plan_envp[env_count] = 0;
+
+    plan->argv = plan_argv;
+    plan->envp = plan_envp;
+    plan->env_count = env_count;
+    plan->stdout_path = stdout_path ? spawn_plan_copy_string(&cursor, stdout_path) : 0;
+    plan->stderr_path = stderr_path ? spawn_plan_copy_string(&cursor, stderr_path) : 0;
+    plan->attr = *attr;
+
+    return plan;
+}
+
+pid_t spawn_process(const spawn_request_t *request) {
+    //per-spawn variables live on this stack frame; the plan itself is never modified
+    const spawn_plan_t *plan = request->plan;
+    char *envp[plan->env_count + SPAWN_EXTRA_ENV_MAX + 1];
+    int env_count = plan->env_count;
+    memcpy(envp, plan->envp, sizeof(char *) * env_count);
+
+    //listen fds take 3, 4, ...; the notify fd then lands right after them instead of at its number in nanoinit
+    char notify_env[32];
+    if(request->notify_fd >= 0) {
+        int notify_fd = (request->listen_fd_count > 0) ? (STDERR_FILENO + 1 + request->listen_fd_count) : request->notify_fd;
+        snprintf(notify_env, sizeof(notify_env), "NANOINIT_NOTIFY_FD=%d", notify_fd);
+        envp[env_count++] = notify_env;
+    }
+
+    char listen_fds_env[32];
+    char listen_pid_env[32] = "LISTEN_PID=";
+    if(request->listen_fd_count > 0) {
+        snprintf(listen_fds_env, sizeof(listen_fds_env), "LISTEN_FDS=%d", request->listen_fd_count);
+        envp[env_count++] = listen_fds_env;
+        envp[env_count++] = listen_pid_env;
+        if(request->listen_fdnames) {
+            envp[env_count++] = (char *)request->listen_fdnames;
+        }
+    }
+    envp[env_count] = 0;
+
+    spawn_child_t child;
+    child.request = request;
+    child.envp = envp;
+    child.report_fd = -1;
+    child.in_cgroup = false;
+    child.listen_pid = (request->listen_fd_count > 0) ? (listen_pid_env + strlen(listen_pid_env)) : 0;
+    child.report.failed_stage = SPAWN_STAGE_NONE;
+    child.report.failed_errno = 0;
+    sigemptyset(&child.sigmask);
+
+    //block everything while the child shares our memory, so no handler can run on the child's stack
+    sigset_t all, old;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &old);
+
+    pid_t pid = -1;
+    if(spawn_strategy == SPAWN_STRATEGY_VFORK) {
+        pid = spawn_vfork(&child);
+        if((pid < 0) && (errno != EAGAIN) && (errno != ENOMEM)) {
+            log_ni_error("spawn_process() clone() failed with errno %d; falling back to fork", errno);
+            spawn_free();
+            spawn_strategy = SPAWN_STRATEGY_FORK;
+        }
+    }
+
+    if(spawn_strategy == SPAWN_STRATEGY_FORK) {
+        pid = spawn_fork(&child);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, 0);
+
+    if(pid < 0) {
+        log_ni_error("spawn_process() could not create child for %s, errno %d", request->plan->path, errno);
+        return -1;
+    }
+
+    if(child.report.failed_stage != SPAWN_STAGE_NONE) {
+        //the child already called _exit(); collect it here so the caller never sees this pid
+        waitpid(pid, 0, 0);
+
+        switch(child.report.failed_stage) {
+            case SPAWN_STAGE_CGROUP:
+                log_ni_error("spawn_process() could not move %s into its cgroup, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_REDIRECT:
+                log_ni_error("spawn_process() could not redirect output for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_AFFINITY:
+                log_ni_error("spawn_process() could not set CPU affinity for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_MEMPOLICY:
+                log_ni_error("spawn_process() could not set NUMA memory policy for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_NICE:
+                log_ni_error("spawn_process() could not set nice level for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_SCHED:
+                log_ni_error("spawn_process() could not set scheduling policy for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_IOPRIO:
+                log_ni_error("spawn_process() could not set I/O priority for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_LISTEN_FDS:
+                log_ni_error("spawn_process() could not pass listening sockets to %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            case SPAWN_STAGE_RLIMIT:
+                log_ni_error("spawn_process() could not set resource limits for %s, errno %d", request->plan->path, child.report.failed_errno);
+                break;
+
+            default:
+                log_ni_error("spawn_process() execve %s failed with errno %d", request->plan->path, child.report.failed_errno);
+                break;
+        }
+
+        errno = child.report.failed_errno;
+        return -1;
+    }
+
+    return pid;
+}
+
+static int spawn_child(void *arg) {
+    //runs in the child; with the vfork strategy the memory is shared with nanoinit, so only syscalls are allowed here
+    spawn_child_t *child = (spawn_child_t *)arg;
+    const spawn_request_t *request = child->request;
+
+    //join the app's cgroup before anything else, so everything from here on (execve included) is accounted there
+    if((request->cgroup_fd >= 0) && !child->in_cgroup) {
+        int procs_fd = openat(request->cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+        if((procs_fd < 0) || (write(procs_fd, "0", 1) != 1)) {
+            spawn_child_fail(child, SPAWN_STAGE_CGROUP);
+        }
+        close(procs_fd);
+    }
+
+    if(request->stdout_fd >= 0) {
+        if(dup2(request->stdout_fd, STDOUT_FILENO) < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_REDIRECT);
+        }
+    }
+
+    if(request->stderr_fd >= 0) {
+        if(dup2(request->stderr_fd, STDERR_FILENO) < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_REDIRECT);
+        }
+    }
+
+    //create new session
+    setsid();
+
+    //placement is inherited through execve, so the app starts on its cores and allocates from its nodes from the first instruction
+    const spawn_attr_t *attr = &request->plan->attr;
+    if(attr->has_cpus) {
+        if(sched_setaffinity(0, sizeof(attr->cpus), (const cpu_set_t *)attr->cpus) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_AFFINITY);
+        }
+    }
+
+    if(attr->has_numa_nodes) {
+        if(syscall(SYS_set_mempolicy, MPOL_BIND, attr->numa_nodes, (unsigned long)SPAWN_NUMA_NODES_MAX + 1) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_MEMPOLICY);
+        }
+    }
+
+    //nice first: the best-effort I/O level defaults to a value derived from it
+    if(attr->has_nice) {
+        if(setpriority(PRIO_PROCESS, 0, attr->nice) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_NICE);
+        }
+    }
+
+    if(attr->sched_policy != SPAWN_SCHED_UNSET) {
+        struct sched_param param = { .sched_priority = attr->sched_priority };
+        if(sched_setscheduler(0, spawn_sched_policy(attr->sched_policy), &param) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_SCHED);
+        }
+    }
+
+    if(attr->ioprio_class != SPAWN_IOPRIO_UNSET) {
+        int ioprio = ((int)attr->ioprio_class << SPAWN_IOPRIO_CLASS_SHIFT) | attr->ioprio_level;
+        if(syscall(SYS_ioprio_set, SPAWN_IOPRIO_WHO_PROCESS, 0, ioprio) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_IOPRIO);
+        }
+    }
+
+    //nothing of nanoinit's (log file, inherited descriptors) reaches the app; only stdio, the listen fds and the notify fd survive execve
+    //swept before the rlimits, while RLIMIT_NOFILE still covers every fd nanoinit may have open
+    if(request->listen_fd_count > 0) {
+        spawn_sweep_fds(spawn_place_fds(child));
+    }
+    else {
+        spawn_sweep_fds(STDERR_FILENO + 1);
+        if(request->notify_fd >= 0) {
+            fcntl(request->notify_fd, F_SETFD, 0);
+        }
+    }
+
+    for(int i = 0; i < attr->rlimit_count; i++) {
+        if(setrlimit(attr->rlimits[i].resource, &attr->rlimits[i].limit) != 0) {
+            spawn_child_fail(child, SPAWN_STAGE_RLIMIT);
+        }
+    }
+
+    //signals nanoinit receives through signalfd are blocked; the mask survives execve
+    sigprocmask(SIG_SETMASK, &child->sigmask, 0);
+
+    execve(request->plan->path, request->plan->argv, child->envp);
+
+    spawn_child_fail(child, SPAWN_STAGE_EXEC);
+    return 127;
+}
+
+static void spawn_child_fail(spawn_child_t *child, int stage) {
+    child->report.failed_stage = stage;
+    child->report.failed_errno = errno;
+
+    if(child->report_fd >= 0) {
+        ssize_t w = write(child->report_fd, &child->report, sizeof(child->report));
+        (void)w;
+    }
+
+    _exit(127);
+}
+
+static int spawn_place_fds(spawn_child_t *child) {
+    //returns the first fd past the placed ones; everything that must survive is first copied above the target range,
+    //so no dup2() below can clobber a descriptor that has not been placed yet
+    const spawn_request_t *request = child->request;
+    int count = request->listen_fd_count;
+    int first = STDERR_FILENO + 1;
+    int above = first + count + 1;
+
+    int moved[SPAWN_LISTEN_FDS_MAX];
+    for(int i = 0; i < count; i++) {
+        moved[i] = fcntl(request->listen_fds[i], F_DUPFD_CLOEXEC, above);
+        if(moved[i] < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_LISTEN_FDS);
+        }
+    }
+
+    int notify_fd = -1;
+    if(request->notify_fd >= 0) {
+        notify_fd = fcntl(request->notify_fd, F_DUPFD_CLOEXEC, above);
+        if(notify_fd < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_LISTEN_FDS);
+        }
+    }
+
+    if((child->report_fd >= 0) && (child->report_fd < above)) {
+        int report_fd = fcntl(child->report_fd, F_DUPFD_CLOEXEC, above);
+        if(report_fd < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_LISTEN_FDS);
+        }
+        child->report_fd = report_fd;
+    }
+
+    //dup2() clears close-on-exec on the targets, which is exactly what the app inherits
+    for(int i = 0; i < count; i++) {
+        if(dup2(moved[i], first + i) < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_LISTEN_FDS);
+        }
+    }
+
+    int next = first + count;
+    if(notify_fd >= 0) {
+        if(dup2(notify_fd, next) < 0) {
+            spawn_child_fail(child, SPAWN_STAGE_LISTEN_FDS);
+        }
+        next++;
+    }
+
+    spawn_format_pid(child->listen_pid, getpid());
+    return next;
+}
+
+static void spawn_format_pid(char *out, pid_t pid) {
+    //no snprintf() in the child; out has room for any pid
+    char digits[16];
+    int length = 0;
+    do {
+        digits[length++] = (char)('0' + (pid % 10));
+        pid /= 10;
+    } while(pid > 0);
+
+    for(int i = 0; i < length; i++) {
+        out[i] = digits[length - 1 - i];
+    }
+    out[length] = 0;
+}
+
+static void spawn_sweep_fds(int first) {
+    //marking close-on-exec instead of closing keeps the fork strategy's report pipe usable until execve
+    if(syscall(SYS_close_range, first, ~0U, CLOSE_RANGE_CLOEXEC) == 0) {
+        return;
+    }
+
+    struct rlimit limit;
+    int last = SPAWN_SWEEP_FALLBACK_MAX;
+    if((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur < (rlim_t)last)) {
+        last = (int)limit.rlim_cur;
+    }
+
+    for(int fd = first; fd < last; fd++) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+}
+
+static int spawn_sched_policy(spawn_sched_policy_t policy) {
+    switch(policy) {
+        case SPAWN_SCHED_BATCH:
+            return SCHED_BATCH;
+
+        case SPAWN_SCHED_IDLE:
+            return SCHED_IDLE;
+
+        case SPAWN_SCHED_FIFO:
+            return SCHED_FIFO;
+
+        case SPAWN_SCHED_RR:
+            return SCHED_RR;
+
+        default:
+            return SCHED_OTHER;
+    }
+}
+
+static const char *spawn_plan_redirect(const char *path) {
+    //unset keeps nanoinit's stream; empty string redirects to /dev/null
+    if(path && (path[0] == 0)) {
+        return "/dev/null";
+    }
+
+    return path;
+}
+
+static char *spawn_plan_copy_string(char **cursor, const char *value) {
+    char *result = *cursor;
+    size_t length = strlen(value) + 1;
+    memcpy(result, value, length);
+    *cursor += length;
+    return result;
+}
+
+static pid_t spawn_vfork(spawn_child_t *child) {
+    //CLONE_VFORK suspends nanoinit until the child calls execvee or _exit, so a single stack serves every spawn
+    char *stack_top = (char *)spawn_stack + SPAWN_STACK_SIZE;
+    return clone(spawn_child, stack_top, CLONE_VM | CLONE_VFORK | SIGCHLD, child);
+}
+
+static pid_t spawn_fork(spawn_child_t *child) {
+    //the child reports failures through a close-on-exec pipe; EOF without data means execve succeeded
+    int report[2];
+    if(pipe2(report, O_CLOEXEC) != 0) {
+        return -1;
+    }
+
+    //clone3() places the child in its cgroup atomically; older kernels fall back to fork() and the child joins it itself
+    pid_t pid = -1;
+    if(child->request->cgroup_fd >= 0) {
+        pid = spawn_clone3_into_cgroup(child->request->cgroup_fd);
+        if(pid == 0) {
+            child->in_cgroup = true;
+        }
+    }
+
+    if((pid < 0) && ((child->request->cgroup_fd < 0) || (errno == ENOSYS) || (errno == E2BIG) || (errno == EINVAL))) {
+        pid = fork();
+    }
+
+    if(pid == 0) {
+        close(report[0]);
+        child->report_fd = report[1];
+        spawn_child(child);
+        _exit(127);
+    }
+
+    int fork_errno = errno;
+    close(report[1]);
+    if(pid > 0) {
+        //blocks until the child execs or exits
+        ssize_t r;
+        do {
+            r = read(report[0], &child->report, sizeof(child->report));
+        } while((r < 0) && (errno == EINTR));
+        if(r != sizeof(child->report)) {
+            child->report.failed_stage = SPAWN_STAGE_NONE;
+        }
+    }
+    close(report[0]);
+
+    errno = fork_errno;
+
+    return pid;
+}
+
+static pid_t spawn_clone3_into_cgroup(int cgroup_fd) {
+    //kernel struct clone_args up to the cgroup field; linux/sched.h can't be included next to sched.h
+    struct {
+        uint64_t flags;
+        uint64_t pidfd;
+        uint64_t child_tid;
+        uint64_t parent_tid;
+        uint64_t exit_signal;
+        uint64_t stack;
+        uint64_t stack_size;
+        uint64_t tls;
+        uint64_t set_tid;
+        uint64_t set_tid_size;
+        uint64_t cgroup;
+    } args;
+
+    //no CLONE_VM and no stack: the child continues on a copy of this stack, exactly like fork()
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = (uint64_t)cgroup_fd;
+
+    return (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+}
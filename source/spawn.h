@@ -0,0 +1,115 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+typedef enum {
+    SPAWN_STRATEGY_VFORK = 0,   //clone(CLONE_VM | CLONE_VFORK) on a dedicated stack; no page table copy
+    SPAWN_STRATEGY_FORK = 1,    //plain fork(); used as fallback when clone() is not permitted
+} spawn_strategy_t;
+
+#define SPAWN_CPUS_MAX              1024    //same size as the kernel's default cpu_set_t
+#define SPAWN_NUMA_NODES_MAX        1024
+#define SPAWN_MASK_WORDS(bits)      ((bits) / (8 * sizeof(unsigned long)))
+#define SPAWN_RLIMITS_MAX           RLIM_NLIMITS
+#define SPAWN_LISTEN_FDS_MAX        64      //sockets passed with LISTEN_FDS, from fd 3 up
+
+typedef struct spawn_rlimit_s {
+    int resource;               //RLIMIT_*
+    struct rlimit limit;
+} spawn_rlimit_t;
+
+typedef enum {
+    SPAWN_SCHED_UNSET = 0,      //inherited from nanoinit
+    SPAWN_SCHED_OTHER,
+    SPAWN_SCHED_BATCH,
+    SPAWN_SCHED_IDLE,
+    SPAWN_SCHED_FIFO,
+    SPAWN_SCHED_RR,
+} spawn_sched_policy_t;
+
+typedef enum {
+    SPAWN_IOPRIO_UNSET = 0,     //values match the kernel's IOPRIO_CLASS_*
+    SPAWN_IOPRIO_REALTIME = 1,
+    SPAWN_IOPRIO_BEST_EFFORT = 2,
+    SPAWN_IOPRIO_IDLE = 3,
+} spawn_ioprio_class_t;
+
+//process attributes applied in the child right before execve; a zeroed struct changes nothing
+typedef struct spawn_attr_s {
+    bool has_cpus;
+    unsigned long cpus[SPAWN_MASK_WORDS(SPAWN_CPUS_MAX)];                //sched_setaffinity() mask, cpu_set_t layout
+    bool has_numa_nodes;
+    unsigned long numa_nodes[SPAWN_MASK_WORDS(SPAWN_NUMA_NODES_MAX)];    //set_mempolicy(MPOL_BIND) node mask
+
+    spawn_sched_policy_t sched_policy;
+    int sched_priority;         //1-99 for FIFO and RR, 0 otherwise
+    bool has_nice;
+    int nice;
+    spawn_ioprio_class_t ioprio_class;
+    int ioprio_level;           //0 (highest) to 7; ignored by the idle class
+
+    int rlimit_count;
+    spawn_rlimit_t rlimits[SPAWN_RLIMITS_MAX];
+} spawn_attr_t;
+
+//immutable, single-allocation description of how to start an app; built once when the config is loaded
+typedef struct spawn_plan_s {
+    const char *path;
+    char *const *argv;          //null-terminated, argv[0] included
+    char *const *envp;          //null-terminated
+    int env_count;
+
+    const char *stdout_path;    //resolved redirect target; 0 keeps nanoinit's stdout
+    const char *stderr_path;    //resolved redirect target; 0 keeps nanoinit's stderr
+
+    spawn_attr_t attr;
+} spawn_plan_t;
+
+typedef struct spawn_request_s {
+    const spawn_plan_t *plan;
+
+    int stdout_fd;              //-1 keeps nanoinit's stdout
+    int stderr_fd;              //-1 keeps nanoinit's stderr
+    int notify_fd;              //inherited by the child and announced in NANOINIT_NOTIFY_FD; -1 for none
+    int cgroup_fd;              //cgroup v2 directory the child starts in; -1 keeps nanoinit's cgroup
+
+    const int *listen_fds;      //placed at fd 3 and up and announced with LISTEN_FDS/LISTEN_PID; notify_fd then follows them
+    int listen_fd_count;
+    const char *listen_fdnames; //"LISTEN_FDNAMES=..." entry, or 0
+} spawn_request_t;
+
+int spawn_init(spawn_strategy_t strategy);
+void spawn_free(void);
+
+//builds a plan in one contiguous block (release with free()); stdout/stderr paths follow the config convention: 0 is unset, "" is /dev/null
+spawn_plan_t *spawn_plan_create(const char *path, char *const *args, int arg_count, char *const *envp, const char *stdout_path, const char *stderr_path, const spawn_attr_t *attr);
+
+//starts request->plan in a new session; the child runs no allocator and only issues syscalls before execve
+//returns the child pid, or -1 when the child could not be created or execve failed (the failed child is already reaped)
+pid_t spawn_process(const spawn_request_t *request);
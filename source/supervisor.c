@@ -22,305 +22,1804 @@
  * SOFTWARE.
  * */
 
+#define _GNU_SOURCE
+
 #include "supervisor.h"
+#include "eventloop.h"
+#include "pidmap.h"
+#include "cgroup.h"
+#include "activation.h"
+#include "capture.h"
+#include "metrics.h"
+#include "control.h"
+#include "ready.h"
+#include "health.h"
+#include "spawn.h"
 #include "log.h"
+#include "writer.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
 
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
+#include <poll.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open              434
+#endif
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal       424
+#endif
+
+#define SUPERVISOR_TIMER_RETRY_MS   100     //tick while a restart or kill timer could not be armed
+
+//resource usage of an app, summed over every process it ran as
+typedef struct supervisor_usage_s {
+    uint64_t user_us;                   //CPU time
+    uint64_t system_us;
+    long max_rss_kb;                    //peak of any single run
+    uint64_t major_faults;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    uint64_t uptime_ms;                 //of finished runs; the current run is added when reported
+    int spawns;
+    int exits;
+    int exits_failed;                   //non-zero exit status
+    int exits_signaled;
+    int exits_oom;
+    int last_status;                    //wait status of the last exit
+    bool last_oom;                      //last exit was an OOM kill
+    bool last_unhealthy;                //last exit followed failed health checks
+    uint64_t health_failures;           //failed health probes
+    metrics_histogram_t spawn_latency;  //spawn_process() duration
+} supervisor_usage_t;
+
+//previous process of an overlap restart; it keeps serving until its replacement is ready
+typedef struct supervisor_draining_s {
+    pid_t pid;                          //0 when there is none
+    int pidfd;
+    uint64_t start_time;
+    bool stop_sent;
+    eventloop_source_t pidfd_source;
+    eventloop_timer_t kill_timer;       //stop_timeout; escalates to SIGKILL
+    bool kill_lost;                     //kill_timer could not be armed; armed again by supervisor_timers_retry()
+} supervisor_draining_t;
 
 typedef struct supervisor_control_block_s {
-    nanoinit_application_config_t *application; //application data from config
+    const nanoinit_application_config_t *application; //application data from config
 
     pid_t pid;
+    int pidfd;                          //-1 when the kernel has no pidfd support; reaping then relies on SIGCHLD only
     int running;
+
+    bool started;                       //spawned at least once; apps wait here until all their dependencies are ready
+    bool ready;                         //dependents may start
+    bool stop_sent;                     //stop signal already forwarded during shutdown
+
+    uint64_t start_time;                //eventloop_now() at the last spawn
+    int failures;                       //consecutive quick failures; drives the backoff
+    uint64_t window_start;              //circuit breaker window
+    int window_restarts;
+    bool crashed;                       //circuit breaker tripped; no more restarts
+    bool held;                          //stopped through the control socket; not started again until asked to
+
+    bool reload_matched;                //still defined in the config being loaded
+    bool respawn_pending;               //definition changed or restart requested; spawned again once the old process exits
+    bool retired;                       //removed from config; freed once the old process exits
+    nanoinit_application_config_t retired_application;
+    struct supervisor_control_block_s *retired_next;    //scb_retired list
+
+    int cgroup_fd;                      //app's own cgroup while it has limits; -1 otherwise
+    uint64_t oom_kills;                 //memory.events oom_kill seen so far
+    int *listen_fds;                    //bound on first spawn and kept across restarts, so clients queue instead of being refused; 0 when closed
+    int listen_fd_count;
+    char *listen_fdnames;               //"LISTEN_FDNAMES=..." or 0
+    eventloop_source_t *socket_sources; //on_demand apps: listen_fds watched for connections; 0 when not watched
+    bool demanded;                      //on_demand apps: a connection or a start command arrived since the app last went idle
+    bool idle_stop;                     //stopped by idle_timer; waits for the next connection instead of restarting
+    bool unhealthy;                     //stopped after failing its health checks; the exit counts as a failure
+    uint64_t last_activity;             //eventloop_now() at the last connection
+    capture_t *capture;                 //redirect files and pipes of the captured streams; created on the first spawn and kept until the app is gone
+    supervisor_usage_t usage;           //kept across restarts and reloads
+
+    eventloop_source_t pidfd_source;
+    ready_check_t ready_check;
+    health_check_t health_check;
+    eventloop_timer_t restart_timer;
+    eventloop_timer_t kill_timer;       //stop_timeout; escalates to SIGKILL
+    eventloop_timer_t idle_timer;       //idle_timeout of on_demand apps
+    bool restart_lost;                  //restart_timer could not be armed; armed again by supervisor_timers_retry()
+    bool kill_lost;                     //same for kill_timer
+    supervisor_draining_t draining;
 } supervisor_control_block_t;
 
 
 static int supervisor_spawn(supervisor_control_block_t *scb);
+static void supervisor_cgroup_close(supervisor_control_block_t *scb);
+static int supervisor_sockets_open(supervisor_control_block_t *scb);
+static void supervisor_sockets_close(supervisor_control_block_t *scb);
+static void supervisor_sockets_watch(supervisor_control_block_t *scb, bool watch);
+static bool supervisor_sockets_pending(const supervisor_control_block_t *scb);
+static void supervisor_socket_cb(eventloop_source_t *source, uint32_t events);
+static void supervisor_idle_cb(eventloop_timer_t *timer);
+static void supervisor_demand_wait(supervisor_control_block_t *scb);
 static void supervisor_free_scb();
-static void supervisor_sigterm_cb(int signo);
-static void supervisor_sigusr1_cb(int signo);
+static supervisor_control_block_t *supervisor_scb_create(const nanoinit_application_config_t *application);
+static int supervisor_scb_compare(const void *a, const void *b);
+static int supervisor_scb_find(const void *name, const void *element);
+static void supervisor_reload(const nanoinit_arguments_t *arguments);
+static void supervisor_reload_app(supervisor_control_block_t *scb, bool overlap);
+static void supervisor_retire(supervisor_control_block_t *scb, nanoinit_application_config_t *app);
+static void supervisor_retired_free(supervisor_control_block_t *scb);
+static int supervisor_signalfd_init(void);
+static void supervisor_signalfd_free(void);
+static void supervisor_signalfd_cb(eventloop_source_t *source, uint32_t events);
+static void supervisor_pidfd_cb(eventloop_source_t *source, uint32_t events);
+static void supervisor_reap(void);
+static void supervisor_process_exited(supervisor_control_block_t *scb, int status, const struct rusage *rusage);
+static void supervisor_draining_exited(supervisor_control_block_t *scb, int status, const struct rusage *rusage);
+static void supervisor_account(supervisor_control_block_t *scb, pid_t pid, uint64_t start_time, int status, bool oom, const struct rusage *rusage);
+static const char *supervisor_exit_reason(const supervisor_usage_t *usage, char *buffer, size_t size);
+static void supervisor_report(void);
+static void supervisor_metrics(buffer_t *buffer);
+static void supervisor_control(int argc, char **argv, buffer_t *reply);
+static void supervisor_control_status(const supervisor_control_block_t *scb, buffer_t *reply);
+static int supervisor_send_signal(supervisor_control_block_t *scb, int signo);
+static int supervisor_signal_process(pid_t pid, int pidfd, int signo);
+static void supervisor_stop_app(supervisor_control_block_t *scb, int signo);
+static void supervisor_kill_cb(eventloop_timer_t *timer);
+static void supervisor_pidfd_close(supervisor_control_block_t *scb);
+static int supervisor_overlap(supervisor_control_block_t *scb);
+static void supervisor_overlap_revert(supervisor_control_block_t *scb);
+static void supervisor_draining_stop(supervisor_control_block_t *scb, int signo);
+static void supervisor_draining_kill_cb(eventloop_timer_t *timer);
+static supervisor_control_block_t *supervisor_scb_at(int index);
+static void supervisor_try_start(supervisor_control_block_t *scb);
+static void supervisor_set_ready(supervisor_control_block_t *scb);
+static void supervisor_ready_cb(ready_check_t *check, bool ready);
+static void supervisor_health_cb(health_check_t *check, bool healthy);
+static void supervisor_stop_all(int signo);
+static void supervisor_try_stop(supervisor_control_block_t *scb);
+static void supervisor_schedule_restart(supervisor_control_block_t *scb, bool failed);
+static void supervisor_restart_cb(eventloop_timer_t *timer);
+static void supervisor_log_timer_cb(eventloop_timer_t *timer);
+static bool supervisor_rate_acquire(uint64_t *wait_ms);
+static void supervisor_timer_start(supervisor_control_block_t *scb, eventloop_timer_t *timer, bool *lost, uint64_t delay_ms);
+static void supervisor_timers_retry(void);
+static void supervisor_timers_retry_scb(supervisor_control_block_t *scb);
 
-static volatile sig_atomic_t supervisor_got_signal_stop = 0;
-static volatile sig_atomic_t supervisor_got_signal_reload = 0;
+static int supervisor_got_signal_stop = 0;
+static int supervisor_got_signal_reload = 0;
+static int supervisor_got_signal_report = 0;
+static int supervisor_stopping = 0;
+static int supervisor_stop_signal = 0;
+static int supervisor_restart_rate = 0;         //global restarts per second; 0 is unlimited
+static bool supervisor_timers_lost = false;     //some restart or kill timer could not be armed
+static uint64_t supervisor_rate_tokens = 0;     //token bucket, in thousandths of a restart
+static uint64_t supervisor_rate_updated = 0;
 bool manual_mode = false;
-static supervisor_control_block_t *scb = 0;
+static nanoinit_config_t *supervisor_config = 0;
+static supervisor_control_block_t **scb = 0;     //one per app in supervisor_config, at the same index
 static int scb_count = 0;
+static int scb_running_count = 0;       //number of app processes alive, draining ones included
+static pidmap_t scb_pidmap = {0};       //pid -> scb of every app process, draining ones included
+static supervisor_control_block_t *scb_retired = 0;     //removed from config but still running; not in scb
+
+static sigset_t supervisor_sigmask;
+static eventloop_source_t signalfd_source = { .fd = -1 };
+static eventloop_timer_t supervisor_log_timer;
+
+
+int supervisor_start(const nanoinit_arguments_t *arguments, nanoinit_config_t *config) {
+    //signals are received through a signalfd in the event loop instead of async handlers
+    if(eventloop_init() != 0) {
+        log_ni_error("supervisor_start() could not initialize event loop");
+        return -1;
+    }
+
+    if(supervisor_signalfd_init() != 0) {
+        log_ni_error("supervisor_start() could not initialize signalfd");
+        eventloop_free();
+        return -1;
+    }
+
+    spawn_init(arguments->spawn_strategy);
+    eventloop_timer_init(&supervisor_log_timer, supervisor_log_timer_cb, 0);
+
+    //a metrics endpoint that can't be set up is not a reason to leave the apps unsupervised
+    if(arguments->metrics && (metrics_init(arguments->metrics, supervisor_metrics) != 0)) {
+        log_ni_error("supervisor_start() could not serve metrics on %s; continuing without", arguments->metrics);
+    }
+
+    //same for the control socket; SIGUSR1 still reloads without it
+    if(arguments->control_socket[0] && (control_init(arguments->control_socket, supervisor_control) != 0)) {
+        log_ni_error("supervisor_start() could not open control socket %s; continuing without", arguments->control_socket);
+    }
+    srandom((unsigned int)(getpid() ^ eventloop_now()));
 
+    supervisor_restart_rate = arguments->restart_rate;
+    supervisor_rate_tokens = (uint64_t)supervisor_restart_rate * 1000;
+    supervisor_rate_updated = eventloop_now();
 
-int supervisor_start(const nanoinit_arguments_t *arguments, const nanoinit_config_t *config) {
-supervisor_start_begin:
     //initialize everything
     supervisor_got_signal_stop = 0;
     supervisor_got_signal_reload = 0;
+    supervisor_got_signal_report = 0;
+    supervisor_stopping = 0;
 
     manual_mode = arguments->manual_mode;
 
-    scb_count = config->application_count;
-    scb = (supervisor_control_block_t *)malloc(sizeof(supervisor_control_block_t) * scb_count);
-    if(scb == 0) {
+    supervisor_config = config;
+    scb_count = config ? config->application_count : 0;
+    scb_running_count = 0;
+    scb = (supervisor_control_block_t **)calloc(scb_count + 1, sizeof(supervisor_control_block_t *));
+    if((scb == 0) || (pidmap_init(&scb_pidmap, scb_count) != 0)) {
         log_ni_error("supervisor_start() could not allocate memory for scb");
+        supervisor_free_scb();
+        spawn_free();
+        supervisor_signalfd_free();
+        eventloop_free();
         return -1;
     }
 
-    //initialize scb
+    //nanoinit leaves its cgroup before the first app is spawned; when a reload brings in the first app with limits, the apps
+    //already running are moved out with it
     for(int i = 0; i < scb_count; i++) {
-        scb[i].pid = 0;
-        scb[i].running = 0;
+        if(cgroup_limits_set(&config->applications[i].cgroup)) {
+            cgroup_init();
+            break;
+        }
     }
 
-    //register signals to nanoinit
-    signal(SIGTERM, supervisor_sigterm_cb);
-    signal(SIGINT, supervisor_sigterm_cb);
-    signal(SIGQUIT, supervisor_sigterm_cb);
-    signal(SIGUSR1, supervisor_sigusr1_cb);
-
-    //spawn processes
     for(int i = 0; i < scb_count; i++) {
-        if(supervisor_spawn(&scb[i]) == 0) {
-            log("supervisor_start() successfully spawned '%s' with pid %lu", scb[i].application->name, scb[i].pid);
-        }
-        else {
-            log_app_error("supervisor_start() failed to spawn '%s'", scb[i].application->name);
+        scb[i] = supervisor_scb_create(&config->applications[i]);
+        if(scb[i] == 0) {
+            log_ni_error("supervisor_start() could not allocate memory for scb");
+            supervisor_free_scb();
+            spawn_free();
+            supervisor_signalfd_free();
+            eventloop_free();
+            return -1;
         }
     }
 
-    //supervise processes and received signals; this loop is finished when supervisor_got_signal_stop will get set by signal
+    //spawn every app without pending dependencies at once; the others are spawned as soon as their dependencies become ready
+    for(int i = 0; i < scb_count; i++) {
+        supervisor_try_start(scb[i]);
+    }
+
+    //supervise processes and received signals; the loop sleeps in epoll until a signal arrives or a pidfd becomes readable
+    //once a stop signal is received it is forwarded to all processes and the loop keeps reaping until everything has exited
     int running = 1;
     while(running) {
-        int defunct_status;
-        pid_t defunct_pid = waitpid(-1, &defunct_status, WNOHANG);
-        if(defunct_pid > 0) {
-            for(int i = 0; i < scb_count; i++) {
-                if(scb[i].pid == defunct_pid) {
-                    if(defunct_status == 0) {
-                        //clean exit
-                        log("supervisor_start() process %s (pid=%lu) finished with status %d", scb[i].application->name, defunct_pid, defunct_status);
-                    }
-                    else {
-                        log_app_error("supervisor_start() process %s (pid=%lu) exited with status %d", scb[i].application->name, defunct_pid, defunct_status);
-                    }
-
-                    scb[i].running = 0;
-                    if(scb[i].application->autorestart) {
-                        if(supervisor_spawn(&scb[i]) == 0) {
-                            log("supervisor_start() respawned %s (pid=%lu)\n", scb[i].application->name, scb[i].pid);
-                        }
-                        else {
-                            log_app_error("supervisor_start() failed to spawn '%s'", scb[i].application->name);
-                        }
-                    }
-
-                    break;
-                }
-            }
+        //timers that could not be armed are retried on the next tick instead of being dropped
+        if(eventloop_run_once(supervisor_timers_lost ? SUPERVISOR_TIMER_RETRY_MS : -1) < 0) {
+            log_ni_error("supervisor_start() event loop failed; stopping");
+            supervisor_got_signal_stop = SIGTERM;
         }
 
         if(supervisor_got_signal_stop) {    //if got the terminate
+            int signo = supervisor_got_signal_stop;
             supervisor_got_signal_stop = 0;
 
-            //forward the signal to all processes
-            for(int i = 0; i < scb_count; i++) {
-                if(scb[i].running) {
-                    log("supervisor_start() sending %d to %s (pid=%lu)...", supervisor_got_signal_stop, scb[i].application->name, scb[i].pid);
-                    kill(scb[i].pid, supervisor_got_signal_stop);
-                }
+            //forward the signal in reverse dependency order
+            supervisor_stop_all(signo);
+        }
+
+        if(supervisor_got_signal_reload) {
+            supervisor_got_signal_reload = 0;
+            if(!supervisor_stopping) {
+                supervisor_reload(arguments);
             }
-            
+        }
+
+        if(supervisor_got_signal_report) {
+            supervisor_got_signal_report = 0;
+            supervisor_report();
+        }
+
+        if(supervisor_timers_lost) {
+            supervisor_timers_retry();
+        }
+
+        if(supervisor_stopping && (scb_running_count == 0)) {
             running = 0;
         }
 
-        //checkAL poate exista un mecanism la waitpid sa nu mai facem sleep deloc, fara WNOHANG
-        sleep(1);
+        //records logged in this iteration go out together; with a timed flush policy the timer wakes the loop once they are due
+        int log_due = log_tick();
+        if((log_due > 0) && !eventloop_timer_armed(&supervisor_log_timer)) {
+            eventloop_timer_start(&supervisor_log_timer, (uint64_t)log_due);
+        }
     }
 
-    //wait for processes to terminate after SIGTERM was forwarded
-    running = (scb_count != 0);
-    while(running) {
-        int defunct_status;
-        pid_t defunct_pid = wait(&defunct_status);
-        if(defunct_pid > 0) {
-            char *name = 0;
-            for(int i = 0; i < scb_count; i++) {
-                if(scb[i].pid == defunct_pid) {
-                    scb[i].running = 0;
-                    name = scb[i].application->name;
-                    break;
+    //cleanup
+    eventloop_timer_stop(&supervisor_log_timer);
+    control_free();
+    metrics_free();
+    supervisor_free_scb();
+    cgroup_free();
+    spawn_free();
+    supervisor_signalfd_free();
+    eventloop_free();
+
+    return 0;
+}
+
+static void supervisor_reload(const nanoinit_arguments_t *arguments) {
+    log("supervisor_reload() SIGUSR1 received, reloading configuration");
+
+    //the new config is parsed and validated on its own; the running one stays in place if it is not usable
+    nanoinit_config_t *config = config_init(arguments->config_file, arguments->config_json_object);
+    if(config == 0) {
+        log_ni_error("supervisor_reload() could not read new config; keeping the current one");
+        return;
+    }
+
+    supervisor_control_block_t **new_scb = (supervisor_control_block_t **)calloc(config->application_count + 1, sizeof(supervisor_control_block_t *));
+    supervisor_control_block_t **by_name = (supervisor_control_block_t **)malloc(sizeof(supervisor_control_block_t *) * (scb_count + 1));
+    if((new_scb == 0) || (by_name == 0)) {
+        log_ni_error("supervisor_reload() bad memory allocation; keeping the current config");
+        free(new_scb);
+        free(by_name);
+        config_free(config);
+        return;
+    }
+
+    //running apps are looked up by name, so the diff stays O(n log n)
+    memcpy(by_name, scb, sizeof(supervisor_control_block_t *) * scb_count);
+    qsort(by_name, scb_count, sizeof(supervisor_control_block_t *), supervisor_scb_compare);
+    for(int i = 0; i < scb_count; i++) {
+        scb[i]->reload_matched = false;
+    }
+
+    int added = 0;
+    int changed = 0;
+    int removed = 0;
+    for(int i = 0; i < config->application_count; i++) {
+        nanoinit_application_config_t *app = &config->applications[i];
+        supervisor_control_block_t **found = (supervisor_control_block_t **)bsearch(app->name, by_name, scb_count, sizeof(supervisor_control_block_t *), supervisor_scb_find);
+        if(found == 0) {
+            new_scb[i] = supervisor_scb_create(app);
+            if(new_scb[i] == 0) {
+                log_ni_error("supervisor_reload() bad memory allocation; keeping the current config");
+                for(int j = 0; j < i; j++) {
+                    if(!new_scb[j]->reload_matched) {
+                        free(new_scb[j]);
+                    }
                 }
+                free(new_scb);
+                free(by_name);
+                config_free(config);
+                return;
             }
-            log("supervisor_start() process %s (pid=%d) finished with status %d", name, defunct_pid, defunct_status);
+            added++;
+            continue;
         }
-        else {
-            log_ni_error("supervisor_start() waitpid() returned invalid value");
+
+        new_scb[i] = *found;
+        new_scb[i]->reload_matched = true;
+    }
+
+    //from here on nothing can fail; move the surviving apps over to their new definitions
+    for(int i = 0; i < config->application_count; i++) {
+        supervisor_control_block_t *current = new_scb[i];
+        if(!current->reload_matched) {
+            continue;
         }
 
-        running = 0;
-        for(int i = 0; i < scb_count; i++) {
-            if(scb[i].running == 1) {
-                running = 1;
-                break;
-            }
+        const nanoinit_application_config_t *previous = current->application;
+        nanoinit_application_config_t *app = &config->applications[i];
+        bool equal = config_app_equal(previous, app);
+        if(!config_sockets_equal(previous, app)) {
+            //the running process keeps its own copies; the new ones are bound on the next spawn
+            supervisor_sockets_close(current);
+        }
+        else if(!app->on_demand) {
+            supervisor_sockets_watch(current, false);
+        }
+        current->application = app;
+        current->ready_check.config = &app->ready;
+        current->health_check.config = &app->health;
+        if(current->capture) {
+            capture_configure(current->capture, app);
         }
-    }
 
-    //cleanup
-    supervisor_free_scb();
-    
-    //check whether a nanoinit-reload (SIGUSR1) was received and restart everytthing
-    if(supervisor_got_signal_reload) {
-        supervisor_got_signal_reload = 0;
+        //an app the circuit breaker gave up on is given another chance
+        //overlapping needs the old process' sockets and cgroup to stay usable by the new one
+        if(!equal || current->crashed) {
+            supervisor_reload_app(current, config_sockets_equal(previous, app) && config_cgroup_equal(previous, app));
+            changed++;
+        }
+    }
 
-        config_free();
-        const nanoinit_config_t *result = config_init(arguments->config_file, arguments->config_json_object);
-        if(result == 0) {
-            log_ni_error("supervisor_start() could not read new config; using zero-config");
+    //apps that are gone keep their definition until their process exits
+    for(int i = 0; i < scb_count; i++) {
+        if(!scb[i]->reload_matched) {
+            //scb[i] belongs to the app at the same index of the config being replaced
+            supervisor_retire(scb[i], &supervisor_config->applications[i]);
+            removed++;
         }
+    }
+
+    free(by_name);
+    free(scb);
+    config_free(supervisor_config);
+
+    supervisor_config = config;
+    scb = new_scb;
+    scb_count = config->application_count;
 
-        log("supervisor_start() SIGUSR1 received, reloading and restarting everything according to new configuration");
-        goto supervisor_start_begin;
+    log("supervisor_reload() %d apps added, %d changed, %d removed, %d unchanged", added, changed, removed, scb_count - added - changed);
+
+    for(int i = 0; i < scb_count; i++) {
+        supervisor_try_start(scb[i]);
     }
+}
 
+static void supervisor_reload_app(supervisor_control_block_t *scb, bool overlap) {
+    //start over with the new definition; dependents started from now on wait for the new instance
+    eventloop_timer_stop(&scb->restart_timer);
+    scb->restart_lost = false;
+    ready_cancel(&scb->ready_check);
+    ready_init(&scb->ready_check, &scb->application->ready, supervisor_ready_cb, scb);
+    health_cancel(&scb->health_check);
+    health_init(&scb->health_check, &scb->application->health, supervisor_health_cb, scb);
+    scb->ready = false;
+    scb->failures = 0;
+    scb->window_restarts = 0;
+    scb->crashed = false;
+    scb->demanded = false;
+    scb->idle_stop = false;
+    eventloop_timer_stop(&scb->idle_timer);
 
-    return 0;
+    if(scb->running && overlap && (supervisor_overlap(scb) == 0)) {
+        return;
+    }
+
+    if(scb->running) {
+        //spawned again from supervisor_process_exited(), where the cgroup is set up again as well
+        log("supervisor_reload() stopping %s (pid=%d) to apply its new definition", scb->application->name, scb->pid);
+        scb->respawn_pending = true;
+        if(!scb->stop_sent) {
+            supervisor_stop_app(scb, SIGTERM);
+        }
+    }
+    else {
+        supervisor_cgroup_close(scb);
+        scb->started = false;
+    }
 }
 
-static void supervisor_sigterm_cb(int signo) {
-    supervisor_got_signal_stop = signo;
+static void supervisor_retire(supervisor_control_block_t *scb, nanoinit_application_config_t *app) {
+    eventloop_timer_stop(&scb->restart_timer);
+    scb->restart_lost = false;
+    eventloop_timer_stop(&scb->idle_timer);
+    ready_cancel(&scb->ready_check);
+    health_cancel(&scb->health_check);
+    supervisor_sockets_watch(scb, false);
+
+    if(!scb->running && (scb->draining.pid == 0)) {
+        eventloop_timer_stop(&scb->kill_timer);
+        supervisor_cgroup_close(scb);
+        supervisor_sockets_close(scb);
+        capture_free(scb->capture);
+        free(scb);
+        return;
+    }
+
+    //the scb outlives the config it came from, so it takes the app definition over
+    config_app_detach(app, &scb->retired_application);
+    scb->application = &scb->retired_application;
+    if(scb->capture) {
+        //same definition at a new address; output keeps flowing until the last process is gone
+        capture_configure(scb->capture, &scb->retired_application);
+    }
+    scb->retired = true;
+    scb->respawn_pending = false;
+    scb->retired_next = scb_retired;
+    scb_retired = scb;
+
+    if(!scb->running) {
+        supervisor_draining_stop(scb, SIGTERM);
+        return;
+    }
+
+    log("supervisor_reload() stopping %s (pid=%d) as it was removed from config", scb->application->name, scb->pid);
+    if(!scb->stop_sent) {
+        supervisor_stop_app(scb, SIGTERM);
+    }
 }
 
-static void supervisor_sigusr1_cb(int signo) {
-    (void)signo;    //always SIGUSR1
+static void supervisor_retired_free(supervisor_control_block_t *scb) {
+    //once none of its processes is left, or at exit
+    supervisor_control_block_t **link = &scb_retired;
+    while(*link != scb) {
+        link = &(*link)->retired_next;
+    }
+    *link = scb->retired_next;
 
-    supervisor_got_signal_stop = SIGTERM;
-    supervisor_got_signal_reload = 1;
+    eventloop_timer_stop(&scb->kill_timer);
+    eventloop_timer_stop(&scb->draining.kill_timer);
+    supervisor_cgroup_close(scb);
+    supervisor_sockets_close(scb);
+    capture_free(scb->capture);
+    config_app_free(&scb->retired_application);
+    free(scb);
 }
 
+static int supervisor_scb_compare(const void *a, const void *b) {
+    const supervisor_control_block_t *scb_a = *(supervisor_control_block_t * const *)a;
+    const supervisor_control_block_t *scb_b = *(supervisor_control_block_t * const *)b;
+    return strcmp(scb_a->application->name, scb_b->application->name);
+}
 
-static int supervisor_spawn(supervisor_control_block_t *scb) {
-    if(manual_mode && scb->application->manual) {
-        log("supervisor_spawn() process %s not spawned because is marked as manual", scb->application->name);
+static int supervisor_scb_find(const void *name, const void *element) {
+    const supervisor_control_block_t *scb = *(supervisor_control_block_t * const *)element;
+    return strcmp((const char *)name, scb->application->name);
+}
+
+static supervisor_control_block_t *supervisor_scb_create(const nanoinit_application_config_t *application) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)calloc(1, sizeof(supervisor_control_block_t));
+    if(scb == 0) {
         return 0;
     }
 
-    scb->running = 1;
-    scb->pid = fork();
-    if(scb->pid == -1) {
-        log_ni_error("supervisor_spawn() fork failed");
-        scb->running = 0;
+    scb->application = application;
+    scb->pid = 0;
+    scb->pidfd = -1;
+    scb->running = 0;
+    scb->cgroup_fd = -1;
+    eventloop_timer_init(&scb->restart_timer, supervisor_restart_cb, scb);
+    eventloop_timer_init(&scb->kill_timer, supervisor_kill_cb, scb);
+    eventloop_timer_init(&scb->idle_timer, supervisor_idle_cb, scb);
+    eventloop_timer_init(&scb->draining.kill_timer, supervisor_draining_kill_cb, scb);
+    scb->draining.pidfd = -1;
+    scb->draining.pidfd_source.fd = -1;
+    scb->draining.pidfd_source.callback = supervisor_pidfd_cb;
+    scb->draining.pidfd_source.data = scb;
+    scb->pidfd_source.fd = -1;
+    scb->pidfd_source.callback = supervisor_pidfd_cb;
+    scb->pidfd_source.data = scb;
+    ready_init(&scb->ready_check, &application->ready, supervisor_ready_cb, scb);
+    health_init(&scb->health_check, &application->health, supervisor_health_cb, scb);
+
+    return scb;
+}
+
+static int supervisor_signalfd_init(void) {
+    sigemptyset(&supervisor_sigmask);
+    sigaddset(&supervisor_sigmask, SIGTERM);
+    sigaddset(&supervisor_sigmask, SIGINT);
+    sigaddset(&supervisor_sigmask, SIGQUIT);
+    sigaddset(&supervisor_sigmask, SIGUSR1);
+    sigaddset(&supervisor_sigmask, SIGUSR2);
+    sigaddset(&supervisor_sigmask, SIGCHLD);
+
+    //an inherited SIG_IGN would discard the signal before it reaches the signalfd
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGUSR1, SIG_DFL);
+    signal(SIGUSR2, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+
+    //signals must be blocked to be delivered through the signalfd; being blocked, they are also delivered when running as PID 1
+    if(sigprocmask(SIG_BLOCK, &supervisor_sigmask, 0) != 0) {
+        log_ni_error("supervisor_signalfd_init() sigprocmask() failed with errno %d", errno);
         return -1;
     }
 
-    if(scb->pid == 0) {
-        //child process
-        
-        //unregister signals from parent
-        signal(SIGINT, 0);
-        signal(SIGTERM, 0);
-        signal(SIGQUIT, 0);
-        signal(SIGUSR1, 0);
+    signalfd_source.fd = signalfd(-1, &supervisor_sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(signalfd_source.fd < 0) {
+        log_ni_error("supervisor_signalfd_init() signalfd() failed with errno %d", errno);
+        sigprocmask(SIG_UNBLOCK, &supervisor_sigmask, 0);
+        return -1;
+    }
 
-        //redirect stdout ?
-        char *stdout_path = scb->application->stdout_path ? strdup(scb->application->stdout_path) : 0;
-        if(stdout_path && stdout_path[0] == 0) {
-            free(stdout_path);
-            stdout_path = strdup("/dev/null");
-        }
+    signalfd_source.callback = supervisor_signalfd_cb;
+    signalfd_source.data = 0;
+    if(eventloop_add(&signalfd_source, EPOLLIN) != 0) {
+        supervisor_signalfd_free();
+        return -1;
+    }
 
-        if(stdout_path) {
-            int stdout_fd = open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-            if(stdout_fd < 0) {
-                log_ni_error("supervisor_spawn() could not open %s for redirecting stdout for app %s", stdout_path, scb->application->name);
-            }
-            else {
-                dup2(stdout_fd, STDOUT_FILENO);
-            }
-            free(stdout_path);
+    return 0;
+}
+
+static void supervisor_signalfd_free(void) {
+    if(signalfd_source.fd >= 0) {
+        close(signalfd_source.fd);
+        signalfd_source.fd = -1;
+    }
+
+    sigprocmask(SIG_UNBLOCK, &supervisor_sigmask, 0);
+}
+
+static void supervisor_signalfd_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    struct signalfd_siginfo info;
+    bool got_sigchld = false;
+    while(read(source->fd, &info, sizeof(info)) == sizeof(info)) {
+        switch(info.ssi_signo) {
+            case SIGCHLD:
+                got_sigchld = true;
+                break;
+
+            case SIGUSR1:
+                supervisor_got_signal_reload = 1;
+                break;
+
+            case SIGUSR2:
+                supervisor_got_signal_report = 1;
+                break;
+
+            default:
+                supervisor_got_signal_stop = info.ssi_signo;
+                break;
         }
+    }
 
-        //redirect stderr ?
-        char *stderr_path = scb->application->stderr_path ? strdup(scb->application->stderr_path) : 0;
-        if(stderr_path && stderr_path[0] == 0) {
-            free(stderr_path);
-            stderr_path = strdup("/dev/null");
+    //standard signals coalesce, so one SIGCHLD may stand for any number of exited children
+    if(got_sigchld) {
+        supervisor_reap();
+    }
+}
+
+static void supervisor_pidfd_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+
+    //pidfd_source and draining.pidfd_source both land here; one reap covers every exited child
+    (void)source;
+    supervisor_reap();
+}
+
+static void supervisor_reap(void) {
+    //reap every exited child at once, including orphans re-parented to nanoinit when running as PID 1
+    //wait4() hands over the resource usage of the child and of the descendants it reaped, at no extra cost
+    int defunct_status;
+    struct rusage defunct_rusage;
+    pid_t defunct_pid;
+    while((defunct_pid = wait4(-1, &defunct_status, WNOHANG, &defunct_rusage)) > 0) {
+        supervisor_control_block_t *defunct_scb = (supervisor_control_block_t *)pidmap_find(&scb_pidmap, defunct_pid);
+        if(defunct_scb && (defunct_scb->draining.pid == defunct_pid)) {
+            supervisor_draining_exited(defunct_scb, defunct_status, &defunct_rusage);
         }
+        else if(defunct_scb) {
+            supervisor_process_exited(defunct_scb, defunct_status, &defunct_rusage);
+        }
+    }
+}
 
-        if(stderr_path) {
-            int stderr_fd = open(stderr_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-            if(stderr_fd < 0) {
-                log_ni_error("supervisor_spawn() could not open %s for redirecting stderr for app %s", stderr_path, scb->application->name);
-            }
-            else {
-                dup2(stderr_fd, STDERR_FILENO);
-            }
-            free(stderr_path);
+static void supervisor_process_exited(supervisor_control_block_t *scb, int status, const struct rusage *rusage) {
+    uint64_t oom_kills = cgroup_oom_kills(scb->cgroup_fd);
+    bool oom = (oom_kills > scb->oom_kills);
+    capture_flush(scb->capture);
+    supervisor_account(scb, scb->pid, scb->start_time, status, oom, rusage);
+    bool unhealthy = scb->unhealthy;
+    scb->unhealthy = false;
+    scb->usage.last_unhealthy = unhealthy;
+    if(oom) {
+        scb->oom_kills = oom_kills;
+        log_app_error("supervisor_start() process %s (pid=%d) exited with status %d; killed by the OOM killer (memory_max %s)", scb->application->name, scb->pid, status, scb->application->cgroup.memory_max ? scb->application->cgroup.memory_max : "max");
+    }
+    else if(status == 0) {
+        //clean exit
+        log("supervisor_start() process %s (pid=%d) finished with status %d", scb->application->name, scb->pid, status);
+    }
+    else {
+        log_app_error("supervisor_start() process %s (pid=%d) exited with status %d", scb->application->name, scb->pid, status);
+    }
+
+    supervisor_pidfd_close(scb);
+    ready_cancel(&scb->ready_check);
+    health_cancel(&scb->health_check);
+    eventloop_timer_stop(&scb->kill_timer);
+    scb->kill_lost = false;
+    eventloop_timer_stop(&scb->idle_timer);
+    pidmap_remove(&scb_pidmap, scb->pid);
+    scb->running = 0;
+    scb->stop_sent = false;
+    scb_running_count--;
+
+    if(scb->retired) {
+        if(scb->draining.pid == 0) {
+            supervisor_retired_free(scb);
         }
+        return;
+    }
 
-        //copy path and arguments as they will be freed
-        char *app_path = strdup(scb->application->path);
-        if(app_path == 0) {
-            log_ni_error("supervisor_spawn() could not allocate memory for application path");
-            exit(1);
+    if(supervisor_stopping) {
+        //dependencies are stopped once their last running dependent is gone
+        for(int i = 0; i < scb->application->dependency_count; i++) {
+            supervisor_try_stop(supervisor_scb_at(scb->application->dependencies[i]));
         }
+        return;
+    }
+
+    //the replacement of an overlap restart died before becoming ready; the previous process never stopped serving
+    if((scb->draining.pid != 0) && !scb->draining.stop_sent) {
+        log_app_error("supervisor_start() replacement of %s exited before becoming ready; keeping pid %d", scb->application->name, scb->draining.pid);
+        supervisor_overlap_revert(scb);
+        return;
+    }
 
-        int arg_count = scb->application->arg_count + 2;
-        char **app_args = (char **)malloc(sizeof(char*) * arg_count);
-        if(app_args == 0) {
-            log_ni_error("supervisor_spawn() could not allocate memory for application arguments vector");
-            exit(1);
+    if(scb->held) {
+        //a reload may have changed the definition in the meantime
+        if(scb->respawn_pending) {
+            supervisor_cgroup_close(scb);
+            scb->respawn_pending = false;
         }
-        app_args[0] = strdup(app_path);
-        if(app_args[0] == 0) {
-            log_ni_error("supervisor_spawn() could not allocate memory for application first argument (path)");
-            exit(1);
+        scb->started = false;
+        scb->ready = false;     //dependents started from now on wait for it
+        return;
+    }
+
+    if(scb->respawn_pending) {
+        supervisor_cgroup_close(scb);
+        scb->respawn_pending = false;
+        scb->started = false;
+        supervisor_try_start(scb);
+        return;
+    }
+
+    if(scb->idle_stop) {
+        scb->idle_stop = false;
+        supervisor_demand_wait(scb);
+        return;
+    }
+
+    //an app that finished cleanly before becoming ready (e.g. "ready": "exit") satisfies its dependents
+    if((status == 0) && !scb->ready) {
+        supervisor_set_ready(scb);
+    }
+
+    //an app stopped for failing its health checks is restarted like a crashed one, even if it exited cleanly on the stop signal
+    bool failed = !WIFEXITED(status) || (WEXITSTATUS(status) != 0) || unhealthy;
+    supervisor_schedule_restart(scb, failed);
+
+    //an on_demand app its restart policy doesn't bring back is started again by the next connection
+    if(scb->application->on_demand && !scb->crashed && !eventloop_timer_armed(&scb->restart_timer)) {
+        supervisor_demand_wait(scb);
+    }
+}
+
+static void supervisor_draining_exited(supervisor_control_block_t *scb, int status, const struct rusage *rusage) {
+    supervisor_draining_t *draining = &scb->draining;
+    supervisor_account(scb, draining->pid, draining->start_time, status, false, rusage);
+    log("supervisor_start() previous process of %s (pid=%d) exited with status %d", scb->application->name, draining->pid, status);
+
+    if(draining->pidfd >= 0) {
+        eventloop_remove(&draining->pidfd_source);
+        close(draining->pidfd);
+        draining->pidfd = -1;
+        draining->pidfd_source.fd = -1;
+    }
+    eventloop_timer_stop(&draining->kill_timer);
+    draining->kill_lost = false;
+    pidmap_remove(&scb_pidmap, draining->pid);
+    draining->pid = 0;
+    scb_running_count--;
+
+    if(scb->retired) {
+        if(!scb->running) {
+            supervisor_retired_free(scb);
         }
-        app_args[arg_count - 1] = 0;
+        return;
+    }
 
-        for(int i = 0; i < scb->application->arg_count; i++) {
-            app_args[i + 1] = strdup(scb->application->args[i]);
-            if(app_args[i + 1] == 0) {
-                log_ni_error("supervisor_spawn() could not allocate memory for application argument %d", i);
-                exit(1);
-            }
+    if(supervisor_stopping) {
+        for(int i = 0; i < scb->application->dependency_count; i++) {
+            supervisor_try_stop(supervisor_scb_at(scb->application->dependencies[i]));
         }
+    }
+}
 
-        //free parent inherited memory
-        supervisor_free_scb();
-        config_free();
-        arguments_free();
-        log_free();
+static void supervisor_account(supervisor_control_block_t *scb, pid_t pid, uint64_t start_time, int status, bool oom, const struct rusage *rusage) {
+    supervisor_usage_t *usage = &scb->usage;
+    uint64_t user_us = (uint64_t)rusage->ru_utime.tv_sec * 1000000 + (uint64_t)rusage->ru_utime.tv_usec;
+    uint64_t system_us = (uint64_t)rusage->ru_stime.tv_sec * 1000000 + (uint64_t)rusage->ru_stime.tv_usec;
+    uint64_t uptime_ms = eventloop_now() - start_time;
+
+    usage->user_us += user_us;
+    usage->system_us += system_us;
+    if(rusage->ru_maxrss > usage->max_rss_kb) {
+        usage->max_rss_kb = rusage->ru_maxrss;
+    }
+    usage->major_faults += (uint64_t)rusage->ru_majflt;
+    usage->voluntary_switches += (uint64_t)rusage->ru_nvcsw;
+    usage->involuntary_switches += (uint64_t)rusage->ru_nivcsw;
+    usage->uptime_ms += uptime_ms;
+    usage->exits++;
+    if(oom) {
+        usage->exits_oom++;
+    }
+    else if(WIFSIGNALED(status)) {
+        usage->exits_signaled++;
+    }
+    else if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+        usage->exits_failed++;
+    }
+    usage->last_status = status;
+    usage->last_oom = oom;
+    usage->last_unhealthy = false;
+
+    log("supervisor_account() process %s (pid=%d) ran %llu ms: user %llu ms, system %llu ms, max rss %ld kB, %ld major faults", scb->application->name, pid, (unsigned long long)uptime_ms, (unsigned long long)(user_us / 1000), (unsigned long long)(system_us / 1000), rusage->ru_maxrss, rusage->ru_majflt);
+}
+
+static const char *supervisor_exit_reason(const supervisor_usage_t *usage, char *buffer, size_t size) {
+    if(usage->exits == 0) {
+        snprintf(buffer, size, "none");
+    }
+    else if(usage->last_oom) {
+        snprintf(buffer, size, "oom-killed");
+    }
+    else if(usage->last_unhealthy) {
+        snprintf(buffer, size, "unhealthy");
+    }
+    else if(WIFEXITED(usage->last_status)) {
+        snprintf(buffer, size, "exited %d", WEXITSTATUS(usage->last_status));
+    }
+    else if(WIFSIGNALED(usage->last_status)) {
+        snprintf(buffer, size, "killed by signal %d%s", WTERMSIG(usage->last_status), WCOREDUMP(usage->last_status) ? " (core dumped)" : "");
+    }
+    else {
+        snprintf(buffer, size, "status %d", usage->last_status);
+    }
+
+    return buffer;
+}
+
+static void supervisor_report(void) {
+    //SIGUSR2: one line per app, so the app eating the CPU budget shows without attaching a profiler
+    uint64_t now = eventloop_now();
+    for(int i = 0; i < scb_count; i++) {
+        const supervisor_usage_t *usage = &scb[i]->usage;
+        uint64_t uptime_ms = usage->uptime_ms + (scb[i]->running ? now - scb[i]->start_time : 0);
+        char reason[64];
+        log_info("supervisor_report() %s: %s, uptime %llu ms, %d restarts, user %llu ms, system %llu ms, max rss %ld kB, %llu major faults, %llu/%llu voluntary/involuntary context switches, last exit: %s",
+            scb[i]->application->name, scb[i]->running ? "running" : "stopped", (unsigned long long)uptime_ms, (usage->spawns > 0) ? usage->spawns - 1 : 0,
+            (unsigned long long)(usage->user_us / 1000), (unsigned long long)(usage->system_us / 1000), usage->max_rss_kb, (unsigned long long)usage->major_faults,
+            (unsigned long long)usage->voluntary_switches, (unsigned long long)usage->involuntary_switches, supervisor_exit_reason(usage, reason, sizeof(reason)));
+    }
+}
+
+static void supervisor_metrics(buffer_t *buffer) {
+    //every family is listed app by app, as the exposition format wants series of a family together
+    uint64_t now = eventloop_now();
+    char app[256];
+
+    metrics_header(buffer, "nanoinit_app_up", "gauge", "Whether the app is running.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_up{app=\"%s\"} %d\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), scb[i]->running ? 1 : 0);
+    }
+
+    metrics_header(buffer, "nanoinit_app_ready", "gauge", "Whether the app is ready, so its dependents may start.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_ready{app=\"%s\"} %d\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), scb[i]->ready ? 1 : 0);
+    }
+
+    metrics_header(buffer, "nanoinit_app_crashed", "gauge", "Whether the restart circuit breaker gave up on the app.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_crashed{app=\"%s\"} %d\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), scb[i]->crashed ? 1 : 0);
+    }
+
+    metrics_header(buffer, "nanoinit_app_health_failures_total", "counter", "Failed health probes of the app.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_health_failures_total{app=\"%s\"} %llu\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), (unsigned long long)scb[i]->usage.health_failures);
+    }
+
+    metrics_header(buffer, "nanoinit_app_restarts_total", "counter", "Times the app was started again.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_restarts_total{app=\"%s\"} %d\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), (scb[i]->usage.spawns > 0) ? scb[i]->usage.spawns - 1 : 0);
+    }
+
+    metrics_header(buffer, "nanoinit_app_exits_total", "counter", "App exits by reason.");
+    for(int i = 0; i < scb_count; i++) {
+        const supervisor_usage_t *usage = &scb[i]->usage;
+        metrics_escape(scb[i]->application->name, app, sizeof(app));
+        buffer_printf(buffer, "nanoinit_app_exits_total{app=\"%s\",reason=\"success\"} %d\n", app, usage->exits - usage->exits_failed - usage->exits_signaled - usage->exits_oom);
+        buffer_printf(buffer, "nanoinit_app_exits_total{app=\"%s\",reason=\"failure\"} %d\n", app, usage->exits_failed);
+        buffer_printf(buffer, "nanoinit_app_exits_total{app=\"%s\",reason=\"signal\"} %d\n", app, usage->exits_signaled);
+        buffer_printf(buffer, "nanoinit_app_exits_total{app=\"%s\",reason=\"oom\"} %d\n", app, usage->exits_oom);
+    }
+
+    metrics_header(buffer, "nanoinit_app_uptime_seconds_total", "counter", "Time the app has been running, over all its runs.");
+    for(int i = 0; i < scb_count; i++) {
+        uint64_t uptime_ms = scb[i]->usage.uptime_ms + (scb[i]->running ? now - scb[i]->start_time : 0);
+        buffer_printf(buffer, "nanoinit_app_uptime_seconds_total{app=\"%s\"} %.3f\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), (double)uptime_ms / 1000);
+    }
+
+    //rusage is only known for runs that were reaped
+    metrics_header(buffer, "nanoinit_app_cpu_seconds_total", "counter", "CPU time of the app's finished runs.");
+    for(int i = 0; i < scb_count; i++) {
+        const supervisor_usage_t *usage = &scb[i]->usage;
+        metrics_escape(scb[i]->application->name, app, sizeof(app));
+        buffer_printf(buffer, "nanoinit_app_cpu_seconds_total{app=\"%s\",mode=\"user\"} %.6f\n", app, (double)usage->user_us / 1000000);
+        buffer_printf(buffer, "nanoinit_app_cpu_seconds_total{app=\"%s\",mode=\"system\"} %.6f\n", app, (double)usage->system_us / 1000000);
+    }
+
+    metrics_header(buffer, "nanoinit_app_max_rss_bytes", "gauge", "Peak resident memory of any finished run of the app.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_max_rss_bytes{app=\"%s\"} %lld\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), (long long)scb[i]->usage.max_rss_kb * 1024);
+    }
+
+    metrics_header(buffer, "nanoinit_app_major_faults_total", "counter", "Major page faults of the app's finished runs.");
+    for(int i = 0; i < scb_count; i++) {
+        buffer_printf(buffer, "nanoinit_app_major_faults_total{app=\"%s\"} %llu\n", metrics_escape(scb[i]->application->name, app, sizeof(app)), (unsigned long long)scb[i]->usage.major_faults);
+    }
+
+    metrics_header(buffer, "nanoinit_app_context_switches_total", "counter", "Context switches of the app's finished runs.");
+    for(int i = 0; i < scb_count; i++) {
+        const supervisor_usage_t *usage = &scb[i]->usage;
+        metrics_escape(scb[i]->application->name, app, sizeof(app));
+        buffer_printf(buffer, "nanoinit_app_context_switches_total{app=\"%s\",type=\"voluntary\"} %llu\n", app, (unsigned long long)usage->voluntary_switches);
+        buffer_printf(buffer, "nanoinit_app_context_switches_total{app=\"%s\",type=\"involuntary\"} %llu\n", app, (unsigned long long)usage->involuntary_switches);
+    }
+
+    metrics_header(buffer, "nanoinit_app_spawn_duration_seconds", "histogram", "Time nanoinit spent spawning the app.");
+    for(int i = 0; i < scb_count; i++) {
+        char labels[sizeof(app) + 8];
+        snprintf(labels, sizeof(labels), "app=\"%s\"", metrics_escape(scb[i]->application->name, app, sizeof(app)));
+        metrics_histogram_render(buffer, "nanoinit_app_spawn_duration_seconds", labels, &scb[i]->usage.spawn_latency);
+    }
+
+    metrics_header(buffer, "nanoinit_log_dropped_records_total", "counter", "Records for the log file and app files the --log-async writer lost to a full ring.");
+    buffer_printf(buffer, "nanoinit_log_dropped_records_total %llu\n", (unsigned long long)writer_dropped());
+}
 
-        //create new session
-        setsid();
+static void supervisor_control(int argc, char **argv, buffer_t *reply) {
+    const char *command = argv[0];
+    if((strcmp(command, "reload") == 0) && (argc == 1)) {
+        //the outcome is logged; the config is read from the main loop, as with SIGUSR1
+        supervisor_got_signal_reload = 1;
+        buffer_printf(reply, "ok\n");
+        return;
+    }
 
-        //execute
-        int result = execv(app_path, app_args);
-        if(result != 0) {
-            log_ni_error("supervisor_spawn() failed to spawn process %s", app_path);
+    if((strcmp(command, "status") == 0) && (argc == 1)) {
+        buffer_printf(reply, "ok\n");
+        for(int i = 0; i < scb_count; i++) {
+            supervisor_control_status(scb[i], reply);
         }
+        return;
+    }
+
+    bool is_signal = (strcmp(command, "signal") == 0);
+    if(!((strcmp(command, "start") == 0) || (strcmp(command, "stop") == 0) || (strcmp(command, "restart") == 0) || (strcmp(command, "status") == 0) || is_signal)) {
+        buffer_printf(reply, "error unknown command %s; expected start, stop, restart, signal, status or reload\n", command);
+        return;
+    }
 
-        //free all used memory
-        free(app_path);
-        for(int i = 0; i < arg_count; i++) {
-            free(app_args[i]);
+    if(argc != (is_signal ? 3 : 2)) {
+        buffer_printf(reply, "error usage: %s <app>%s\n", command, is_signal ? " <signal>" : "");
+        return;
+    }
+
+    supervisor_control_block_t *app = 0;
+    for(int i = 0; i < scb_count; i++) {
+        if(strcmp(scb[i]->application->name, argv[1]) == 0) {
+            app = scb[i];
+            break;
         }
-        free(app_args);
+    }
 
-        //gracefully stop fork
-        _exit(result);
+    if(app == 0) {
+        buffer_printf(reply, "error no app named %s\n", argv[1]);
+        return;
     }
 
-    return 0;
-}
+    if(strcmp(command, "status") == 0) {
+        buffer_printf(reply, "ok\n");
+        supervisor_control_status(app, reply);
+        return;
+    }
+
+    if(supervisor_stopping) {
+        buffer_printf(reply, "error nanoinit is stopping\n");
+        return;
+    }
+
+    if(is_signal) {
+        int signo = config_parse_signal(argv[2]);
+        if((signo <= 0) || (signo >= NSIG)) {
+            buffer_printf(reply, "error invalid signal %s\n", argv[2]);
+        }
+        else if(!app->running) {
+            buffer_printf(reply, "error %s is not running\n", app->application->name);
+        }
+        else if(supervisor_send_signal(app, signo) != 0) {
+            buffer_printf(reply, "error could not signal %s, errno %d\n", app->application->name, errno);
+        }
+        else {
+            log("supervisor_control() sent %d to %s (pid=%d)", signo, app->application->name, app->pid);
+            buffer_printf(reply, "ok\n");
+        }
+        return;
+    }
+
+    if(strcmp(command, "stop") == 0) {
+        //dependents keep running; stop them first if they can't do without this app
+        app->held = true;
+        app->respawn_pending = false;
+        eventloop_timer_stop(&app->restart_timer);
+        app->restart_lost = false;
+        if(app->running && !app->stop_sent) {
+            log("supervisor_control() stopping %s (pid=%d)", app->application->name, app->pid);
+            supervisor_stop_app(app, SIGTERM);
+        }
+        else if(!app->running) {
+            app->started = false;
+            app->ready = false;
+        }
+        supervisor_draining_stop(app, SIGTERM);
+        buffer_printf(reply, "ok\n");
+        return;
+    }
+
+    if(manual_mode && app->application->manual) {
+        buffer_printf(reply, "error %s is marked as manual\n", app->application->name);
+        return;
+    }
+
+    //start and restart give an app the circuit breaker gave up on another chance
+    app->held = false;
+    app->crashed = false;
+    app->failures = 0;
+    app->window_restarts = 0;
+    eventloop_timer_stop(&app->restart_timer);
+    app->restart_lost = false;
+
+    if(app->running) {
+        if(strcmp(command, "start") == 0) {
+            buffer_printf(reply, "error %s is already running\n", app->application->name);
+            return;
+        }
+
+        if(supervisor_overlap(app) == 0) {
+            buffer_printf(reply, "ok\n");
+            return;
+        }
+
+        log("supervisor_control() restarting %s (pid=%d)", app->application->name, app->pid);
+        app->respawn_pending = true;
+        if(!app->stop_sent) {
+            supervisor_stop_app(app, SIGTERM);
+        }
+        buffer_printf(reply, "ok\n");
+        return;
+    }
+
+    app->started = false;
+    app->demanded = true;
+    supervisor_try_start(app);
+    if(!app->started) {
+        buffer_printf(reply, "ok\nwaiting for dependencies\n");
+        return;
+    }
+    buffer_printf(reply, "ok\n");
+}
+
+static void supervisor_control_status(const supervisor_control_block_t *scb, buffer_t *reply) {
+    //"<app> <state> key=value..."; one line per app
+    const char *state = "exited";
+    if(scb->running) {
+        state = scb->stop_sent ? "stopping" : "running";
+    }
+    else if(scb->held) {
+        state = "stopped";
+    }
+    else if(scb->crashed) {
+        state = "crashed";
+    }
+    else if(eventloop_timer_armed(&scb->restart_timer)) {
+        state = "restarting";
+    }
+    else if(!scb->started && !(scb->application->on_demand && (scb->socket_sources != 0))) {
+        state = "waiting";
+    }
+    else if(manual_mode && scb->application->manual) {
+        state = "manual";
+    }
+    else if(scb->application->on_demand && (scb->socket_sources != 0)) {
+        state = "idle";
+    }
+
+    const supervisor_usage_t *usage = &scb->usage;
+    uint64_t uptime_ms = scb->running ? eventloop_now() - scb->start_time : 0;
+    char reason[64];
+    buffer_printf(reply, "%s %s pid=%d ready=%d uptime=%.3f restarts=%d last_exit=\"%s\"", scb->application->name, state, scb->running ? (int)scb->pid : 0, scb->ready ? 1 : 0,
+        (double)uptime_ms / 1000, (usage->spawns > 0) ? usage->spawns - 1 : 0, supervisor_exit_reason(usage, reason, sizeof(reason)));
+    if(scb->draining.pid != 0) {
+        buffer_printf(reply, " previous_pid=%d", (int)scb->draining.pid);
+    }
+    if(scb->running && (scb->health_check.failures > 0)) {
+        buffer_printf(reply, " health_failures=%d", scb->health_check.failures);
+    }
+    buffer_printf(reply, "\n");
+}
+
+static void supervisor_schedule_restart(supervisor_control_block_t *scb, bool failed) {
+    const nanoinit_application_config_t *app = scb->application;
+    if((app->restart == NI_RESTART_NEVER) || ((app->restart == NI_RESTART_ON_FAILURE) && !failed) || scb->crashed) {
+        return;
+    }
+
+    uint64_t now = eventloop_now();
+
+    //a process that stayed up longer than the backoff cap starts over with an immediate restart
+    if(now - scb->start_time > (uint64_t)app->restart_delay_max_ms) {
+        scb->failures = 0;
+    }
+    scb->failures++;
+
+    //circuit breaker: too many restarts within the window means the app is crash-looping
+    if(app->max_restarts) {
+        if(now - scb->window_start > (uint64_t)app->restart_window_ms) {
+            scb->window_start = now;
+            scb->window_restarts = 0;
+        }
+
+        if(scb->window_restarts >= app->max_restarts) {
+            log_app_error("supervisor_start() %s restarted %d times within %d ms; giving up", app->name, scb->window_restarts, app->restart_window_ms);
+            scb->crashed = true;
+            return;
+        }
+        scb->window_restarts++;
+    }
+
+    //first restart is immediate, then restart_delay doubling up to restart_delay_max, randomized by restart_jitter
+    uint64_t delay = 0;
+    if(scb->failures > 1) {
+        delay = (uint64_t)app->restart_delay_ms;
+        for(int i = 2; (i < scb->failures) && (delay < (uint64_t)app->restart_delay_max_ms); i++) {
+            delay *= 2;
+        }
+
+        if(delay > (uint64_t)app->restart_delay_max_ms) {
+            delay = (uint64_t)app->restart_delay_max_ms;
+        }
+
+        double jitter = app->restart_jitter * (2.0 * ((double)random() / RAND_MAX) - 1.0);
+        delay = (uint64_t)((double)delay * (1.0 + jitter));
+
+        log("supervisor_start() restarting %s in %llu ms (attempt %d)", app->name, (unsigned long long)delay, scb->failures);
+    }
+
+    supervisor_timer_start(scb, &scb->restart_timer, &scb->restart_lost, delay);
+}
+
+static void supervisor_restart_cb(eventloop_timer_t *timer) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)timer->data;
+    if(supervisor_stopping || scb->running || scb->held) {
+        return;
+    }
+
+    uint64_t wait_ms;
+    if(!supervisor_rate_acquire(&wait_ms)) {
+        supervisor_timer_start(scb, &scb->restart_timer, &scb->restart_lost, wait_ms);
+        return;
+    }
+
+    if(supervisor_spawn(scb) != 0) {
+        log_app_error("supervisor_start() failed to spawn '%s'", scb->application->name);
+        supervisor_schedule_restart(scb, true);
+    }
+    else if(scb->running) {
+        //a manual app isn't spawned at all
+        log("supervisor_start() respawned %s (pid=%d)", scb->application->name, scb->pid);
+    }
+}
+
+static void supervisor_timer_start(supervisor_control_block_t *scb, eventloop_timer_t *timer, bool *lost, uint64_t delay_ms) {
+    //the timer heap may fail to grow; a dropped restart would leave the app down and a dropped kill would unbound the shutdown
+    *lost = (eventloop_timer_start(timer, delay_ms) != 0);
+    if(*lost) {
+        log_app_error("supervisor_start() failed to arm a timer for %s; retrying in %d ms", scb->application->name, SUPERVISOR_TIMER_RETRY_MS);
+        supervisor_timers_lost = true;
+    }
+}
+
+static void supervisor_timers_retry(void) {
+    //the callbacks check the app state again, so a restart that is no longer wanted is a no-op; the lost delay is not made up for
+    supervisor_timers_lost = false;
+    for(int i = 0; i < scb_count; i++) {
+        supervisor_timers_retry_scb(scb[i]);
+    }
+
+    for(supervisor_control_block_t *retired = scb_retired; retired; retired = retired->retired_next) {
+        supervisor_timers_retry_scb(retired);
+    }
+}
+
+static void supervisor_timers_retry_scb(supervisor_control_block_t *scb) {
+    if(scb->restart_lost) {
+        supervisor_timer_start(scb, &scb->restart_timer, &scb->restart_lost, 0);
+    }
+
+    if(scb->kill_lost) {
+        supervisor_timer_start(scb, &scb->kill_timer, &scb->kill_lost, (uint64_t)scb->application->stop_timeout_ms);
+    }
+
+    if(scb->draining.kill_lost) {
+        supervisor_timer_start(scb, &scb->draining.kill_timer, &scb->draining.kill_lost, (uint64_t)scb->application->stop_timeout_ms);
+    }
+}
+
+static bool supervisor_rate_acquire(uint64_t *wait_ms) {
+    if(supervisor_restart_rate == 0) {
+        return true;
+    }
+
+    //token bucket refilled at supervisor_restart_rate per second, holding at most one second worth of restarts
+    uint64_t now = eventloop_now();
+    uint64_t capacity = (uint64_t)supervisor_restart_rate * 1000;
+    supervisor_rate_tokens += (now - supervisor_rate_updated) * (uint64_t)supervisor_restart_rate;
+    if(supervisor_rate_tokens > capacity) {
+        supervisor_rate_tokens = capacity;
+    }
+    supervisor_rate_updated = now;
+
+    if(supervisor_rate_tokens >= 1000) {
+        supervisor_rate_tokens -= 1000;
+        return true;
+    }
+
+    *wait_ms = (1000 - supervisor_rate_tokens + supervisor_restart_rate - 1) / supervisor_restart_rate;
+    return false;
+}
+
+static supervisor_control_block_t *supervisor_scb_at(int index) {
+    //scb entries share indices with config applications, so dependency indices address scb directly
+    return scb[index];
+}
+
+static void supervisor_try_start(supervisor_control_block_t *scb) {
+    if(scb->started || scb->held || supervisor_stopping) {
+        return;
+    }
+
+    for(int i = 0; i < scb->application->dependency_count; i++) {
+        if(!supervisor_scb_at(scb->application->dependencies[i])->ready) {
+            return;     //started later from supervisor_set_ready()
+        }
+    }
+
+    //an on_demand app only binds its sockets; clients can connect from now on, so its dependents may start
+    if(scb->application->on_demand && !scb->demanded) {
+        if(supervisor_sockets_open(scb) != 0) {
+            return;
+        }
+
+        if(scb->socket_sources == 0) {
+            log("supervisor_start() %s waits for its first connection", scb->application->name);
+            supervisor_sockets_watch(scb, true);
+        }
+        supervisor_set_ready(scb);
+        return;
+    }
+
+    scb->started = true;
+    if(supervisor_spawn(scb) != 0) {
+        log_app_error("supervisor_start() failed to spawn '%s'", scb->application->name);
+        supervisor_schedule_restart(scb, true);
+    }
+    else if(scb->running) {
+        //a manual app isn't spawned at all
+        log("supervisor_start() successfully spawned '%s' with pid %d", scb->application->name, scb->pid);
+    }
+}
+
+static void supervisor_set_ready(supervisor_control_block_t *scb) {
+    //the replacement of an overlap restart is ready; the previous process can go now
+    if(scb->running && (scb->draining.pid != 0) && !scb->draining.stop_sent) {
+        supervisor_draining_stop(scb, SIGTERM);
+    }
+
+    if(scb->ready) {
+        return;
+    }
+
+    scb->ready = true;
+    for(int i = 0; i < scb->application->dependent_count; i++) {
+        supervisor_try_start(supervisor_scb_at(scb->application->dependents[i]));
+    }
+}
+
+static void supervisor_ready_cb(ready_check_t *check, bool ready) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)check->data;
+    if(ready) {
+        if(scb->application->ready.type != NI_READY_NONE) {
+            log("supervisor_ready_cb() app %s (pid=%d) is ready", scb->application->name, scb->pid);
+        }
+    }
+    else {
+        log_app_error("supervisor_ready_cb() app %s (pid=%d) not ready after %d ms; starting its dependents anyway", scb->application->name, scb->pid, scb->application->ready.timeout_ms);
+    }
+
+    //health checks only start now, so a slow startup is covered by ready_timeout instead of failing probes
+    health_start(&scb->health_check);
+    supervisor_set_ready(scb);
+}
+
+static void supervisor_health_cb(health_check_t *check, bool healthy) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)check->data;
+    const nanoinit_health_config_t *health = &scb->application->health;
+    if(healthy) {
+        log("supervisor_health_cb() app %s (pid=%d) passes its health check %s again", scb->application->name, scb->pid, health->check);
+        return;
+    }
+
+    scb->usage.health_failures++;
+    if(check->failures < health->threshold) {
+        log_app_error("supervisor_health_cb() health check %s of app %s (pid=%d) failed (%d of %d)", health->check, scb->application->name, scb->pid, check->failures, health->threshold);
+        return;
+    }
+
+    if(!scb->running || scb->stop_sent) {
+        return;
+    }
+
+    //stopped like on shutdown; supervisor_process_exited() then restarts it under its restart policy
+    log_app_error("supervisor_health_cb() app %s (pid=%d) failed its health check %s %d times in a row; stopping it", scb->application->name, scb->pid, health->check, check->failures);
+    scb->unhealthy = true;
+    supervisor_stop_app(scb, SIGTERM);
+}
+
+static void supervisor_stop_all(int signo) {
+    supervisor_stopping = 1;
+    supervisor_stop_signal = signo;
+
+    //a repeated stop signal is forwarded again; pending restarts are dropped
+    for(int i = 0; i < scb_count; i++) {
+        scb[i]->stop_sent = false;
+        scb[i]->respawn_pending = false;
+        eventloop_timer_stop(&scb[i]->restart_timer);
+        scb[i]->restart_lost = false;
+    }
+
+    for(int i = 0; i < scb_count; i++) {
+        supervisor_try_stop(scb[i]);
+    }
+
+    //previous processes of overlap restarts are on their way out anyway
+    for(int i = 0; i < scb_count; i++) {
+        supervisor_draining_stop(scb[i], signo);
+    }
+}
+
+static void supervisor_try_stop(supervisor_control_block_t *scb) {
+    if(!scb->running || scb->stop_sent) {
+        return;
+    }
+
+    //dependents are stopped first; this app is retried from supervisor_process_exited() when they are gone
+    for(int i = 0; i < scb->application->dependent_count; i++) {
+        if(supervisor_scb_at(scb->application->dependents[i])->running) {
+            return;
+        }
+    }
+
+    supervisor_stop_app(scb, supervisor_stop_signal);
+}
+
+static void supervisor_stop_app(supervisor_control_block_t *scb, int signo) {
+    if(scb->application->stop_signal) {
+        signo = scb->application->stop_signal;
+    }
+
+    log("supervisor_start() sending %d to %s (pid=%d)...", signo, scb->application->name, scb->pid);
+    supervisor_send_signal(scb, signo);
+    scb->stop_sent = true;
+    health_cancel(&scb->health_check);
+    supervisor_draining_stop(scb, signo);
+
+    //the deadline is kept when the stop signal is repeated
+    if(scb->application->stop_timeout_ms && !eventloop_timer_armed(&scb->kill_timer)) {
+        supervisor_timer_start(scb, &scb->kill_timer, &scb->kill_lost, (uint64_t)scb->application->stop_timeout_ms);
+    }
+}
+
+static void supervisor_kill_cb(eventloop_timer_t *timer) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)timer->data;
+    if(!scb->running) {
+        return;
+    }
+
+    log_app_error("supervisor_start() %s (pid=%d) did not stop within %d ms; sending SIGKILL", scb->application->name, scb->pid, scb->application->stop_timeout_ms);
+    supervisor_send_signal(scb, SIGKILL);
+}
+
+static int supervisor_send_signal(supervisor_control_block_t *scb, int signo) {
+    return supervisor_signal_process(scb->pid, scb->pidfd, signo);
+}
+
+static int supervisor_signal_process(pid_t pid, int pidfd, int signo) {
+    //apps run in their own session, so the whole process group is signalled; the group can't be recycled while the leader is unreaped
+    if(kill(-pid, signo) == 0) {
+        return 0;
+    }
+
+    //the pidfd pins the process, so the signal can't hit a recycled PID
+    if(pidfd >= 0) {
+        return (int)syscall(SYS_pidfd_send_signal, pidfd, signo, 0, 0);
+    }
+
+    return kill(pid, signo);
+}
+
+static void supervisor_pidfd_close(supervisor_control_block_t *scb) {
+    if(scb->pidfd >= 0) {
+        eventloop_remove(&scb->pidfd_source);
+        close(scb->pidfd);
+        scb->pidfd = -1;
+        scb->pidfd_source.fd = -1;
+    }
+}
+
+
+static int supervisor_overlap(supervisor_control_block_t *scb) {
+    //returns -1 when the app is restarted the stop-first way instead; a restart during an overlap is one of those
+    if((scb->application->restart_mode != NI_RESTART_MODE_OVERLAP) || !scb->running || scb->stop_sent || (scb->draining.pid != 0)) {
+        return -1;
+    }
+
+    log("supervisor_overlap() starting a replacement for %s (pid=%d)", scb->application->name, scb->pid);
+
+    //the running process moves aside; it keeps its pidmap entry and its place in scb_running_count
+    supervisor_draining_t *draining = &scb->draining;
+    draining->pid = scb->pid;
+    draining->start_time = scb->start_time;
+    draining->stop_sent = false;
+    if(scb->pidfd >= 0) {
+        eventloop_remove(&scb->pidfd_source);
+        draining->pidfd = scb->pidfd;
+        draining->pidfd_source.fd = scb->pidfd;
+        if(eventloop_add(&draining->pidfd_source, EPOLLIN) != 0) {
+            close(draining->pidfd);
+            draining->pidfd = -1;
+            draining->pidfd_source.fd = -1;
+        }
+        scb->pidfd = -1;
+        scb->pidfd_source.fd = -1;
+    }
+
+    ready_cancel(&scb->ready_check);
+    health_cancel(&scb->health_check);
+    eventloop_timer_stop(&scb->idle_timer);
+    scb->running = 0;
+
+    if(supervisor_spawn(scb) != 0) {
+        log_app_error("supervisor_overlap() could not spawn a replacement for %s; keeping pid %d", scb->application->name, draining->pid);
+        supervisor_overlap_revert(scb);
+    }
+
+    return 0;
+}
+
+static void supervisor_overlap_revert(supervisor_control_block_t *scb) {
+    //the previous process never got its stop signal, so it simply becomes the app's process again
+    supervisor_draining_t *draining = &scb->draining;
+    scb->pid = draining->pid;
+    scb->start_time = draining->start_time;
+    scb->running = 1;
+    if(draining->pidfd >= 0) {
+        eventloop_remove(&draining->pidfd_source);
+        scb->pidfd = draining->pidfd;
+        scb->pidfd_source.fd = draining->pidfd;
+        if(eventloop_add(&scb->pidfd_source, EPOLLIN) != 0) {
+            close(scb->pidfd);
+            scb->pidfd = -1;
+            scb->pidfd_source.fd = -1;
+        }
+    }
+    draining->pid = 0;
+    draining->pidfd = -1;
+    draining->pidfd_source.fd = -1;
+
+    if(scb->application->on_demand && scb->application->idle_timeout_ms) {
+        scb->last_activity = eventloop_now();
+        eventloop_timer_start(&scb->idle_timer, scb->application->idle_timeout_ms);
+    }
+    health_start(&scb->health_check);
+    supervisor_set_ready(scb);
+}
+
+static void supervisor_draining_stop(supervisor_control_block_t *scb, int signo) {
+    supervisor_draining_t *draining = &scb->draining;
+    if((draining->pid == 0) || draining->stop_sent) {
+        return;
+    }
+
+    if(scb->application->stop_signal) {
+        signo = scb->application->stop_signal;
+    }
+
+    //stop_timeout is the time it gets to finish its in-flight work
+    log("supervisor_start() sending %d to the previous process of %s (pid=%d)...", signo, scb->application->name, draining->pid);
+    supervisor_signal_process(draining->pid, draining->pidfd, signo);
+    draining->stop_sent = true;
+    if(scb->application->stop_timeout_ms) {
+        supervisor_timer_start(scb, &draining->kill_timer, &draining->kill_lost, (uint64_t)scb->application->stop_timeout_ms);
+    }
+}
+
+static void supervisor_draining_kill_cb(eventloop_timer_t *timer) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)timer->data;
+    if(scb->draining.pid == 0) {
+        return;
+    }
+
+    log_app_error("supervisor_start() previous process of %s (pid=%d) did not stop within %d ms; sending SIGKILL", scb->application->name, scb->draining.pid, scb->application->stop_timeout_ms);
+    supervisor_signal_process(scb->draining.pid, scb->draining.pidfd, SIGKILL);
+}
+
+static int supervisor_spawn(supervisor_control_block_t *scb) {
+    if(manual_mode && scb->application->manual) {
+        log("supervisor_spawn() process %s not spawned because is marked as manual", scb->application->name);
+        //don't hold back its dependents
+        supervisor_set_ready(scb);
+        return 0;
+    }
+
+    //dependents started from now on wait for this instance to become ready
+    scb->ready = false;
+    scb->start_time = eventloop_now();
+
+    //everything is precompiled in the spawn plan; redirect files and capture pipes are opened once and shared by every process of the app
+    spawn_request_t request;
+    request.plan = scb->application->spawn_plan;
+    request.stdout_fd = -1;
+    request.stderr_fd = -1;
+    if(capture_needed(scb->application)) {
+        if(scb->capture == 0) {
+            scb->capture = capture_create(scb->application);
+        }
+
+        if(scb->capture) {
+            request.stdout_fd = capture_fd(scb->capture, CAPTURE_STDOUT);
+            request.stderr_fd = capture_fd(scb->capture, CAPTURE_STDERR);
+        }
+    }
+    request.notify_fd = ready_prepare(&scb->ready_check);
+
+    //the cgroup is kept across restarts, so its limits are written once per definition
+    if((scb->cgroup_fd < 0) && cgroup_limits_set(&scb->application->cgroup)) {
+        scb->cgroup_fd = cgroup_app_open(scb->application->name, &scb->application->cgroup);
+        scb->oom_kills = cgroup_oom_kills(scb->cgroup_fd);
+    }
+    request.cgroup_fd = scb->cgroup_fd;
+
+    if(supervisor_sockets_open(scb) != 0) {
+        ready_cancel(&scb->ready_check);
+        return -1;
+    }
+    request.listen_fds = scb->listen_fds;
+    request.listen_fd_count = scb->listen_fd_count;
+    request.listen_fdnames = scb->listen_fdnames;
+
+    //a child that can't be indexed could never be reaped, so the room for its pid is made before it exists
+    if(pidmap_reserve(&scb_pidmap, scb_pidmap.count + 1) != 0) {
+        log_ni_error("supervisor_spawn() could not index process %s", scb->application->name);
+        ready_cancel(&scb->ready_check);
+        return -1;
+    }
+
+    struct timespec spawn_start, spawn_end;
+    clock_gettime(CLOCK_MONOTONIC, &spawn_start);
+    scb->pid = spawn_process(&request);
+    clock_gettime(CLOCK_MONOTONIC, &spawn_end);
+    metrics_histogram_observe(&scb->usage.spawn_latency, (double)(spawn_end.tv_sec - spawn_start.tv_sec) + (double)(spawn_end.tv_nsec - spawn_start.tv_nsec) / 1e9);
+
+    if(scb->pid == -1) {
+        log_ni_error("supervisor_spawn() failed to spawn process %s", scb->application->path);
+        ready_cancel(&scb->ready_check);
+        return -1;
+    }
+
+    scb->running = 1;
+    scb->usage.spawns++;
+    pidmap_insert(&scb_pidmap, scb->pid, scb);     //can't fail, the room was reserved above
+    scb_running_count++;
+
+    //the pidfd is opened before the child can be reaped, so it always refers to this child
+    scb->pidfd = (int)syscall(SYS_pidfd_open, scb->pid, 0);
+    if(scb->pidfd >= 0) {
+        scb->pidfd_source.fd = scb->pidfd;
+        if(eventloop_add(&scb->pidfd_source, EPOLLIN) != 0) {
+            close(scb->pidfd);
+            scb->pidfd = -1;
+            scb->pidfd_source.fd = -1;
+        }
+    }
+
+    if(scb->application->on_demand && scb->application->idle_timeout_ms) {
+        scb->last_activity = scb->start_time;
+        eventloop_timer_start(&scb->idle_timer, scb->application->idle_timeout_ms);
+    }
+
+    ready_start(&scb->ready_check);
+    return 0;
+}
+
+static void supervisor_cgroup_close(supervisor_control_block_t *scb) {
+    cgroup_app_close(scb->cgroup_fd, scb->application->name);
+    scb->cgroup_fd = -1;
+}
+
+static int supervisor_sockets_open(supervisor_control_block_t *scb) {
+    if((scb->listen_fds != 0) || (scb->application->socket_count == 0)) {
+        return 0;
+    }
+
+    int *fds = (int *)malloc(sizeof(int) * scb->application->socket_count);
+    if(fds == 0) {
+        log_ni_error("supervisor_spawn() bad memory allocation");
+        return -1;
+    }
+
+    if(activation_open(scb->application, fds) != 0) {
+        log_ni_error("supervisor_spawn() could not bind the sockets of app %s", scb->application->name);
+        free(fds);
+        return -1;
+    }
+
+    scb->listen_fds = fds;
+    scb->listen_fd_count = scb->application->socket_count;
+    scb->listen_fdnames = activation_fdnames(scb->application);
+    return 0;
+}
+
+static void supervisor_sockets_close(supervisor_control_block_t *scb) {
+    if(scb->listen_fds == 0) {
+        return;
+    }
+
+    supervisor_sockets_watch(scb, false);
+    activation_close(scb->listen_fds, scb->listen_fd_count);
+    free(scb->listen_fds);
+    free(scb->listen_fdnames);
+    scb->listen_fds = 0;
+    scb->listen_fd_count = 0;
+    scb->listen_fdnames = 0;
+}
+
+static void supervisor_sockets_watch(supervisor_control_block_t *scb, bool watch) {
+    if(watch == (scb->socket_sources != 0)) {
+        return;
+    }
+
+    if(!watch) {
+        for(int i = 0; i < scb->listen_fd_count; i++) {
+            eventloop_remove(&scb->socket_sources[i]);
+        }
+        free(scb->socket_sources);
+        scb->socket_sources = 0;
+        return;
+    }
+
+    //edge-triggered: every new connection is one wakeup, whether or not the app already accepts on the socket
+    eventloop_source_t *sources = (eventloop_source_t *)calloc(scb->listen_fd_count, sizeof(eventloop_source_t));
+    int added = 0;
+    for(; (sources != 0) && (added < scb->listen_fd_count); added++) {
+        sources[added].fd = scb->listen_fds[added];
+        sources[added].callback = supervisor_socket_cb;
+        sources[added].data = scb;
+        if(eventloop_add(&sources[added], EPOLLIN | EPOLLET) != 0) {
+            break;
+        }
+    }
+
+    if((sources == 0) || (added < scb->listen_fd_count)) {
+        //not worth leaving the app down for; it is started right away instead
+        log_ni_error("supervisor_start() could not watch the sockets of %s; starting it now", scb->application->name);
+        for(int i = 0; i < added; i++) {
+            eventloop_remove(&sources[i]);
+        }
+        free(sources);
+        scb->demanded = true;
+        return;
+    }
+
+    scb->socket_sources = sources;
+}
+
+static bool supervisor_sockets_pending(const supervisor_control_block_t *scb) {
+    //connections that arrived while the app was shutting down are in the backlog without a new edge to report them
+    for(int i = 0; i < scb->listen_fd_count; i++) {
+        struct pollfd pfd = { .fd = scb->listen_fds[i], .events = POLLIN };
+        if(poll(&pfd, 1, 0) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void supervisor_socket_cb(eventloop_source_t *source, uint32_t events) {
+    (void)events;
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)source->data;
+    scb->last_activity = eventloop_now();
+    if(scb->demanded || scb->running || scb->held || scb->crashed || supervisor_stopping) {
+        return;
+    }
+
+    log("supervisor_socket_cb() connection for %s; starting it", scb->application->name);
+    scb->demanded = true;
+    supervisor_try_start(scb);
+}
+
+static void supervisor_idle_cb(eventloop_timer_t *timer) {
+    supervisor_control_block_t *scb = (supervisor_control_block_t *)timer->data;
+    if(!scb->running || scb->stop_sent) {
+        return;
+    }
+
+    //connections only record their time; the deadline is moved here, once per idle_timeout at most
+    uint64_t idle = eventloop_now() - scb->last_activity;
+    if(idle < (uint64_t)scb->application->idle_timeout_ms) {
+        eventloop_timer_start(&scb->idle_timer, (uint64_t)scb->application->idle_timeout_ms - idle);
+        return;
+    }
+
+    log("supervisor_idle_cb() no connection for %s in %d ms; stopping it (pid=%d)", scb->application->name, scb->application->idle_timeout_ms, scb->pid);
+    scb->idle_stop = true;
+    supervisor_stop_app(scb, SIGTERM);
+}
+
+static void supervisor_demand_wait(supervisor_control_block_t *scb) {
+    //back to listening only; the backoff starts over with the next connection
+    scb->started = false;
+    scb->failures = 0;
+    scb->demanded = supervisor_sockets_pending(scb);
+    supervisor_try_start(scb);
+}
+
+static void supervisor_free_scb(void) {
+    //nothing may stay armed in the event loop once scb is gone
+    for(int i = 0; (scb != 0) && (i < scb_count); i++) {
+        if(scb[i]) {
+            eventloop_timer_stop(&scb[i]->restart_timer);
+            eventloop_timer_stop(&scb[i]->kill_timer);
+            eventloop_timer_stop(&scb[i]->idle_timer);
+            eventloop_timer_stop(&scb[i]->draining.kill_timer);
+            ready_cancel(&scb[i]->ready_check);
+            health_cancel(&scb[i]->health_check);
+            supervisor_cgroup_close(scb[i]);
+            supervisor_sockets_close(scb[i]);
+            capture_free(scb[i]->capture);
+            free(scb[i]);
+        }
+    }
 
-static void supervisor_free_scb(void) {
     free(scb);
+    scb = 0;
+    scb_count = 0;
+
+    while(scb_retired) {
+        supervisor_retired_free(scb_retired);
+    }
+    pidmap_free(&scb_pidmap);
+    config_free(supervisor_config);
+    supervisor_config = 0;
+}
+
+static void supervisor_log_timer_cb(eventloop_timer_t *timer) {
+    //only wakes the loop up; the end of the iteration flushes the log
+    (void)timer;
 }
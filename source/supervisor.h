@@ -27,4 +27,5 @@
 #include "arguments.h"
 #include "config.h"
 
-int supervisor_start(const nanoinit_arguments_t *arguments, const nanoinit_config_t *config);
+//takes ownership of config (0 runs no apps); it is freed, along with any config loaded by a reload, before returning
+int supervisor_start(const nanoinit_arguments_t *arguments, nanoinit_config_t *config);
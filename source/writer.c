@@ -0,0 +1,288 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "writer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WRITER_BATCH            65536   //bytes the thread gathers before writing
+#define WRITER_SEGMENTS_MAX     256     //runs of records for one file per batch
+#define WRITER_TAG              sizeof(writer_file_t *)
+#define WRITER_DATA_MAX         (RING_RECORD_MAX - WRITER_TAG)
+
+struct writer_file_s {
+    rotate_file_t file;             //touched by the thread only, but for path and append that never change
+    rotate_policy_t policy;
+    atomic_int errors;              //WRITER_ERROR_* not yet reported
+    atomic_bool failed;
+    uint64_t close_at;              //ring position after the last record queued for the file
+    writer_file_t *next;            //in the list of files to close
+};
+
+//consecutive records of one file in the batch
+typedef struct writer_segment_s {
+    writer_file_t *file;
+    size_t offset;
+    size_t length;
+} writer_segment_t;
+
+static bool writer_started = false;
+static ring_t writer_ring;
+static pthread_t writer_thread;
+
+//files closed by the supervisor, freed by the thread once the ring tail has passed their close_at
+static pthread_mutex_t writer_closing_mutex = PTHREAD_MUTEX_INITIALIZER;
+static writer_file_t *writer_closing = 0;
+
+static void *writer_main(void *arg);
+static void writer_output(writer_file_t *file, const char *data, size_t length);
+static void writer_close_done(bool all);
+static void writer_file_free(writer_file_t *file);
+
+int writer_start(size_t ring_size, ring_overflow_t overflow) {
+    if(writer_started) {
+        return 0;
+    }
+
+    if(ring_init(&writer_ring, ring_size, overflow) != 0) {
+        return -1;
+    }
+
+    //signals are left to the supervisor's signalfd; the thread starts with all of them blocked
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    int rc = pthread_create(&writer_thread, 0, writer_main, 0);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    if(rc != 0) {
+        ring_free(&writer_ring);
+        return -1;
+    }
+
+    writer_started = true;
+    return 0;
+}
+
+void writer_stop(int timeout_ms) {
+    if(!writer_started) {
+        return;
+    }
+
+    //the thread drains the ring before it exits; if the volume is stalled it is left behind, along with its files
+    ring_close(&writer_ring);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    if(pthread_timedjoin_np(writer_thread, 0, &deadline) == 0) {
+        writer_close_done(true);
+        ring_free(&writer_ring);
+        writer_started = false;
+    }
+}
+
+bool writer_running(void) {
+    return writer_started;
+}
+
+uint64_t writer_dropped(void) {
+    return writer_started ? ring_dropped(&writer_ring) : 0;
+}
+
+writer_file_t *writer_file_open(const char *path, bool append, const rotate_policy_t *policy) {
+    if(!writer_started || (path == 0)) {
+        return 0;
+    }
+
+    writer_file_t *file = (writer_file_t *)calloc(1, sizeof(writer_file_t));
+    if(file == 0) {
+        return 0;
+    }
+
+    if(policy) {
+        file->policy = *policy;
+    }
+    rotate_init(&file->file, &file->policy);
+    if(rotate_set_path(&file->file, path, append) != 0) {
+        free(file);
+        return 0;
+    }
+    atomic_init(&file->errors, 0);
+    atomic_init(&file->failed, false);
+    return file;
+}
+
+void writer_file_close(writer_file_t *file) {
+    if(file == 0) {
+        return;
+    }
+
+    if(!writer_started) {
+        writer_file_free(file);
+        return;
+    }
+
+    //records already queued still reference the file, so the thread frees it once it is past them
+    file->close_at = atomic_load(&writer_ring.head);
+    pthread_mutex_lock(&writer_closing_mutex);
+    file->next = writer_closing;
+    writer_closing = file;
+    pthread_mutex_unlock(&writer_closing_mutex);
+    ring_kick(&writer_ring);
+}
+
+void writer_write(writer_file_t *file, const void *data, size_t length) {
+    //each record is dropped or kept whole, so a drop never tears a log line shorter than WRITER_DATA_MAX
+    const char *bytes = (const char *)data;
+    while(length > 0) {
+        size_t chunk = (length < WRITER_DATA_MAX) ? length : WRITER_DATA_MAX;
+        struct iovec parts[2] = {
+            { &file, WRITER_TAG },
+            { (void *)bytes, chunk },
+        };
+        ring_pushv(&writer_ring, parts, 2);
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+bool writer_file_is(const writer_file_t *file, const char *path, bool append, const rotate_policy_t *policy) {
+    rotate_policy_t none = {0};
+    return path && (strcmp(file->file.path, path) == 0) && (file->file.append == append) && rotate_policy_equal(&file->policy, policy ? policy : &none);
+}
+
+int writer_file_errors(writer_file_t *file) {
+    return atomic_exchange(&file->errors, 0);
+}
+
+bool writer_file_failed(const writer_file_t *file) {
+    return atomic_load(&file->failed);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    static char batch[WRITER_BATCH];
+    static writer_segment_t segments[WRITER_SEGMENTS_MAX];
+
+    while(true) {
+        //records of one file that follow each other are joined, dropping the tag in between
+        int count = 0;
+        size_t used = 0;
+        ssize_t length;
+        while((count < WRITER_SEGMENTS_MAX) && ((length = ring_pop(&writer_ring, batch + used, sizeof(batch) - used)) > 0)) {
+            writer_file_t *file;
+            memcpy(&file, batch + used, WRITER_TAG);
+            size_t data = (size_t)length - WRITER_TAG;
+
+            writer_segment_t *last = (count > 0) ? &segments[count - 1] : 0;
+            if(last && (last->file == file) && (last->offset + last->length == used)) {
+                memmove(batch + used, batch + used + WRITER_TAG, data);
+                last->length += data;
+                used += data;
+            }
+            else {
+                segments[count++] = (writer_segment_t){ file, used + WRITER_TAG, data };
+                used += (size_t)length;
+            }
+        }
+
+        for(int i = 0; i < count; i++) {
+            writer_output(segments[i].file, batch + segments[i].offset, segments[i].length);
+        }
+        writer_close_done(false);
+
+        if((count == 0) && !ring_wait(&writer_ring)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void writer_output(writer_file_t *file, const char *data, size_t length) {
+    if(file->file.fd == -1) {
+        if(rotate_fd(&file->file) < 0) {
+            atomic_store(&file->failed, true);
+            atomic_fetch_or(&file->errors, WRITER_ERROR_OPEN);
+        }
+    }
+
+    //a rotated file takes no more than fits, so it is rotated right at its max_size
+    while((file->file.fd >= 0) && (length > 0)) {
+        size_t chunk = rotate_room(&file->file, length);
+        size_t written = 0;
+        while(written < chunk) {
+            ssize_t w = write(file->file.fd, data + written, chunk - written);
+            if(w < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return;     //a full disk loses the records, as without the writer thread
+            }
+            written += (size_t)w;
+        }
+
+        if(rotate_written(&file->file, chunk) != 0) {
+            atomic_fetch_or(&file->errors, WRITER_ERROR_ROTATE);
+        }
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+static void writer_close_done(bool all) {
+    //every record before close_at has been written or dropped once the tail is past it
+    uint64_t tail = atomic_load(&writer_ring.tail);
+    pthread_mutex_lock(&writer_closing_mutex);
+    writer_file_t **link = &writer_closing;
+    while(*link) {
+        writer_file_t *file = *link;
+        if(all || (file->close_at <= tail)) {
+            *link = file->next;
+            writer_file_free(file);
+        }
+        else {
+            link = &file->next;
+        }
+    }
+    pthread_mutex_unlock(&writer_closing_mutex);
+}
+
+static void writer_file_free(writer_file_t *file) {
+    rotate_set_path(&file->file, 0, false);
+    free(file);
+}
@@ -0,0 +1,70 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ring.h"
+#include "rotate.h"
+
+//errors the writer thread ran into, reported to the supervisor by writer_file_errors()
+#define WRITER_ERROR_OPEN           0x01    //the file could not be opened; nothing more is written to it
+#define WRITER_ERROR_ROTATE         0x02    //a rotation failed; writing continues in the old file
+
+//file written and rotated by the writer thread, so a slow or stalled volume never blocks the supervisor. Writes are queued
+//as records tagged with their file in one bounded ring, which the thread drains in batches of one write() per file.
+//Only the supervisor opens, writes and closes files; everything about the open file belongs to the thread
+typedef struct writer_file_s writer_file_t;
+
+//starts the writer thread with a ring of ring_size bytes; overflow says what happens to writes that don't fit
+int writer_start(size_t ring_size, ring_overflow_t overflow);
+
+//lets the thread write out what is queued, waiting for it up to timeout_ms; a thread stuck on a stalled volume is left behind
+void writer_stop(int timeout_ms);
+
+//whether files are written by the writer thread
+bool writer_running(void);
+
+//records lost to overflow
+uint64_t writer_dropped(void);
+
+//the file is opened by the thread on the first write; path and policy are copied. Returns 0 if the writer isn't running
+writer_file_t *writer_file_open(const char *path, bool append, const rotate_policy_t *policy);
+
+//the file is closed once everything queued for it before is written or dropped; file must not be used afterwards
+void writer_file_close(writer_file_t *file);
+
+//queues length bytes for file; records longer than the ring takes at once are split
+void writer_write(writer_file_t *file, const void *data, size_t length);
+
+//whether file was opened with this path, mode and policy
+bool writer_file_is(const writer_file_t *file, const char *path, bool append, const rotate_policy_t *policy);
+
+//WRITER_ERROR_* flags raised since the last call, each failure reported once
+int writer_file_errors(writer_file_t *file);
+
+//whether the file could not be opened; it is not tried again, a new writer_file_open() is needed for that
+bool writer_file_failed(const writer_file_t *file);
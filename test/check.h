@@ -24,4 +24,17 @@
 
 #pragma once
 
-void nanoinit_send_reload();  //looks for main nanoinit and sends SIGUSR1 signal to reload
+#include <stdio.h>
+
+//minimal assertions for the unit tests run by "make check"; a failed check is reported and counted, and the test
+//keeps going so one run shows every failure
+extern int check_failures;
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        check_failures++; \
+    } \
+} while(0)
+
+#define CHECK_DONE() ((check_failures == 0) ? 0 : 1)
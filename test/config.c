@@ -0,0 +1,59 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "check.h"
+#include "config.h"
+#include <limits.h>
+
+int check_failures = 0;
+
+static void test_parse_size(void) {
+    long long n;
+    CHECK((config_parse_size("0", true, &n) == 0) && (n == 0));
+    CHECK((config_parse_size("4096", false, &n) == 0) && (n == 4096));
+    CHECK((config_parse_size("64K", true, &n) == 0) && (n == 65536));
+    CHECK((config_parse_size("3M", true, &n) == 0) && (n == 3LL << 20));
+    CHECK((config_parse_size("2G", true, &n) == 0) && (n == 2LL << 30));
+    CHECK((config_parse_size("5T", true, &n) == 0) && (n == 5LL << 40));
+
+    CHECK(config_parse_size("", true, &n) == -1);
+    CHECK(config_parse_size("K", true, &n) == -1);
+    CHECK(config_parse_size("-1", true, &n) == -1);
+    CHECK(config_parse_size("12X", true, &n) == -1);
+    CHECK(config_parse_size("1K", false, &n) == -1);
+    CHECK(config_parse_size("1KB", true, &n) == -1);
+
+    //the largest values that still fit, and the first ones that don't
+    CHECK((config_parse_size("8388607T", true, &n) == 0) && (n == 8388607LL << 40));
+    CHECK(config_parse_size("8388608T", true, &n) == -1);
+    CHECK(config_parse_size("9999999T", true, &n) == -1);
+    CHECK(config_parse_size("9007199254740992K", true, &n) == -1);
+    CHECK((config_parse_size("9223372036854775807", true, &n) == 0) && (n == LLONG_MAX));
+    CHECK(config_parse_size("9223372036854775808", true, &n) == -1);
+}
+
+int main(void) {
+    test_parse_size();
+    return CHECK_DONE();
+}
@@ -0,0 +1,189 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "check.h"
+#include "pidmap.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define PIDS_MAX        256
+
+int check_failures = 0;
+
+//the same hash as pidmap_slot(), to build collisions on purpose
+static size_t home_slot(pid_t pid, size_t capacity) {
+    uint32_t h = (uint32_t)pid;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (size_t)h & (capacity - 1);
+}
+
+//fills pids with count pids that all hash to slot in a table of capacity
+static void colliding_pids(size_t slot, size_t capacity, pid_t *pids, int count) {
+    pid_t pid = 1;
+    for(int i = 0; i < count; pid++) {
+        if(home_slot(pid, capacity) == slot) {
+            pids[i++] = pid;
+        }
+    }
+}
+
+static void test_basic(void) {
+    pidmap_t map;
+    CHECK(pidmap_init(&map, 4) == 0);
+    int a, b;
+
+    CHECK(pidmap_find(&map, 10) == 0);
+    CHECK(pidmap_insert(&map, 10, &a) == 0);
+    CHECK(pidmap_insert(&map, 20, &b) == 0);
+    CHECK(pidmap_find(&map, 10) == &a);
+    CHECK(pidmap_find(&map, 20) == &b);
+    CHECK(map.count == 2);
+
+    //inserting a pid again replaces its value
+    CHECK(pidmap_insert(&map, 10, &b) == 0);
+    CHECK(pidmap_find(&map, 10) == &b);
+    CHECK(map.count == 2);
+
+    CHECK(pidmap_remove(&map, 10) == &b);
+    CHECK(pidmap_remove(&map, 10) == 0);
+    CHECK(pidmap_find(&map, 10) == 0);
+    CHECK(pidmap_find(&map, 20) == &b);
+    CHECK(map.count == 1);
+
+    pidmap_free(&map);
+    CHECK(pidmap_find(&map, 20) == 0);
+    CHECK(pidmap_remove(&map, 20) == 0);
+}
+
+static void test_backward_shift(void) {
+    //a cluster of pids sharing one home slot; removing any of them must leave the rest reachable
+    for(int removed = 0; removed < 4; removed++) {
+        pidmap_t map;
+        CHECK(pidmap_init(&map, 4) == 0);
+        CHECK(map.capacity == 16);
+
+        pid_t pids[4];
+        colliding_pids(3, map.capacity, pids, 4);
+        for(int i = 0; i < 4; i++) {
+            CHECK(pidmap_insert(&map, pids[i], &pids[i]) == 0);
+        }
+
+        CHECK(pidmap_remove(&map, pids[removed]) == &pids[removed]);
+        for(int i = 0; i < 4; i++) {
+            CHECK(pidmap_find(&map, pids[i]) == ((i == removed) ? 0 : &pids[i]));
+        }
+        pidmap_free(&map);
+    }
+
+    //a cluster that wraps from the last slot to the first, with an entry homed at slot 0 behind it
+    pidmap_t map;
+    CHECK(pidmap_init(&map, 4) == 0);
+    pid_t wrapping[3], zero[1];
+    colliding_pids(map.capacity - 1, map.capacity, wrapping, 3);
+    colliding_pids(0, map.capacity, zero, 1);
+    for(int i = 0; i < 3; i++) {
+        CHECK(pidmap_insert(&map, wrapping[i], &wrapping[i]) == 0);
+    }
+    CHECK(pidmap_insert(&map, zero[0], &zero[0]) == 0);
+
+    CHECK(pidmap_remove(&map, wrapping[0]) == &wrapping[0]);
+    CHECK(pidmap_find(&map, wrapping[1]) == &wrapping[1]);
+    CHECK(pidmap_find(&map, wrapping[2]) == &wrapping[2]);
+    CHECK(pidmap_find(&map, zero[0]) == &zero[0]);
+    CHECK(pidmap_remove(&map, wrapping[1]) == &wrapping[1]);
+    CHECK(pidmap_find(&map, wrapping[2]) == &wrapping[2]);
+    CHECK(pidmap_find(&map, zero[0]) == &zero[0]);
+    pidmap_free(&map);
+}
+
+static void test_random(void) {
+    //random inserts and removals checked against a plain array, through several resizes
+    pidmap_t map;
+    CHECK(pidmap_init(&map, 0) == 0);
+    int values[PIDS_MAX];
+    bool present[PIDS_MAX] = {false};
+    size_t count = 0;
+
+    srand(1);
+    for(int op = 0; op < 20000; op++) {
+        pid_t pid = 1 + rand() % (PIDS_MAX - 1);
+        if(rand() % 3) {
+            CHECK(pidmap_insert(&map, pid, &values[pid]) == 0);
+            count += !present[pid];
+            present[pid] = true;
+        }
+        else {
+            CHECK(pidmap_remove(&map, pid) == (present[pid] ? &values[pid] : 0));
+            count -= present[pid];
+            present[pid] = false;
+        }
+        CHECK(map.count == count);
+
+        if((op % 97) == 0) {
+            for(pid_t p = 1; p < PIDS_MAX; p++) {
+                CHECK(pidmap_find(&map, p) == (present[p] ? &values[p] : 0));
+            }
+        }
+    }
+
+    pidmap_free(&map);
+}
+
+static void test_reserve(void) {
+    pidmap_t map;
+    CHECK(pidmap_init(&map, 0) == 0);
+    CHECK(pidmap_reserve(&map, 100) == 0);
+    CHECK(map.capacity >= 200);
+
+    //nothing is reallocated while inserting what was reserved
+    pidmap_entry_t *entries = map.entries;
+    int value;
+    for(pid_t pid = 1; pid <= 100; pid++) {
+        CHECK(pidmap_insert(&map, pid, &value) == 0);
+    }
+    CHECK(map.entries == entries);
+    CHECK(map.count == 100);
+
+    //reserving less than there is room for keeps the table
+    CHECK(pidmap_reserve(&map, 50) == 0);
+    CHECK(map.entries == entries);
+    for(pid_t pid = 1; pid <= 100; pid++) {
+        CHECK(pidmap_find(&map, pid) == &value);
+    }
+
+    pidmap_free(&map);
+}
+
+int main(void) {
+    test_basic();
+    test_backward_shift();
+    test_random();
+    test_reserve();
+    return CHECK_DONE();
+}
@@ -0,0 +1,244 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#include "check.h"
+#include "ring.h"
+#include <pthread.h>
+#include <string.h>
+
+#define RECORD_SIZE     1000    //with its 4 byte header, 65 of them fill the smallest ring
+
+int check_failures = 0;
+
+static void record_fill(char *record, size_t length, int n) {
+    memset(record, 'a' + (n % 26), length);
+    memcpy(record, &n, sizeof(n));
+}
+
+static int record_number(const char *record) {
+    int n;
+    memcpy(&n, record, sizeof(n));
+    return n;
+}
+
+static void test_basic(void) {
+    ring_t ring;
+    CHECK(ring_init(&ring, 1000, RING_DROP_NEWEST) == 0);
+    CHECK(ring.size == RING_SIZE_MIN);
+
+    char out[RING_RECORD_MAX];
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 0);
+    CHECK(ring_push(&ring, "hello", 5) == 0);
+    CHECK(ring_push(&ring, "", 0) == 0);
+
+    //a gathered record comes out as one
+    struct iovec parts[2] = { { "ab", 2 }, { "cde", 3 } };
+    CHECK(ring_pushv(&ring, parts, 2) == 0);
+
+    CHECK(ring_pop(&ring, out, 4) == -1);      //doesn't fit in out, and stays
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 5);
+    CHECK(memcmp(out, "hello", 5) == 0);
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 0);     //the empty record; it reads like an empty ring, but is taken
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 5);
+    CHECK(memcmp(out, "abcde", 5) == 0);
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 0);
+
+    //too long to ever fit
+    char big[RING_RECORD_MAX + 1] = {0};
+    CHECK(ring_push(&ring, big, sizeof(big)) == -1);
+    CHECK(ring_dropped(&ring) == 1);
+    ring_free(&ring);
+}
+
+static void test_wrap_around(void) {
+    //records straddling the end of the buffer, headers included, come out whole and in order
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_DROP_NEWEST) == 0);
+
+    char record[RECORD_SIZE + 7], out[RING_RECORD_MAX];
+    int pushed = 0, popped = 0;
+    for(int round = 0; round < 1000; round++) {
+        size_t length = RECORD_SIZE + (size_t)(round % 7);
+        record_fill(record, length, pushed);
+        CHECK(ring_push(&ring, record, length) == 0);
+        pushed++;
+
+        //keep about half of the ring filled, so head and tail both wrap many times
+        if(round > 30) {
+            ssize_t n = ring_pop(&ring, out, sizeof(out));
+            CHECK(n == (ssize_t)(RECORD_SIZE + (size_t)(popped % 7)));
+            CHECK(record_number(out) == popped);
+            CHECK(out[n - 1] == 'a' + (popped % 26));
+            popped++;
+        }
+    }
+    CHECK(ring.head > 10 * ring.size);
+    CHECK(ring_dropped(&ring) == 0);
+    ring_free(&ring);
+}
+
+static void test_drop_newest(void) {
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_DROP_NEWEST) == 0);
+
+    char record[RECORD_SIZE], out[RING_RECORD_MAX];
+    int kept = 0;
+    for(int i = 0; i < 100; i++) {
+        record_fill(record, sizeof(record), i);
+        kept += (ring_push(&ring, record, sizeof(record)) == 0);
+    }
+    CHECK(kept == (int)(ring.size / (RECORD_SIZE + 4)));
+    CHECK(ring_dropped(&ring) == (uint64_t)(100 - kept));
+
+    //the first ones are kept
+    for(int i = 0; i < kept; i++) {
+        CHECK(ring_pop(&ring, out, sizeof(out)) == RECORD_SIZE);
+        CHECK(record_number(out) == i);
+    }
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 0);
+    ring_free(&ring);
+}
+
+static void test_drop_oldest(void) {
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_DROP_OLDEST) == 0);
+
+    char record[RECORD_SIZE], out[RING_RECORD_MAX];
+    for(int i = 0; i < 100; i++) {
+        record_fill(record, sizeof(record), i);
+        CHECK(ring_push(&ring, record, sizeof(record)) == 0);
+    }
+    int fits = (int)(ring.size / (RECORD_SIZE + 4));
+    CHECK(ring_dropped(&ring) == (uint64_t)(100 - fits));
+
+    //the last ones are kept
+    for(int i = 100 - fits; i < 100; i++) {
+        CHECK(ring_pop(&ring, out, sizeof(out)) == RECORD_SIZE);
+        CHECK(record_number(out) == i);
+    }
+    CHECK(ring_pop(&ring, out, sizeof(out)) == 0);
+
+    //a bigger record drops as many small ones as it needs
+    for(int i = 0; i < fits; i++) {
+        record_fill(record, sizeof(record), i);
+        ring_push(&ring, record, sizeof(record));
+    }
+    uint64_t dropped = ring_dropped(&ring);
+    char big[RING_RECORD_MAX] = {0};
+    CHECK(ring_push(&ring, big, sizeof(big)) == 0);
+    size_t free_bytes = ring.size - (size_t)fits * (RECORD_SIZE + 4);
+    size_t missing = sizeof(big) + 4 - free_bytes;
+    CHECK(ring_dropped(&ring) - dropped == (missing + RECORD_SIZE + 3) / (RECORD_SIZE + 4));
+    ring_free(&ring);
+}
+
+static void *consumer(void *arg) {
+    //pops every record until the ring is closed; they have to come in order, with gaps only where records were dropped
+    ring_t *ring = (ring_t *)arg;
+    char out[RING_RECORD_MAX];
+    int last = -1;
+    intptr_t popped = 0;
+    while(true) {
+        ssize_t n;
+        while((n = ring_pop(ring, out, sizeof(out))) > 0) {
+            CHECK(n == RECORD_SIZE);
+            CHECK(record_number(out) > last);
+            CHECK(out[n - 1] == 'a' + (record_number(out) % 26));
+            if(ring->overflow != RING_DROP_OLDEST) {
+                CHECK(record_number(out) == last + 1);
+            }
+            last = record_number(out);
+            popped++;
+        }
+        if(!ring_wait(ring)) {
+            break;
+        }
+    }
+
+    return (void *)popped;
+}
+
+static void test_block(void) {
+    //with a consumer thread nothing is dropped, however far ahead the producer gets
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_BLOCK) == 0);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, 0, consumer, &ring) == 0);
+
+    char record[RECORD_SIZE];
+    for(int i = 0; i < 20000; i++) {
+        record_fill(record, sizeof(record), i);
+        CHECK(ring_push(&ring, record, sizeof(record)) == 0);
+    }
+    ring_close(&ring);
+
+    void *popped;
+    pthread_join(thread, &popped);
+    CHECK((intptr_t)popped == 20000);
+    CHECK(ring_dropped(&ring) == 0);
+    ring_free(&ring);
+}
+
+static void test_drop_oldest_concurrent(void) {
+    //the producer drops records the consumer may be popping at the same time; every record is either popped whole and
+    //in order, or counted as dropped
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_DROP_OLDEST) == 0);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, 0, consumer, &ring) == 0);
+
+    char record[RECORD_SIZE];
+    for(int i = 0; i < 200000; i++) {
+        record_fill(record, sizeof(record), i);
+        CHECK(ring_push(&ring, record, sizeof(record)) == 0);
+    }
+    ring_close(&ring);
+
+    void *popped;
+    pthread_join(thread, &popped);
+    CHECK((uint64_t)(intptr_t)popped + ring_dropped(&ring) == 200000);
+    ring_free(&ring);
+}
+
+static void test_kick(void) {
+    //a kick wakes the consumer with nothing to pop; closing an empty ring ends ring_wait()
+    ring_t ring;
+    CHECK(ring_init(&ring, 0, RING_DROP_NEWEST) == 0);
+    ring_kick(&ring);
+    CHECK(ring_wait(&ring) == true);
+    ring_close(&ring);
+    CHECK(ring_wait(&ring) == false);
+    ring_free(&ring);
+}
+
+int main(void) {
+    test_basic();
+    test_wrap_around();
+    test_drop_newest();
+    test_drop_oldest();
+    test_block();
+    test_drop_oldest_concurrent();
+    test_kick();
+    return CHECK_DONE();
+}
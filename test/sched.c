@@ -0,0 +1,199 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2022 AXIPlus / Adrian Lita / Alex Stancu - www.axiplus.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * */
+
+#define _GNU_SOURCE
+
+#include "check.h"
+#include "spawn.h"
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define IOPRIO_WHO_PROCESS          1
+#define IOPRIO_CLASS_SHIFT          13
+
+int check_failures = 0;
+
+typedef struct sched_case_s {
+    const char *name;
+    spawn_sched_policy_t policy;
+    int policy_value;           //SCHED_* expected in /proc/<pid>/sched
+    int priority;
+    int nice;
+    spawn_ioprio_class_t ioprio_class;
+    int ioprio_level;
+} sched_case_t;
+
+static const sched_case_t sched_cases[] = {
+    { "SCHED_OTHER", SPAWN_SCHED_OTHER, SCHED_OTHER, 0, 5, SPAWN_IOPRIO_BEST_EFFORT, 3 },
+    { "SCHED_BATCH", SPAWN_SCHED_BATCH, SCHED_BATCH, 0, 10, SPAWN_IOPRIO_BEST_EFFORT, 7 },
+    { "SCHED_IDLE", SPAWN_SCHED_IDLE, SCHED_IDLE, 0, 19, SPAWN_IOPRIO_IDLE, 0 },
+    { "SCHED_FIFO", SPAWN_SCHED_FIFO, SCHED_FIFO, 10, -5, SPAWN_IOPRIO_BEST_EFFORT, 0 },
+    { "SCHED_RR", SPAWN_SCHED_RR, SCHED_RR, 20, 0, SPAWN_IOPRIO_BEST_EFFORT, 1 },
+};
+
+//real-time policies and negative nice values need CAP_SYS_NICE (and some RT runtime); tried in a throwaway child
+static bool rt_permitted(void) {
+    pid_t pid = fork();
+    if(pid == 0) {
+        struct sched_param param = { .sched_priority = 1 };
+        _exit(((setpriority(PRIO_PROCESS, 0, -1) == 0) && (sched_setscheduler(0, SCHED_FIFO, &param) == 0)) ? 0 : 1);
+    }
+
+    int status = 0;
+    return (pid > 0) && (waitpid(pid, &status, 0) == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+//reads "key : value" from /proc/<pid>/sched; -1 when it is missing
+static long read_sched(pid_t pid, const char *key) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/sched", pid);
+    FILE *f = fopen(path, "r");
+    if(f == 0) {
+        return -1;
+    }
+
+    long value = -1;
+    char line[256];
+    size_t length = strlen(key);
+    while(fgets(line, sizeof(line), f)) {
+        if((strncmp(line, key, length) == 0) && (line[length] == ' ')) {
+            char *colon = strchr(line, ':');
+            if(colon) {
+                value = strtol(colon + 1, 0, 10);
+            }
+            break;
+        }
+    }
+
+    fclose(f);
+    return value;
+}
+
+//nice is the 19th field of /proc/<pid>/stat, counted after the parenthesized comm
+static int read_nice(pid_t pid, int *nice) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if(f == 0) {
+        return -1;
+    }
+
+    char line[1024];
+    char *fields = fgets(line, sizeof(line), f) ? strrchr(line, ')') : 0;
+    fclose(f);
+    if(fields == 0) {
+        return -1;
+    }
+
+    //fields + 2 is field 3 (state)
+    return (sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %d", nice) == 1) ? 0 : -1;
+}
+
+static void test_sched_case(const sched_case_t *test) {
+    spawn_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.sched_policy = test->policy;
+    attr.sched_priority = test->priority;
+    attr.has_nice = true;
+    attr.nice = test->nice;
+    attr.ioprio_class = test->ioprio_class;
+    attr.ioprio_level = test->ioprio_level;
+
+    char *args[] = { "5" };
+    char *envp[] = { 0 };
+    spawn_plan_t *plan = spawn_plan_create("/bin/sleep", args, 1, envp, 0, 0, &attr);
+    CHECK(plan != 0);
+    if(plan == 0) {
+        return;
+    }
+
+    spawn_request_t request = {
+        .plan = plan,
+        .stdout_fd = -1,
+        .stderr_fd = -1,
+        .notify_fd = -1,
+        .cgroup_fd = -1,
+    };
+    pid_t pid = spawn_process(&request);
+    CHECK(pid > 0);
+    if(pid <= 0) {
+        fprintf(stderr, "%s: spawn failed\n", test->name);
+        free(plan);
+        return;
+    }
+
+    //the attributes are applied before execve, and spawn_process() only returns once execve went through
+    CHECK(read_sched(pid, "policy") == test->policy_value);
+    long prio = read_sched(pid, "prio");
+    if((test->policy == SPAWN_SCHED_FIFO) || (test->policy == SPAWN_SCHED_RR)) {
+        CHECK(prio == 99 - test->priority);
+    }
+    else {
+        CHECK(prio == 120 + test->nice);
+    }
+
+    int nice = 100;
+    CHECK((read_nice(pid, &nice) == 0) && (nice == test->nice));
+
+    int ioprio = (int)syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, pid);
+    CHECK((ioprio >> IOPRIO_CLASS_SHIFT) == (int)test->ioprio_class);
+    if(test->ioprio_class != SPAWN_IOPRIO_IDLE) {
+        CHECK((ioprio & ((1 << IOPRIO_CLASS_SHIFT) - 1)) == test->ioprio_level);
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, 0, 0);
+    free(plan);
+}
+
+static void test_sched(spawn_strategy_t strategy) {
+    CHECK(spawn_init(strategy) == 0);
+
+    bool rt = rt_permitted();
+    for(size_t i = 0; i < sizeof(sched_cases) / sizeof(sched_cases[0]); i++) {
+        const sched_case_t *test = &sched_cases[i];
+        if(!rt && ((test->policy == SPAWN_SCHED_FIFO) || (test->policy == SPAWN_SCHED_RR) || (test->nice < 0))) {
+            printf("sched: skipping %s, it needs CAP_SYS_NICE\n", test->name);
+            continue;
+        }
+
+        test_sched_case(test);
+    }
+
+    spawn_free();
+}
+
+int main(void) {
+    test_sched(SPAWN_STRATEGY_VFORK);
+    test_sched(SPAWN_STRATEGY_FORK);
+    return CHECK_DONE();
+}